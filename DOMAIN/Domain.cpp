@@ -0,0 +1,106 @@
+/*
+ * Domain.cpp
+ *
+ *  Created on: 18 oct. 2026
+ *      Author: Romain Simon
+ */
+
+#include <iostream>
+#include <numeric>
+#include <string>
+#include "Domain.h"
+#include "../Random_mt.h"
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+
+Domain::Domain()
+{
+#ifdef USE_MPI
+    MPI_Comm_rank(MPI_COMM_WORLD, &m_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &m_nRanks);
+
+    unsigned int seed {static_cast<unsigned int>(Random::mt())};
+    MPI_Bcast(&seed, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    Random::mt.seed(seed);
+#endif
+}
+
+double Domain::sumAll(const double& localValue) const
+{
+#ifdef USE_MPI
+    double globalValue {0.};
+    MPI_Allreduce(&localValue, &globalValue, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return globalValue;
+#else
+    return localValue;
+#endif
+}
+
+long long Domain::sumAll(const long long& localValue) const
+{
+#ifdef USE_MPI
+    long long globalValue {0};
+    MPI_Allreduce(&localValue, &globalValue, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    return globalValue;
+#else
+    return localValue;
+#endif
+}
+
+/*******************************************************************************
+ * This function exchanges arrays with the left and right ranks. The lengths
+ * are sent first, then the arrays: to the right and from the left, then to the
+ * left and from the right. With two ranks the left and right ranks are the
+ * same, the tags tell the two arrays apart.
+ ******************************************************************************/
+void Domain::exchangeNeighbors(const std::vector<double>& toLeftArray, const std::vector<double>& toRightArray,
+                               std::vector<double>& fromLeftArray, std::vector<double>& fromRightArray) const
+{
+#ifdef USE_MPI
+    const int leftRank {getLeftRank()};
+    const int rightRank {getRightRank()};
+    const int toLeftLength {static_cast<int>(toLeftArray.size())};
+    const int toRightLength {static_cast<int>(toRightArray.size())};
+    int fromLeftLength {0};
+    int fromRightLength {0};
+
+    MPI_Sendrecv(&toRightLength, 1, MPI_INT, rightRank, 0, &fromLeftLength, 1, MPI_INT, leftRank, 0,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(&toLeftLength, 1, MPI_INT, leftRank, 1, &fromRightLength, 1, MPI_INT, rightRank, 1,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    fromLeftArray.resize(fromLeftLength);
+    fromRightArray.resize(fromRightLength);
+    MPI_Sendrecv(toRightArray.data(), toRightLength, MPI_DOUBLE, rightRank, 2, fromLeftArray.data(), fromLeftLength,
+                 MPI_DOUBLE, leftRank, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(toLeftArray.data(), toLeftLength, MPI_DOUBLE, leftRank, 3, fromRightArray.data(), fromRightLength,
+                 MPI_DOUBLE, rightRank, 3, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+#else
+    fromLeftArray = toRightArray;
+    fromRightArray = toLeftArray;
+#endif
+}
+
+/*******************************************************************************
+ * This function gathers the local arrays of all ranks in globalArray on the
+ * root rank. The ranks first send the lengths of their arrays; globalArray is
+ * left empty on the other ranks.
+ ******************************************************************************/
+void Domain::gatherRoot(const std::vector<double>& localArray, std::vector<double>& globalArray) const
+{
+#ifdef USE_MPI
+    const int localLength {static_cast<int>(localArray.size())};
+    std::vector<int> lengthArray (m_nRanks);
+    MPI_Gather(&localLength, 1, MPI_INT, lengthArray.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    std::vector<int> offsetArray (m_nRanks, 0);
+    std::partial_sum(lengthArray.begin(), lengthArray.end() - 1, offsetArray.begin() + 1);
+    globalArray.resize(isRoot() ? offsetArray.back() + lengthArray.back() : 0);
+    MPI_Gatherv(localArray.data(), localLength, MPI_DOUBLE, globalArray.data(), lengthArray.data(),
+                offsetArray.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#else
+    globalArray = localArray;
+#endif
+}
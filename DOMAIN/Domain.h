@@ -0,0 +1,81 @@
+/*
+ * Domain.h
+ *
+ *  Created on: 18 oct. 2026
+ *      Author: Romain Simon
+ */
+
+#ifndef DOMAIN_H_
+#define DOMAIN_H_
+
+#include <vector>
+
+/*******************************************************************************
+ * Spatial decomposition of the box over the MPI ranks. The box is cut in slabs
+ * of cell layers along x, each rank storing and moving the particles of its
+ * slab plus a ghost layer of the neighboring slabs (see MonteCarlo). A rank
+ * only exchanges particles with the ranks of the slabs on its left and on its
+ * right, the box being periodic. Without USE_MPI there is a single rank and
+ * the communications are identities.
+ ******************************************************************************/
+class Domain
+{
+private:
+    int m_rank {0};
+    int m_nRanks {1};
+
+public:
+    // Reads the rank of the process and shares the seed of Random::mt from the root rank, so that the moves that
+    // are replicated on all ranks draw the same numbers. MPI must be initialized.
+    Domain();
+
+    [[nodiscard]] bool isRoot() const
+    {
+        return m_rank == 0;
+    }
+
+    [[nodiscard]] int getRank() const
+    {
+        return m_rank;
+    }
+
+    [[nodiscard]] int getNRanks() const
+    {
+        return m_nRanks;
+    }
+
+    [[nodiscard]] int getLeftRank() const
+    {
+        return (m_rank + m_nRanks - 1) % m_nRanks;
+    }
+
+    [[nodiscard]] int getRightRank() const
+    {
+        return (m_rank + 1) % m_nRanks;
+    }
+
+    // Rank owning the cell layer layerX among numCell layers.
+    [[nodiscard]] int getOwnerLayer(const int& layerX, const int& numCell) const
+    {
+        return layerX * m_nRanks / numCell;
+    }
+
+    // First cell layer of the slab of rank, the inverse of getOwnerLayer.
+    [[nodiscard]] int getFirstLayer(const int& rank, const int& numCell) const
+    {
+        return (rank * numCell + m_nRanks - 1) / m_nRanks;
+    }
+
+    [[nodiscard]] double sumAll(const double& localValue) const;
+
+    [[nodiscard]] long long sumAll(const long long& localValue) const;
+
+    // Sends toLeftArray to the left rank and toRightArray to the right rank, and receives their arrays.
+    void exchangeNeighbors(const std::vector<double>& toLeftArray, const std::vector<double>& toRightArray,
+                           std::vector<double>& fromLeftArray, std::vector<double>& fromRightArray) const;
+
+    // Concatenates the local arrays of all ranks on the root rank, in rank order.
+    void gatherRoot(const std::vector<double>& localArray, std::vector<double>& globalArray) const;
+};
+
+#endif /* DOMAIN_H_ */
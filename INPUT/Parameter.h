@@ -149,6 +149,11 @@ namespace param {
             check_key(key);
             return get_string(key, "");
         }
+
+        void set(const std::string& key, const std::string& value)
+        {
+            params[key] = value;
+        }
     };
 
 
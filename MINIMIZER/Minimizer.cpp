@@ -0,0 +1,113 @@
+/*
+ * Minimizer.cpp
+ *
+ *  Created on: 18 oct. 2026
+ *      Author: Romain Simon
+ */
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include "Minimizer.h"
+
+/*******************************************************************************
+ * This function minimizes the energy with FIRE: damped dynamics with unit
+ * masses whose velocity is mixed with the direction of the force,
+ * v = (1 - alpha) v + alpha |v| F / |F|, and whose time step grows while the
+ * power P = F . v stays positive. When P < 0 the velocity is reset and the
+ * time step is cut. P = 0 at the first step, which starts at rest with the
+ * initial time step. The minimization stops when the largest force component is
+ * below m_forceTolerance or after m_maxSteps steps, in which case the
+ * non-converged minimization is reported on std::cerr.
+ *
+ * @param systemMolecules Configuration to minimize, modified in place.
+ *        systemNeighbors Neighbor list of systemMolecules.
+ *
+ * @return Energy of the minimized configuration.
+ ******************************************************************************/
+double Minimizer::minimize(Molecules& systemMolecules, Neighbors& systemNeighbors) const
+{
+    const int nDims {systemMolecules.getNDims()};
+    const int nParticles {systemMolecules.getNParticles()};
+    std::vector<double> forceArray {};
+    std::vector<double> velocityArray (nDims * nParticles, 0.);
+    std::vector<double> displacement (nDims);
+    std::vector<Real> newPosition (nDims);
+
+    double energy {systemMolecules.forceSystemMolecule(systemNeighbors, forceArray)};
+    double timeStep {m_timeStep};
+    double alpha {m_alphaStart};
+    int nPositive {0};
+
+    const auto maxForce {[&forceArray]()
+    {
+        return std::fabs(*std::max_element(forceArray.begin(), forceArray.end(),
+                                           [](const double& first, const double& second)
+                                           {
+                                               return std::fabs(first) < std::fabs(second);
+                                           }));
+    }};
+
+    for (int step = 0; step < m_maxSteps; step++)
+    {
+        if (maxForce() < m_forceTolerance)
+        {
+            break;
+        }
+        const double power {std::inner_product(forceArray.begin(), forceArray.end(), velocityArray.begin(), 0.)};
+
+        if (power > 0)
+        {
+            const double velocityNorm {std::sqrt(std::inner_product(velocityArray.begin(), velocityArray.end(),
+                                                                    velocityArray.begin(), 0.))};
+            const double forceNorm {std::sqrt(std::inner_product(forceArray.begin(), forceArray.end(),
+                                                                 forceArray.begin(), 0.))};
+
+            for (int k = 0; k < nDims * nParticles; k++)
+            {
+                velocityArray[k] = (1. - alpha) * velocityArray[k] + alpha * velocityNorm / forceNorm * forceArray[k];
+            }
+
+            if (++nPositive > m_nDelay)
+            {
+                timeStep = std::min(timeStep * m_increaseTimeStep, m_maxTimeStep);
+                alpha *= m_decreaseAlpha;
+            }
+        }
+        else if (power < 0)
+        {
+            nPositive = 0;
+            timeStep *= m_decreaseTimeStep;
+            alpha = m_alphaStart;
+            std::fill(velocityArray.begin(), velocityArray.end(), 0.);
+        }
+
+        // Semi-implicit Euler step.
+        for (int indexParticle = 0; indexParticle < nParticles; indexParticle++)
+        {
+            const auto& posItBegin {systemMolecules.getPosItBeginI(indexParticle)};
+
+            for (int d = 0; d < nDims; d++)
+            {
+                double& velocity {velocityArray[nDims * indexParticle + d]};
+                velocity += timeStep * forceArray[nDims * indexParticle + d];
+                displacement[d] = timeStep * velocity;
+                newPosition[d] = static_cast<Real>(posItBegin[d] + displacement[d]);
+            }
+            systemMolecules.periodicBC(newPosition.begin());
+            systemNeighbors.updateInterDisplacement(indexParticle, displacement.begin());
+            systemMolecules.updatePositionI(indexParticle, newPosition.begin());
+        }
+        systemNeighbors.checkInterDisplacement(systemMolecules);
+        energy = systemMolecules.forceSystemMolecule(systemNeighbors, forceArray);
+    }
+
+    if (maxForce() >= m_forceTolerance)
+    {
+        std::cerr << "Minimization not converged after quenchMaxSteps=" << m_maxSteps
+                  << " steps, largest force component: " << maxForce() << "\n";
+    }
+    return energy;
+}
@@ -0,0 +1,50 @@
+/*
+ * Minimizer.h
+ *
+ *  Created on: 18 oct. 2026
+ *      Author: Romain Simon
+ */
+
+#ifndef MINIMIZER_H_
+#define MINIMIZER_H_
+
+#include <vector>
+#include "../INPUT/Parameter.h"
+#include "../MOLECULES/Molecules.h"
+#include "../NEIGHBORS/Neighbors.h"
+
+/*******************************************************************************
+ * FIRE energy minimization (Bitzek et al., PRL 97, 170201, 2006) of a
+ * configuration, used to quench the saved configurations to their inherent
+ * structures. The minimization runs on copies of the system and of its
+ * neighbor list, with the forces of Molecules::forceSystemMolecule.
+ ******************************************************************************/
+class Minimizer
+{
+private:
+    const double m_timeStep {};                                     // Initial time step of the FIRE dynamics.
+    const double m_maxTimeStep {};
+    const double m_forceTolerance {};                               // Convergence: largest force component.
+    const int m_maxSteps {};
+    static constexpr int m_nDelay {5};                              // Steps with P > 0 before the time step grows.
+    static constexpr double m_increaseTimeStep {1.1};
+    static constexpr double m_decreaseTimeStep {0.5};
+    static constexpr double m_alphaStart {0.1};                     // Initial mixing of the velocity with the force.
+    static constexpr double m_decreaseAlpha {0.99};
+
+public:
+    explicit Minimizer(param::Parameter param)
+
+        : m_timeStep (param.get_double("quenchTimeStep", 0.005))
+            , m_maxTimeStep (param.get_double("quenchMaxTimeStep", 0.05))
+            , m_forceTolerance (param.get_double("quenchForceTolerance", 1e-6))
+            , m_maxSteps (param.get_int("quenchMaxSteps", 100000))
+    {
+    }
+
+    // Minimizes the energy of systemMolecules in place and returns the minimized energy. systemNeighbors must be the
+    // neighbor list of systemMolecules, it is kept valid along the minimization.
+    double minimize(Molecules& systemMolecules, Neighbors& systemNeighbors) const;
+};
+
+#endif /* MINIMIZER_H_ */
@@ -1,8 +1,10 @@
 
 
 #include <vector>
+#include <numeric>
 #include "Molecules.h"
 #include "../NEIGHBORS/Neighbors.h"
+#include "../util.h"
 
 
 const int& Molecules::getNParticles() const
@@ -21,6 +23,82 @@ const double& Molecules::getHalfLengthCube() const
     return m_halfLengthCube;
 }
 
+/*******************************************************************************
+ * This function scales the box and all the positions by scaleFactor (volume
+ * moves). The wrapped positions stay in the box, the image counters are
+ * unchanged.
+ ******************************************************************************/
+void Molecules::rescaleBox(const double& scaleFactor)
+{
+    for (auto& particle : m_particleArray)
+    {
+        for (int d = 0; d < m_nDims; d++)
+        {
+            particle.position[d] = static_cast<Real>(particle.position[d] * scaleFactor);
+        }
+    }
+    m_lengthCube *= scaleFactor;
+    m_halfLengthCube = 0.5 * m_lengthCube;
+    m_saveHeaderString = initializeHeaderString(m_nParticles, m_lengthCube, m_polydisperse);
+}
+
+/*******************************************************************************
+ * This function restores the positions and the box of a rejected volume move.
+ ******************************************************************************/
+void Molecules::restoreBox(const std::vector<ParticleRecord>& particleArray, const double& lengthCube)
+{
+    m_particleArray = particleArray;
+    m_lengthCube = lengthCube;
+    m_halfLengthCube = 0.5 * m_lengthCube;
+    m_saveHeaderString = initializeHeaderString(m_nParticles, m_lengthCube, m_polydisperse);
+}
+
+const std::vector<ParticleRecord>& Molecules::getParticleRecordArray() const
+{
+    return m_particleArray;
+}
+
+const std::vector<int>& Molecules::getFlagsArray() const
+{
+    return m_flagsArray;
+}
+
+/*******************************************************************************
+ * This function restores the positions and the image counters of a rejected
+ * collective move.
+ ******************************************************************************/
+void Molecules::restoreParticles(const std::vector<ParticleRecord>& particleArray,
+                                 const std::vector<int>& flagsArray)
+{
+    m_particleArray = particleArray;
+    m_flagsArray = flagsArray;
+}
+
+/*******************************************************************************
+ * This function replaces the particles by another set, e.g. the slab of a rank
+ * with a domain decomposition. The bonds are given as in initializeBondsArray,
+ * with the new indices, and the particles of a molecule must stay contiguous.
+ * The molecule and chain tables are rebuilt, the swap caches are dropped.
+ ******************************************************************************/
+void Molecules::assignParticles(std::vector<ParticleRecord> particleArray, std::vector<int> flagsArray,
+                                std::vector<int> moleculeTypeArray, std::vector<Real> diameterArray,
+                                std::vector<int> bondsArray, std::vector<int> bondsIndex)
+{
+    m_nParticles = static_cast<int>(particleArray.size());
+    m_particleArray = std::move(particleArray);
+    m_flagsArray = std::move(flagsArray);
+    m_moleculeTypeArray = std::move(moleculeTypeArray);
+    m_diameterArray = std::move(diameterArray);
+    m_bondsArray = std::move(bondsArray);
+    m_bondsIndex = std::move(bondsIndex);
+    m_typeEnergyArray.clear();
+    m_typeBucketArray.clear();
+    m_bucketSlotArray.clear();
+    m_saveHeaderString = initializeHeaderString(m_nParticles, m_lengthCube, m_polydisperse);
+    initializeMoleculeTable();
+    initializeChainTable();
+}
+
 const int& Molecules::getNDims() const
 {
     return m_nDims;
@@ -38,7 +116,7 @@ std::vector<double> Molecules::getPositionI(const int& i) const
 
 const int& Molecules::getParticleTypeI(const int& i) const
 {
-    return m_particleTypeArray[i];
+    return m_particleArray[i].type;
 }
 
 const int& Molecules::getMoleculeTypeI(const int& i) const
@@ -49,8 +127,8 @@ const int& Molecules::getMoleculeTypeI(const int& i) const
 
 void Molecules::swapParticleTypesIJ(const int& i, const int& j, const int& typeI, const int& typeJ)
 {
-    m_particleTypeArray[i] = typeJ;
-    m_particleTypeArray[j] = typeI;
+    m_particleArray[i].type = typeJ;
+    m_particleArray[j].type = typeI;
 }
 
 void Molecules::swapParticleTypesIJ(const int& i, const int& j)
@@ -59,70 +137,256 @@ void Molecules::swapParticleTypesIJ(const int& i, const int& j)
     //std::cout << m_particleTypeArray[i] << "  " << m_particleTypeArray[j] << "\n";
 
     const int typeJ {getParticleTypeI(j)};
-    m_particleTypeArray[j] = m_particleTypeArray[i];
-    m_particleTypeArray[i] = typeJ;
+    m_particleArray[j].type = m_particleArray[i].type;
+    m_particleArray[i].type = typeJ;
+
+    if (!m_bucketSlotArray.empty() && m_particleArray[i].type != m_particleArray[j].type)
+    {
+        // Each particle takes the slot of the other one: the bucket sizes are unchanged.
+        std::swap(m_bucketSlotArray[i], m_bucketSlotArray[j]);
+        m_typeBucketArray[m_particleArray[i].type - 1][m_bucketSlotArray[i]] = i;
+        m_typeBucketArray[m_particleArray[j].type - 1][m_bucketSlotArray[j]] = j;
+    }
+}
+
+/*******************************************************************************
+ * This function changes the type of one particle (semi-grand canonical
+ * mutation). The particle leaves its type bucket by taking the place of the
+ * last particle of the bucket, so the update is O(1).
+ ******************************************************************************/
+void Molecules::setParticleTypeI(const int& i, const int& newType)
+{
+    const int oldType {m_particleArray[i].type};
+    m_particleArray[i].type = newType;
+
+    if (!m_bucketSlotArray.empty() && oldType != newType)
+    {
+        std::vector<int>& oldBucket {m_typeBucketArray[oldType - 1]};
+        const int lastParticle {oldBucket.back()};
+        oldBucket[m_bucketSlotArray[i]] = lastParticle;
+        m_bucketSlotArray[lastParticle] = m_bucketSlotArray[i];
+        oldBucket.pop_back();
+
+        std::vector<int>& newBucket {m_typeBucketArray[newType - 1]};
+        m_bucketSlotArray[i] = static_cast<int>(newBucket.size());
+        newBucket.push_back(i);
+    }
+}
+
+/*******************************************************************************
+ * This function builds the type buckets of the non-local swaps. They are then
+ * kept up to date by swapParticleTypesIJ in O(1).
+ ******************************************************************************/
+void Molecules::initializeTypeBuckets()
+{
+    m_typeBucketArray.assign(getNParticleTypes(), std::vector<int> {});
+    m_bucketSlotArray.resize(m_nParticles);
+
+    for (int i = 0; i < m_nParticles; i++)
+    {
+        std::vector<int>& bucket {m_typeBucketArray[m_particleArray[i].type - 1]};
+        m_bucketSlotArray[i] = static_cast<int>(bucket.size());
+        bucket.push_back(i);
+    }
+}
+
+int Molecules::getNParticleTypes() const
+{
+    return m_systemPairPotentials.getParticleTypes();
 }
 
+void Molecules::swapParticleDiametersIJ(const int& i, const int& j)
+{
+    std::swap(m_diameterArray[i], m_diameterArray[j]);
+}
+
+bool Molecules::isPolydisperse() const
+{
+    return m_polydisperse;
+}
+
+/*******************************************************************************
+ * This function returns the square of the largest sigma_ij of the system
+ * (1 without polydispersity), which scales the cut-offs of the neighbor list.
+ * The swaps only exchange diameters, so the bound holds for the whole run.
+ ******************************************************************************/
+double Molecules::getMaxSquareSigma() const
+{
+    if (!m_polydisperse)
+    {
+        return 1.;
+    }
+    const auto [minIt, maxIt] {std::minmax_element(m_diameterArray.begin(), m_diameterArray.end())};
+    const double nonAdditivity {m_systemPairPotentials.getNonAdditivity()};
+    // sigma_ij <= sigma_max for a positive non-additivity, the mixing rule can exceed it otherwise.
+    const double maxSigma {*maxIt * (1. + std::max(0., -nonAdditivity) * (*maxIt - *minIt))};
+    return maxSigma * maxSigma;
+}
+
+/*******************************************************************************
+ * This function returns the particles of a molecule sorted by particle type.
+ * The sort is stable, so particles of the same type keep their chain order.
+ *
+ * @param indexMolecule Molecule's index in the molecule table.
+ *
+ * @return Particle indices sorted by type.
+ ******************************************************************************/
 std::vector<int> Molecules::getOrderVector(const int& indexMolecule) const
 {
-    const int type0 { getParticleTypeI(indexMolecule) };
-    const int type1 { getParticleTypeI(indexMolecule + 1) };
-    int start {0};
-    int middle {1};
-    int end {2};
-    if ((type0 == 1) && (type1 == 3))
+    std::vector<int> orderVector (getMoleculeLengthI(indexMolecule));
+    std::iota(orderVector.begin(), orderVector.end(), getMoleculeBeginI(indexMolecule));
+    std::stable_sort(orderVector.begin(), orderVector.end(), [this](const int& i, const int& j)
+    {
+        return m_particleArray[i].type < m_particleArray[j].type;
+    });
+    return orderVector;
+}
+
+double Molecules::getCosAngleMolecule(const std::vector<int>& orderVector) const
+{
+    std::vector<double> vectorStart { getPositionI(orderVector[0]) };
+    std::vector<double> vectorMiddle { getPositionI(orderVector[1]) };
+    std::vector<double> vectorEnd { getPositionI(orderVector[2]) };
+    std::vector<double> vector1 { vectorDiff( vectorStart, vectorMiddle, m_nDims)};
+    std::vector<double> vector2 { vectorDiff( vectorEnd, vectorMiddle, m_nDims)};
+    periodicVector(vector1.begin(), m_nDims, m_lengthCube);
+    periodicVector(vector2.begin(), m_nDims, m_lengthCube);
+    double cosAngleMolecule { cosAngleVectors(vector1, vector2)};
+    return cosAngleMolecule;
+}
+
+/*******************************************************************************
+ * This function builds the molecule table from the molecule column of the
+ * input file: molecule m owns the particles m_moleculeIndex[m] to
+ * m_moleculeIndex[m + 1] - 1. The particles of a molecule must be contiguous
+ * in the input file.
+ ******************************************************************************/
+void Molecules::initializeMoleculeTable()
+{
+    m_moleculeIndex.clear();
+    m_particleMoleculeArray.resize(m_nParticles);
+    std::vector<int> seenMoleculeTypes {};
+
+    for (int indexParticle = 0; indexParticle < m_nParticles; indexParticle++)
     {
-        middle = 2;
-        end = 1;
+        if (indexParticle == 0 || m_moleculeTypeArray[indexParticle] != m_moleculeTypeArray[indexParticle - 1])
+        {
+            seenMoleculeTypes.push_back(m_moleculeTypeArray[indexParticle]);
+            m_moleculeIndex.push_back(indexParticle);
+        }
+        m_particleMoleculeArray[indexParticle] = static_cast<int>(m_moleculeIndex.size()) - 1;
     }
-    else if (type0 == 2)
+    m_moleculeIndex.push_back(m_nParticles);
+
+    std::sort(seenMoleculeTypes.begin(), seenMoleculeTypes.end());
+
+    if (std::adjacent_find(seenMoleculeTypes.begin(), seenMoleculeTypes.end()) != seenMoleculeTypes.end())
     {
-        middle = 0;
+        std::cerr << "The particles of a molecule must be contiguous in the input file\n";
+        std::abort();
+    }
+}
+
+/*******************************************************************************
+ * This function orders the members of each molecule along its bonds, starting
+ * from a chain end. Molecules that are not linear chains (branched, cyclic or
+ * bonded to another molecule) keep the input order and are flagged, the
+ * pivot and crankshaft moves skip them.
+ ******************************************************************************/
+void Molecules::initializeChainTable()
+{
+    const int nMolecules {getNMolecules()};
+    m_chainArray.resize(m_nParticles);
+    m_linearMoleculeArray.assign(nMolecules, true);
 
-        if (type1 == 1)
+    for (int indexMolecule = 0; indexMolecule < nMolecules; indexMolecule++)
+    {
+        const int indexBegin {getMoleculeBeginI(indexMolecule)};
+        const int lenMolecule {getMoleculeLengthI(indexMolecule)};
+        const int indexEnd {indexBegin + lenMolecule};
+        std::iota(m_chainArray.begin() + indexBegin, m_chainArray.begin() + indexEnd, indexBegin);
+        int chainEnd {-1};
+        int nBonds {0};
+
+        for (int indexParticle = indexBegin; indexParticle < indexEnd; indexParticle++)
         {
-            start = 1;
-            end = 2;
+            const int nBondsI {static_cast<int>(getBondsItEndI(indexParticle) - getBondsItBeginI(indexParticle))};
+            const bool externalBond {std::any_of(getBondsItBeginI(indexParticle), getBondsItEndI(indexParticle),
+                                                 [&](const int& j) { return j < indexBegin || j >= indexEnd; })};
+            nBonds += nBondsI;
+
+            if (nBondsI > 2 || externalBond)
+            {
+                m_linearMoleculeArray[indexMolecule] = false;
+            }
+            if (nBondsI <= 1 && chainEnd < 0)
+            {
+                chainEnd = indexParticle;
+            }
         }
 
-        else
+        // A linear chain of n particles has n - 1 bonds, each counted twice.
+        if (nBonds != 2 * (lenMolecule - 1) || chainEnd < 0)
         {
-            start = 2;
-            end = 1;
+            m_linearMoleculeArray[indexMolecule] = false;
         }
-    }
-    else if (type0 == 3)
-    {
-        end = 0;
 
-        if (type1 == 1)
+        if (!m_linearMoleculeArray[indexMolecule])
         {
-            start = 1;
-            middle = 2;
+            continue;
         }
 
-        else
+        int previous {-1};
+        int current {chainEnd};
+
+        for (int k = 0; k < lenMolecule; k++)
         {
-            start = 2;
-            middle = 1;
+            if (current < 0) // The bonds do not connect the whole molecule.
+            {
+                std::iota(m_chainArray.begin() + indexBegin, m_chainArray.begin() + indexEnd, indexBegin);
+                m_linearMoleculeArray[indexMolecule] = false;
+                break;
+            }
+            m_chainArray[indexBegin + k] = current;
+            const auto nextIt {std::find_if(getBondsItBeginI(current), getBondsItEndI(current),
+                                            [&previous](const int& j) { return j != previous; })};
+            previous = current;
+            current = (nextIt != getBondsItEndI(current)) ? *nextIt : -1;
         }
     }
-    return std::vector<int> { start, middle, end };
 }
 
-double Molecules::getCosAngleMolecule(const std::vector<int>& orderVector, const int& indexMolecule) const
+bool Molecules::isLinearMoleculeI(const int& indexMolecule) const
 {
-    std::vector<double> vectorStart { getPositionI(indexMolecule + orderVector[0]) };
-    std::vector<double> vectorMiddle { getPositionI(indexMolecule + orderVector[1]) };
-    std::vector<double> vectorEnd { getPositionI(indexMolecule + orderVector[2]) };
-    std::vector<double> vector1 { vectorDiff( vectorStart, vectorMiddle, m_nDims)};
-    std::vector<double> vector2 { vectorDiff( vectorEnd, vectorMiddle, m_nDims)};
-    periodicVector(vector1.begin(), m_nDims, m_lengthCube);
-    periodicVector(vector2.begin(), m_nDims, m_lengthCube);
-    double cosAngleMolecule { cosAngleVectors(vector1, vector2)};
-    return cosAngleMolecule;
+    return m_linearMoleculeArray[indexMolecule];
+}
+
+std::vector<int>::const_iterator Molecules::getChainItBeginI(const int& indexMolecule) const
+{
+    return m_chainArray.begin() + getMoleculeBeginI(indexMolecule);
 }
 
+int Molecules::getNMolecules() const
+{
+    return static_cast<int>(m_moleculeIndex.size()) - 1;
+}
+
+const int& Molecules::getMoleculeBeginI(const int& indexMolecule) const
+{
+    return m_moleculeIndex[indexMolecule];
+}
+
+int Molecules::getMoleculeLengthI(const int& indexMolecule) const
+{
+    return m_moleculeIndex[indexMolecule + 1] - m_moleculeIndex[indexMolecule];
+}
+
+const int& Molecules::getParticleMoleculeI(const int& indexParticle) const
+{
+    return m_particleMoleculeArray[indexParticle];
+}
+
+
 /*******************************************************************************
  * This function calculates the distance between two particles considering the
  * periodic boundary conditions.
@@ -157,20 +421,197 @@ double Molecules::squareDistancePair(const int& indexI, const std::vector<double
 
 
 
-void Molecules::updateFlags(const int& indexParticle)
+std::vector<double> Molecules::getUnwrappedPositionArray() const
+{
+    std::vector<double> unwrappedPositionArray (m_nDims * m_nParticles);
+
+    for (int i = 0; i < m_nParticles; i++)
+    {
+        getUnwrappedPositionI(i, unwrappedPositionArray.begin() + m_nDims * i);
+    }
+    return unwrappedPositionArray;
+}
+
+/*******************************************************************************
+ * This function calculates the mean square displacement of the particles since
+ * the reference configuration, from the unwrapped positions.
+ *
+ * @param referencePositionArray Unwrapped positions of the reference
+ *                               configuration (see getUnwrappedPositionArray).
+ *
+ * @return Mean square displacement.
+ ******************************************************************************/
+double Molecules::meanSquareDisplacement(const std::vector<double>& referencePositionArray) const
+{
+    const double squareDisplacement {reduceParticles([&](const int& i)
+    {
+        std::array<double, 3> unwrappedPosition {};
+        getUnwrappedPositionI(i, unwrappedPosition.begin());
+        double squareDisplacementI {0.};
+
+        for (int d = 0; d < m_nDims; d++)
+        {
+            const double displacement {unwrappedPosition[d] - referencePositionArray[m_nDims * i + d]};
+            squareDisplacementI += displacement * displacement;
+        }
+        return squareDisplacementI;
+    })};
+    return squareDisplacement / m_nParticles;
+}
+
+void Molecules::saveDisplacement(const std::vector<double>& referencePositionArray, const std::string& path) const
+{
+    /*
+     * This function saves in a .txt file the displacement of each particle since the reference configuration.
+     */
+    std::ofstream fOut(path);
+    std::vector<double> unwrappedPosition (m_nDims);
+    std::string space {" "};
+
+    for (int i = 0; i < m_nParticles; i++)
+    {
+        getUnwrappedPositionI(i, unwrappedPosition.begin());
+
+        for (int d = 0; d < m_nDims; d++)
+        {
+            fOut << unwrappedPosition[d] - referencePositionArray[m_nDims * i + d];
+            fOut << ((d == m_nDims - 1) ? "\n" : space);
+        }
+    }
+    fOut.close();
+}
+
+/*******************************************************************************
+ * This function fills the type-resolved energy cache from scratch. It is
+ * called at the start and after each neighbor list update to remove the
+ * round-off accumulated by the incremental updates.
+ ******************************************************************************/
+void Molecules::initializeTypeEnergy(const Neighbors& systemNeighbors)
+{
+    const int nParticleTypes {m_systemPairPotentials.getParticleTypes()};
+    m_typeEnergyArray.resize(nParticleTypes * m_nParticles);
+
+    for (int indexParticle = 0; indexParticle < m_nParticles; indexParticle++)
+    {
+        const auto& neighItBegin { systemNeighbors.getNeighItBeginI(indexParticle) };
+        const int& lenNeigh { systemNeighbors.getLenIndexBegin(indexParticle)};
+        typeEnergyParticle(getPosItBeginI(indexParticle), neighItBegin, lenNeigh,
+                           m_typeEnergyArray.begin() + nParticleTypes * indexParticle);
+    }
+}
+
+bool Molecules::hasTypeEnergy() const
+{
+    return !m_typeEnergyArray.empty();
+}
+
+/*******************************************************************************
+ * This function calculates the pair energy differences of a batch of
+ * independent translations (see MonteCarlo::mcBatchTranslation). Lane b moves
+ * particle indexArray[b] to the position b of newPositionArray (structure of
+ * arrays) and reads its neighbor row rowArray[b] of length lenArray[b]. The
+ * loop runs over the neighbor slots and, inside, over the lanes: rows are
+ * padded to the longest one and the padding lanes are masked with a select,
+ * so the lane loop has no branch and can be vectorized across particles.
+ ******************************************************************************/
+void Molecules::energyDiffBatch(const std::vector<int>& indexArray, const std::vector<Real>& newPositionArray,
+                                const std::vector<const int*>& rowArray, const std::vector<int>& lenArray,
+                                std::vector<double>& diffEnergyArray) const
+{
+    const int nLanes {static_cast<int>(indexArray.size())};
+    const int maxLen {nLanes > 0 ? *std::max_element(lenArray.begin(), lenArray.end()) : 0};
+    const Real lengthCube {static_cast<Real>(m_lengthCube)};
+    const Real halfLengthCube {static_cast<Real>(m_halfLengthCube)};
+    std::fill(diffEnergyArray.begin(), diffEnergyArray.end(), 0.);
+
+    m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+    {
+        for (int slot = 0; slot < maxLen; slot++)
+        {
+            for (int b = 0; b < nLanes; b++)
+            {
+                const bool active {slot < lenArray[b]};
+                const int indexJ {active ? rowArray[b][slot] : indexArray[b]};
+                const ParticleRecord& particleI {m_particleArray[indexArray[b]]};
+                const ParticleRecord& particleJ {m_particleArray[indexJ]};
+                Real oldSquareDistance {0.};
+                Real newSquareDistance {0.};
+
+                for (int d = 0; d < m_nDims; d++)
+                {
+                    Real oldDiff {particleI.position[d] - particleJ.position[d]};
+                    Real newDiff {newPositionArray[d * nLanes + b] - particleJ.position[d]};
+                    oldDiff = (oldDiff > halfLengthCube) ? oldDiff - lengthCube
+                            : ((oldDiff < -halfLengthCube) ? oldDiff + lengthCube : oldDiff);
+                    newDiff = (newDiff > halfLengthCube) ? newDiff - lengthCube
+                            : ((newDiff < -halfLengthCube) ? newDiff + lengthCube : newDiff);
+                    oldSquareDistance += oldDiff * oldDiff;
+                    newSquareDistance += newDiff * newDiff;
+                }
+                const Real diameterI {getDiameterI(indexArray[b])};
+                const double diffEnergy {
+                        pairEnergyIJ(pairStyle, newSquareDistance, particleI.type, diameterI, indexJ)
+                        - pairEnergyIJ(pairStyle, oldSquareDistance, particleI.type, diameterI, indexJ)};
+                diffEnergyArray[b] += active ? diffEnergy : 0.;
+            }
+        }
+    });
+}
+
+/*******************************************************************************
+ * This function calculates the energy difference of the exchange of the types
+ * of two particles from the type-resolved energy cache. The cached rows count
+ * the i-j pair with the type the partner has before the swap, which is
+ * corrected here. Bond energies are computed directly.
+ *
+ * @param indexSwap1, indexSwap2 indices of the swapped particles.
+ *
+ * @return Energy difference of the swap.
+ ******************************************************************************/
+double Molecules::energySwapTypeEnergy(const int& indexSwap1, const int& indexSwap2) const
 {
-    int indexFlag {3 * indexParticle};
-    for(auto const& flag : m_newFlags)
+    const int nParticleTypes {m_systemPairPotentials.getParticleTypes()};
+    const int& typeA {m_particleArray[indexSwap1].type};
+    const int& typeB {m_particleArray[indexSwap2].type};
+
+    if (typeA == typeB)
     {
+        return 0.;
+    }
+
+    auto energyItBegin1 {m_typeEnergyArray.begin() + nParticleTypes * indexSwap1};
+    auto energyItBegin2 {m_typeEnergyArray.begin() + nParticleTypes * indexSwap2};
+    double energy {energyItBegin1[typeB - 1] - energyItBegin1[typeA - 1]
+                   + energyItBegin2[typeA - 1] - energyItBegin2[typeB - 1]};
 
-        m_flagsArray[indexFlag] += flag;
-        indexFlag++;
+    const bool bonded {std::find(getBondsItBeginI(indexSwap1), getBondsItEndI(indexSwap1), indexSwap2)
+                       != getBondsItEndI(indexSwap1)};
+
+    if (!bonded)
+    {
+        const double squareDistance {squareDistancePair(getPosItBeginI(indexSwap1), getPosItBeginI(indexSwap2))};
+        energy -= m_systemPairPotentials.pairEnergy(squareDistance, typeA, typeA);
+        energy -= m_systemPairPotentials.pairEnergy(squareDistance, typeB, typeB);
+        energy += 2. * m_systemPairPotentials.pairEnergy(squareDistance, typeA, typeB);
     }
+
+    energy += bondEnergyISwap(indexSwap1, getPosItBeginI(indexSwap1), indexSwap2);
+    energy += bondEnergyISwap(indexSwap2, getPosItBeginI(indexSwap2), indexSwap1);
+    return energy;
 }
 
-void Molecules::reinitializeFlags()
+/*******************************************************************************
+ * This function calculates the energy difference of the mutation of one
+ * particle to the type newType from the type-resolved energy cache. Bond
+ * energies are computed directly.
+ ******************************************************************************/
+double Molecules::energyMutationTypeEnergy(const int& indexParticle, const int& newType) const
 {
-    m_newFlags.clear();
+    const int nParticleTypes {m_systemPairPotentials.getParticleTypes()};
+    auto energyItBegin {m_typeEnergyArray.begin() + nParticleTypes * indexParticle};
+    double energy {energyItBegin[newType - 1] - energyItBegin[m_particleArray[indexParticle].type - 1]};
+    energy += bondEnergyIRetype(indexParticle, getPosItBeginI(indexParticle), newType, -1);
+    return energy;
 }
 
 /*******************************************************************************
@@ -191,17 +632,65 @@ void Molecules::reinitializeFlags()
 
 double Molecules::energySystemMolecule(const Neighbors& systemNeighbors) const
 {
-    double energy { 0. };
+    return reduceParticles([&](const int& indexParticle)
+    {
+        const auto& neighItBegin { systemNeighbors.getNeighItBeginI(indexParticle) };
+        const int& lenNeigh { systemNeighbors.getLenIndexBegin(indexParticle)};
+        return energyParticleMolecule(indexParticle, neighItBegin, lenNeigh) / 2.;
+    });
+}
 
-    for (int indexParticle = 0; indexParticle < m_nParticles; indexParticle++) //Outer loop for rows
+/*******************************************************************************
+ * This function returns the virial sum_{i<j} r_ij . F_ij of the system, from
+ * the same rows as energySystemMolecule.
+ ******************************************************************************/
+double Molecules::virialSystemMolecule(const Neighbors& systemNeighbors) const
+{
+    return reduceParticles([&](const int& indexParticle)
+    {
+        const auto& neighItBegin { systemNeighbors.getNeighItBeginI(indexParticle) };
+        const int& lenNeigh { systemNeighbors.getLenIndexBegin(indexParticle)};
+        return energyParticleMolecule<true>(indexParticle, neighItBegin, lenNeigh).virial / 2.;
+    });
+}
+
+/*******************************************************************************
+ * This function writes the force on each particle in forceArray (3 components
+ * per particle) and returns the energy of the system. Each particle sums its
+ * full neighbor row, so the rows are independent and the energy is reduced as
+ * in energySystemMolecule.
+ ******************************************************************************/
+double Molecules::forceSystemMolecule(const Neighbors& systemNeighbors, std::vector<double>& forceArray) const
+{
+    forceArray.resize(m_nDims * m_nParticles);
+
+    return reduceParticles([&](const int& indexParticle)
     {
         const auto& neighItBegin { systemNeighbors.getNeighItBeginI(indexParticle) };
         const int& lenNeigh { systemNeighbors.getLenIndexBegin(indexParticle)};
-        const double particleEnergy { energyParticleMolecule(indexParticle, neighItBegin, lenNeigh) };
-        energy += particleEnergy / 2.;
+        return forceParticleMolecule(indexParticle, neighItBegin, lenNeigh,
+                                     forceArray.begin() + m_nDims * indexParticle) / 2.;
+    });
+}
 
-     }
-    return energy;
+/*******************************************************************************
+ * This function returns the energy of each particle: half of its pair and bond
+ * energies, so that the array sums to the system's energy.
+ ******************************************************************************/
+std::vector<double> Molecules::energyParticleArray(const Neighbors& systemNeighbors) const
+{
+    std::vector<double> particleEnergyArray (m_nParticles);
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int indexParticle = 0; indexParticle < m_nParticles; indexParticle++) //Outer loop for rows
+    {
+        const auto& neighItBegin { systemNeighbors.getNeighItBeginI(indexParticle) };
+        const int& lenNeigh { systemNeighbors.getLenIndexBegin(indexParticle)};
+        particleEnergyArray[indexParticle] = energyParticleMolecule(indexParticle, neighItBegin, lenNeigh) / 2.;
+    }
+    return particleEnergyArray;
 }
 
 /*******************************************************************************
@@ -240,34 +729,33 @@ void Molecules::saveInXYZ(const std::string& path) const
     std::ofstream fOut(path);
 
     fOut << m_saveHeaderString;
-    int it {0};
     std::string space {" "};
-    for(auto const& x : m_positionArray)
+    for (int i = 0; i < m_nParticles; i++)
     {
+        fOut << m_moleculeTypeArray[i];
+        fOut << space;
+        fOut << m_particleArray[i].type;
+        fOut << space;
 
-        if ((it%m_nDims)==0)
+        if (m_polydisperse)
         {
-            fOut << m_moleculeTypeArray[it / 3];
+            fOut << m_diameterArray[i] / 2;
             fOut << space;
-            fOut << m_particleTypeArray[it / 3];
-            fOut << space;
-
         }
 
-        fOut << x;
-        fOut << space;
-
-        if ((it%m_nDims)==m_nDims-1)
+        for (const auto& x : m_particleArray[i].position)
         {
-            fOut << m_flagsArray[it-2];
+            fOut << x;
             fOut << space;
-            fOut << m_flagsArray[it-1];
-            fOut << space;
-            fOut << m_flagsArray[it];
-            fOut << "\n";
         }
-        it++;
 
+        const int indexFlag {m_nDims * i};
+        fOut << m_flagsArray[indexFlag];
+        fOut << space;
+        fOut << m_flagsArray[indexFlag + 1];
+        fOut << space;
+        fOut << m_flagsArray[indexFlag + 2];
+        fOut << "\n";
     }
     fOut.close();
 }
@@ -11,9 +11,12 @@
 #include <algorithm>
 #include <typeinfo>
 #include <tuple>
+#include <array>
 #include "../INPUT/Parameter.h"
 #include "../POTENTIALS/PairPotentials.h"
 #include "../POTENTIALS/BondPotentials.h"
+#include "../types.h"
+#include "../util.h"
 
 
 class Neighbors;
@@ -27,18 +30,31 @@ private:
     const int m_nDims {3};
     const PairPotentials m_systemPairPotentials {};
     const BondPotentials m_systemBondPotentials {};
-    const int m_nParticles {};
-    const double m_lengthCube {};
-    const double m_halfLengthCube {};
-    const std::vector<int> m_bondsArray {};
-    const std::vector<int> m_bondsIndex {};
-    std::vector<int> m_newFlags;
-    std::vector<int> m_flagsArray {};
-    std::vector<double> m_positionArray {};
-    std::vector<int> m_particleTypeArray {};
+    int m_nParticles {};                                            // Changed by assignParticles only.
+    double m_lengthCube {};                                         // Changed by the volume moves only.
+    double m_halfLengthCube {};
+    std::vector<int> m_bondsArray {};
+    std::vector<int> m_bondsIndex {};
+    // Hot data: positions and particle types, packed per particle.
+    std::vector<ParticleRecord> m_particleArray {};
+    const bool m_polydisperse {};                                   // Continuous diameters, read from the radius column.
+    std::vector<Real> m_diameterArray {};                           // Diameter of each particle (polydisperse only).
+    // Cold data: only read when saving or for molecule moves.
+    std::vector<int> m_flagsArray {};                               // Image counters, updated on accepted moves only.
     std::vector<int> m_moleculeTypeArray {};
-    const std::string m_saveHeaderString{};
-    using PosIterator = std::vector<double>::const_iterator;
+    std::vector<int> m_moleculeIndex {};                            // Molecule table: first particle of each molecule.
+    std::vector<int> m_particleMoleculeArray {};                    // Molecule table row of each particle.
+    std::vector<int> m_chainArray {};                               // Members of each molecule in bond order.
+    std::vector<bool> m_linearMoleculeArray {};                     // True if the molecule is a linear chain.
+    std::string m_saveHeaderString{};                               // Rebuilt when the box is rescaled.
+    // Optional swap cache: pair energy of each particle with its neighbor row as if it had each particle type.
+    std::vector<double> m_typeEnergyArray {};
+    // Optional index of the particles by type for the non-local swaps: m_typeBucketArray[t - 1] lists the particles
+    // of type t in any order and m_bucketSlotArray[i] is the position of particle i in its list.
+    std::vector<std::vector<int>> m_typeBucketArray {};
+    std::vector<int> m_bucketSlotArray {};
+    static constexpr int m_reductionBlockSize {256};                 // Particles per block of the full-system sums.
+    using PosIterator = const Real*;
     using BondsIterator = std::vector<int>::const_iterator;
 
     //std::vector<double> typeArray{1, 2};
@@ -53,11 +69,14 @@ private:
             , m_halfLengthCube (0.5 * m_lengthCube)
             , m_bondsArray(std::get<0>(bondsData))
             , m_bondsIndex(std::get<1>(bondsData))
-            , m_saveHeaderString(initializeHeaderString(m_nParticles, m_lengthCube))
+            , m_polydisperse(param.get_bool("polydisperse", false))
+            , m_saveHeaderString(initializeHeaderString(m_nParticles, m_lengthCube, m_polydisperse))
 
     {
         m_flagsArray.resize(m_nDims * m_nParticles, 0);
         initializeParticles(path);
+        initializeMoleculeTable();
+        initializeChainTable();
 
     }
 
@@ -84,15 +103,21 @@ private:
         int row{};
         infile >> row;
 
-        int col { 8 };
+        // molecule_type type (radius) x y z flags
+        const int col { m_polydisperse ? 9 : 8 };
+        const int colPosition { m_polydisperse ? 3 : 2 };
 
         std::string line;
         getline(infile, line);
         getline(infile, line);
 
         m_moleculeTypeArray.resize(row);
-        m_particleTypeArray.resize(row);
-        m_positionArray.resize(m_nDims * row);
+        m_particleArray.resize(row);
+
+        if (m_polydisperse)
+        {
+            m_diameterArray.resize(row);
+        }
         //std::vector<std::vector <double>> positionArray(row, std::vector<double>(3));
         //std::vector<double> typeArray (row);
         //std::vector<int> moleculeType (row , 1);
@@ -112,12 +137,18 @@ private:
                 else if (c == 1)
                 {
 
-                    infile >> m_particleTypeArray[r];
+                    infile >> m_particleArray[r].type;
                 }
 
-                else if (c < 5)
+                else if (c < colPosition)
                 {
-                    infile >> m_positionArray[m_nDims * r + c - (col - 6)];
+                    Real radius {};
+                    infile >> radius;
+                    m_diameterArray[r] = 2 * radius;
+                }
+                else if (c < colPosition + 3)
+                {
+                    infile >> m_particleArray[r].position[c - colPosition];
                     //Take INPUT from file and put into positionArray
                 }
                 else
@@ -126,10 +157,9 @@ private:
                 }
             }
         }
-        for (auto it=m_positionArray.begin(); it < m_positionArray.end(); it+=m_nDims)
+        for (int i = 0; i < row; i++)
         {
-            periodicBC(it);
-            reinitializeFlags();
+            periodicBC(m_particleArray[i].position, m_flagsArray.begin() + m_nDims * i);
         }
         infile.close();
 
@@ -143,7 +173,8 @@ public:
     {
     }
 
-    static std::string initializeHeaderString(const int& nParticles, const double& lengthCube)
+    static std::string initializeHeaderString(const int& nParticles, const double& lengthCube,
+                                              const bool& polydisperse)
     {
         std::string headerString {std::to_string(nParticles)};
         headerString.append("\n");
@@ -157,7 +188,8 @@ public:
         headerString.append(zeroString);
         headerString.append(lengthStr);
         headerString.append("\"");
-        headerString.append(" Properties=molecule_type:S:1:type:I:1:pos:R:3:");
+        headerString.append(polydisperse ? " Properties=molecule_type:S:1:type:I:1:radius:R:1:pos:R:3:"
+                                         : " Properties=molecule_type:S:1:type:I:1:pos:R:3:");
         headerString.append("\n");
         return headerString;
     }
@@ -206,8 +238,6 @@ public:
         return std::make_tuple(bondsArray, bondsIndex);
     }
 
-    void updateFlags(const int& indexParticle);
-
     template<typename InputIt>
     void updatePositionI(const int& i, InputIt newPosItBegin)
     {
@@ -217,13 +247,62 @@ public:
     template<typename InputIt>
     void updatePositionI(const int& i, InputIt newPosItBegin, const int& lenPos)
     {
-        const int realIndex {i * m_nDims};
-        std::copy(newPosItBegin, newPosItBegin + lenPos, m_positionArray.begin() + realIndex);
+        // lenPos can span several consecutive particles.
+        for (int k = 0; k < lenPos / m_nDims; k++)
+        {
+            updateFlags(i + k, newPosItBegin);
+            std::copy(newPosItBegin, newPosItBegin + m_nDims, m_particleArray[i + k].position);
+            newPosItBegin += m_nDims;
+        }
+    }
+
+    template<typename InputIt, typename DispIt>
+    void displacePositionI(const int& i, InputIt newPosItBegin, DispIt displacementItBegin)
+/*
+ * Same as updatePositionI for a move whose unwrapped displacement is known and can exceed half the box: the image
+ * counters are set so that the unwrapped position moves by the displacement.
+ */
+    {
+        auto flagItBegin {m_flagsArray.begin() + m_nDims * i};
+        Real* posItBegin {m_particleArray[i].position};
+
+        for (int d = 0; d < m_nDims; d++)
+        {
+            const double shift {posItBegin[d] + displacementItBegin[d] - static_cast<double>(newPosItBegin[d])};
+            flagItBegin[d] += static_cast<int>(std::lround(shift / m_lengthCube));
+            posItBegin[d] = newPosItBegin[d];
+        }
+    }
+
+    template<typename InputIt>
+    void updateFlags(const int& i, InputIt newPosItBegin)
+/*
+ * Image counters are only updated when a move is accepted. A move displaces a particle by less than half the box,
+ * so a jump larger than half the box between the old and the new wrapped positions means that the particle crossed
+ * a side of the box. The moves that can break this (regrowth) use displacePositionI.
+ */
+    {
+        auto flagItBegin {m_flagsArray.begin() + m_nDims * i};
+        const Real* posItBegin {m_particleArray[i].position};
+
+        for (int d = 0; d < m_nDims; d++)
+        {
+            const double jump {static_cast<double>(newPosItBegin[d]) - posItBegin[d]};
+
+            if (jump < -m_halfLengthCube)
+            {
+                ++flagItBegin[d];
+            }
+            else if (jump > m_halfLengthCube)
+            {
+                --flagItBegin[d];
+            }
+        }
     }
 
 
     template<typename InputIt>
-    void periodicBC(InputIt posItBegin)
+    void periodicBC(InputIt posItBegin) const
 /*
  *This function is an implementation of the periodic Boundary conditions.
  *If a particle gets out of the simulation box from one of the sides, it gets back in the box from the opposite side.
@@ -231,27 +310,53 @@ public:
     {
         for (int i = 0; i < m_nDims; i++)
         {
-            //std::cout <<  m_newFlags[i] << "\n";
             const auto& posI {*posItBegin};
             if (posI < 0)
             {
                 *posItBegin += m_lengthCube;
-                m_newFlags.push_back(-1);
             }
             else if (posI > m_lengthCube)
             {
                 *posItBegin -= m_lengthCube;
-                m_newFlags.push_back(1);
-            }
-            else
-            {
-                m_newFlags.push_back(0);
             }
             posItBegin++;
         }
     }
 
+    template<typename InputIt, typename FlagIt>
+    void periodicBC(InputIt posItBegin, FlagIt flagItBegin) const
+/*
+ * Same as above for positions that can be several boxes away, e.g. read from a file. The number of crossed boxes
+ * is added to the image counters.
+ */
+    {
+        for (int i = 0; i < m_nDims; i++)
+        {
+            const int image {static_cast<int>(std::floor(*posItBegin / m_lengthCube))};
+            *posItBegin -= image * m_lengthCube;
+            *flagItBegin += image;
+            posItBegin++;
+            flagItBegin++;
+        }
+    }
+
+    template<typename OutputIt>
+    void getUnwrappedPositionI(const int& i, OutputIt outItBegin) const
+    {
+        auto flagItBegin {m_flagsArray.begin() + m_nDims * i};
+
+        for (int d = 0; d < m_nDims; d++)
+        {
+            *outItBegin = m_particleArray[i].position[d] + flagItBegin[d] * m_lengthCube;
+            outItBegin++;
+        }
+    }
+
+    [[nodiscard]] std::vector<double> getUnwrappedPositionArray() const;
 
+    [[nodiscard]] double meanSquareDisplacement(const std::vector<double>& referencePositionArray) const;
+
+    void saveDisplacement(const std::vector<double>& referencePositionArray, const std::string& path) const;
 
     [[nodiscard]] const int& getNParticles() const;
 
@@ -268,200 +373,888 @@ public:
 
     [[nodiscard]] const double& getHalfLengthCube() const;
 
+    void rescaleBox(const double& scaleFactor);
+
+    void restoreBox(const std::vector<ParticleRecord>& particleArray, const double& lengthCube);
+
+    [[nodiscard]] const std::vector<ParticleRecord>& getParticleRecordArray() const;
+
     void saveInXYZ(const std::string& path) const;
 
     void swapParticleTypesIJ(const int &i, const int &j);
 
+    void swapParticleDiametersIJ(const int &i, const int &j);
+
+    void setParticleTypeI(const int &i, const int &newType);
+
+    void initializeTypeBuckets();
+
+    [[nodiscard]] int getNParticleTypes() const;
+
+    [[nodiscard]] int getTypeBucketSize(const int& type) const
+    {
+        return static_cast<int>(m_typeBucketArray[type - 1].size());
+    }
+
+    [[nodiscard]] int getTypeBucketParticle(const int& type, const int& k) const
+    {
+        return m_typeBucketArray[type - 1][k];
+    }
+
+    [[nodiscard]] bool isPolydisperse() const;
+
+    [[nodiscard]] double getMaxSquareSigma() const;
+
     [[nodiscard]] double energySystemMolecule(const Neighbors &systemNeighbors) const;
 
+    [[nodiscard]] double virialSystemMolecule(const Neighbors &systemNeighbors) const;
 
-    template<typename InputIt>
-    double feneBondEnergyI(const int& indexParticle, InputIt posItBegin) const
+    double forceSystemMolecule(const Neighbors &systemNeighbors, std::vector<double>& forceArray) const;
+
+    [[nodiscard]] const std::vector<int>& getFlagsArray() const;
+
+    void restoreParticles(const std::vector<ParticleRecord>& particleArray, const std::vector<int>& flagsArray);
+
+    void assignParticles(std::vector<ParticleRecord> particleArray, std::vector<int> flagsArray,
+                         std::vector<int> moleculeTypeArray, std::vector<Real> diameterArray,
+                         std::vector<int> bondsArray, std::vector<int> bondsIndex);
+
+    [[nodiscard]] std::vector<double> energyParticleArray(const Neighbors &systemNeighbors) const;
+
+    template<typename ParticleFunction>
+    [[nodiscard]] double reduceParticles(ParticleFunction particleFunction) const
+/*
+ * Sums particleFunction(i) over all particles. The particles are cut in fixed blocks of m_reductionBlockSize that are
+ * summed pairwise, then the block sums are combined pairwise. The decomposition does not depend on the number of
+ * threads, so the result is bitwise identical for any OpenMP schedule.
+ */
     {
-        double energy { 0. };
+        const int nBlocks {(m_nParticles + m_reductionBlockSize - 1) / m_reductionBlockSize};
+        std::vector<double> blockSumArray (nBlocks);
+
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
+        for (int indexBlock = 0; indexBlock < nBlocks; indexBlock++)
+        {
+            const int indexBegin {indexBlock * m_reductionBlockSize};
+            const int indexEnd {std::min(indexBegin + m_reductionBlockSize, m_nParticles)};
+            std::array<double, m_reductionBlockSize> valueArray {};
+
+            for (int indexParticle = indexBegin; indexParticle < indexEnd; indexParticle++)
+            {
+                valueArray[indexParticle - indexBegin] = particleFunction(indexParticle);
+            }
+            blockSumArray[indexBlock] = pairwiseSum(valueArray.begin(), valueArray.begin() + (indexEnd - indexBegin));
+        }
+        return pairwiseSum(blockSumArray.begin(), blockSumArray.end());
+    }
+
+
+    [[nodiscard]] Real getDiameterI(const int& i) const
+    {
+        return m_polydisperse ? m_diameterArray[i] : Real{1};
+    }
 
+    template<typename Style>
+    [[nodiscard]] Real pairEnergyIJ(const Style& pairStyle, const Real& squareDistance, const int& typeI,
+                                    const Real& diameterI, const int& indexJ) const
+/*
+ * Pair energy of a particle of type typeI and diameter diameterI with the particle indexJ. The diameters only enter
+ * in polydisperse mode, see PairPotentials::getSquareSigmaIJ.
+ */
+    {
+        const int& typeJ {m_particleArray[indexJ].type};
+
+        if (m_polydisperse)
+        {
+            return m_systemPairPotentials.pairEnergy(
+                    pairStyle, squareDistance, typeI, typeJ,
+                    m_systemPairPotentials.getSquareSigmaIJ(diameterI, m_diameterArray[indexJ]));
+        }
+        return m_systemPairPotentials.pairEnergy(pairStyle, squareDistance, typeI, typeJ);
+    }
+
+    template<typename Style>
+    [[nodiscard]] Real pairForceDivRIJ(const Style& pairStyle, const Real& squareDistance, const int& typeI,
+                                       const Real& diameterI, const int& indexJ) const
+    {
+        const int& typeJ {m_particleArray[indexJ].type};
+
+        if (m_polydisperse)
+        {
+            return m_systemPairPotentials.pairForceDivR(
+                    pairStyle, squareDistance, typeI, typeJ,
+                    m_systemPairPotentials.getSquareSigmaIJ(diameterI, m_diameterArray[indexJ]));
+        }
+        return m_systemPairPotentials.pairForceDivR(pairStyle, squareDistance, typeI, typeJ);
+    }
+
+    template<bool WithVirial = false, typename InputIt>
+    EnergyResult<WithVirial> bondEnergyI(const int& indexParticle, InputIt posItBegin) const
+    {
         const auto &bondsItBegin { getBondsItBeginI(indexParticle) };
         const auto &bondsItEnd {getBondsItEndI(indexParticle)};
-        const int& particleTypeI { m_particleTypeArray[indexParticle] };
+        const int& particleTypeI { m_particleArray[indexParticle].type };
 
-        for (auto it = bondsItBegin; it < bondsItEnd; it++)
+        return m_systemBondPotentials.visitStyle([&](const auto& bondStyle)
         {
-            const int& indexJ {*it};
-            const int& particleTypeJ { m_particleTypeArray[indexJ] };
+            double energy { 0. };
+            double virial { 0. };
+
+            for (auto it = bondsItBegin; it < bondsItEnd; it++)
+            {
+                const ParticleRecord& particleJ {m_particleArray[*it]};
 
-            const double squareDistance { squareDistancePair(posItBegin,
-                                                                 getPosItBeginI(indexJ)) };
-            energy += m_systemBondPotentials.feneBondEnergyIJ(squareDistance, particleTypeI, particleTypeJ);
+                const Real squareDistance { squareDistancePair(posItBegin, particleJ.position) };
+                energy += m_systemBondPotentials.bondEnergyIJ(bondStyle, squareDistance,
+                                                              particleTypeI, particleJ.type);
 
-        }
-        return energy;
+                if constexpr (WithVirial)
+                {
+                    virial += m_systemBondPotentials.bondForceDivR(bondStyle, squareDistance,
+                                                                   particleTypeI, particleJ.type) * squareDistance;
+                }
+            }
+            return makeEnergyResult<WithVirial>(energy, virial);
+        });
     }
 
 
-    template<typename InputPosIt, typename InputNeighIt>
-    double energyPairParticle(const int& indexParticle, InputPosIt posItBegin,
-                              InputNeighIt NeighItBegin, const int& lenNeigh) const
+    template<bool WithVirial = false, typename InputPosIt, typename InputNeighIt>
+    EnergyResult<WithVirial> energyPairParticle(const int& indexParticle, InputPosIt posItBegin,
+                                                InputNeighIt NeighItBegin, const int& lenNeigh) const
+/*
+ * Pair energy of a particle with its neighbor row. WithVirial also sums r_ij . F_ij in the same pass.
+ */
     {
-        double energy { 0. };
-        const int& particleType {m_particleTypeArray[indexParticle]};
+        const int& particleType {m_particleArray[indexParticle].type};
+        const Real diameter {getDiameterI(indexParticle)};
 
-        for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
+        return m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
         {
-            const int& indexJ {*it};
-
-            const int& typeJ { m_particleTypeArray[indexJ] };
-            const double squareDistance { squareDistancePair(posItBegin,
-                                                             getPosItBeginI(indexJ)) };
-            energy += m_systemPairPotentials.ljPairEnergy(squareDistance, particleType, typeJ);
+            double energy { 0. };
+            double virial { 0. };
 
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
+            {
+                const ParticleRecord& particleJ {m_particleArray[*it]};
+                const Real squareDistance { squareDistancePair(posItBegin, particleJ.position) };
+                energy += pairEnergyIJ(pairStyle, squareDistance, particleType, diameter, *it);
 
-        }
-        return energy;
+                if constexpr (WithVirial)
+                {
+                    virial += pairForceDivRIJ(pairStyle, squareDistance, particleType, diameter, *it) * squareDistance;
+                }
+            }
+            return makeEnergyResult<WithVirial>(energy, virial);
+        });
     }
 
-    template<typename InputPosIt, typename InputNeighIt>
-    double energyParticleMolecule(const int& indexParticle, InputPosIt posItBegin,
-                                  InputNeighIt NeighItBegin, const int& lenNeigh) const
+    template<bool WithVirial = false, typename InputPosIt, typename InputNeighIt>
+    EnergyResult<WithVirial> energyParticleMolecule(const int& indexParticle, InputPosIt posItBegin,
+                                                    InputNeighIt NeighItBegin, const int& lenNeigh) const
     {
-        double energy { 0. };
-        energy += energyPairParticle(indexParticle, posItBegin, NeighItBegin, lenNeigh);
-        energy += feneBondEnergyI(indexParticle, posItBegin);
+        EnergyResult<WithVirial> energy {};
+        energy += energyPairParticle<WithVirial>(indexParticle, posItBegin, NeighItBegin, lenNeigh);
+        energy += bondEnergyI<WithVirial>(indexParticle, posItBegin);
         return energy;
     }
 
-    template<typename InputNeighIt>
-    double energyParticleMolecule(int indexParticle, InputNeighIt NeighItBegin, const int& lenNeigh) const
+    template<bool WithVirial = false, typename InputNeighIt>
+    EnergyResult<WithVirial> energyParticleMolecule(int indexParticle, InputNeighIt NeighItBegin,
+                                                    const int& lenNeigh) const
     {
 
         const auto& posItBegin {getPosItBeginI(indexParticle)};
-        return energyParticleMolecule(indexParticle, posItBegin, NeighItBegin, lenNeigh);
+        return energyParticleMolecule<WithVirial>(indexParticle, posItBegin, NeighItBegin, lenNeigh);
     }
 
-    void reinitializeFlags();
-
-    template<typename InputPosIt, typename InputNeighIt>
-    double energyPairParticleExtraMolecule(const int& indexParticle, InputPosIt posItBegin,
-                                  InputNeighIt NeighItBegin, const int& lenNeigh, const int& typeMoleculeI) const
+    template<typename InputPosIt, typename InputNeighIt, typename NeighPosIt>
+    double energyParticleMoleculeAt(const int& indexParticle, InputPosIt posItBegin, InputNeighIt neighItBegin,
+                                    const int& lenNeigh, NeighPosIt neighPosItBegin) const
+/*
+ * Same as energyParticleMolecule, the positions of the neighbor row and then of the bonded particles being read from
+ * neighPosItBegin (m_nDims per particle) instead of the particle records, see MonteCarlo::mcSpeculativeTranslations.
+ */
     {
+        const int& particleType {m_particleArray[indexParticle].type};
+        const Real diameter {getDiameterI(indexParticle)};
 
+        double energy {m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            double pairEnergy { 0. };
+
+            for (int k = 0; k < lenNeigh; k++)
+            {
+                const Real squareDistance { squareDistancePair(posItBegin, neighPosItBegin + m_nDims * k) };
+                pairEnergy += pairEnergyIJ(pairStyle, squareDistance, particleType, diameter, neighItBegin[k]);
+            }
+            return pairEnergy;
+        })};
+        const NeighPosIt bondPosItBegin {neighPosItBegin + m_nDims * lenNeigh};
+
+        energy += m_systemBondPotentials.visitStyle([&](const auto& bondStyle)
+        {
+            double bondEnergy { 0. };
+            int k {0};
+
+            for (auto it = getBondsItBeginI(indexParticle); it < getBondsItEndI(indexParticle); ++it, ++k)
+            {
+                const Real squareDistance { squareDistancePair(posItBegin, bondPosItBegin + m_nDims * k) };
+                bondEnergy += m_systemBondPotentials.bondEnergyIJ(bondStyle, squareDistance, particleType,
+                                                                  m_particleArray[*it].type);
+            }
+            return bondEnergy;
+        });
+        return energy;
+    }
+
+    template<typename InputNeighIt, typename OutputIt>
+    double forceParticleMolecule(const int& indexParticle, InputNeighIt NeighItBegin, const int& lenNeigh,
+                                 OutputIt forceItBegin) const
+/*
+ * Writes the force on indexParticle from its neighbor row and its bonds, F_i = sum_j forceDivR * (r_i - r_j), and
+ * returns its pair and bond energy. The row is only read, so the particles can be processed in parallel.
+ */
+    {
+        const ParticleRecord& particleI {m_particleArray[indexParticle]};
+        const Real diameter {getDiameterI(indexParticle)};
+        const Real lengthCube {static_cast<Real>(m_lengthCube)};
+        const Real halfLengthCube {static_cast<Real>(m_halfLengthCube)};
         double energy { 0. };
-        const int& particleType {m_particleTypeArray[indexParticle]};
+        std::array<double, 3> force {};
 
-        for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
+        // Minimum image vector r_i - r_j and its square norm.
+        const auto separation {[&](const Real* posItBeginJ, std::array<Real, 3>& diff)
         {
-            const int indexJ {*it};
-            const int& typeMoleculeJ {m_moleculeTypeArray[indexJ]};
+            Real squareDistance { 0. };
 
-            if (typeMoleculeJ != typeMoleculeI)
+            for (int d = 0; d < 3; d++)
+            {
+                diff[d] = particleI.position[d] - posItBeginJ[d];
+                diff[d] -= (diff[d] > halfLengthCube) ? lengthCube : ((diff[d] < -halfLengthCube) ? -lengthCube : 0);
+                squareDistance += diff[d] * diff[d];
+            }
+            return squareDistance;
+        }};
+
+        m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
             {
-                const int& typeJ {m_particleTypeArray[indexJ]};
-                const double squareDistance { squareDistancePair(posItBegin, m_positionArray.begin() + m_nDims * indexJ)};
-                energy += m_systemPairPotentials.ljPairEnergy(squareDistance, particleType, typeJ);
+                std::array<Real, 3> diff {};
+                const Real squareDistance {separation(m_particleArray[*it].position, diff)};
+                const double forceDivR {pairForceDivRIJ(pairStyle, squareDistance, particleI.type, diameter, *it)};
+                energy += pairEnergyIJ(pairStyle, squareDistance, particleI.type, diameter, *it);
 
+                for (int d = 0; d < 3; d++)
+                {
+                    force[d] += forceDivR * diff[d];
+                }
             }
-        }
+        });
+
+        m_systemBondPotentials.visitStyle([&](const auto& bondStyle)
+        {
+            for (auto it = getBondsItBeginI(indexParticle); it < getBondsItEndI(indexParticle); ++it)
+            {
+                const ParticleRecord& particleJ {m_particleArray[*it]};
+                std::array<Real, 3> diff {};
+                const Real squareDistance {separation(particleJ.position, diff)};
+                const double forceDivR {m_systemBondPotentials.bondForceDivR(bondStyle, squareDistance,
+                                                                             particleI.type, particleJ.type)};
+                energy += m_systemBondPotentials.bondEnergyIJ(bondStyle, squareDistance, particleI.type,
+                                                              particleJ.type);
+
+                for (int d = 0; d < 3; d++)
+                {
+                    force[d] += forceDivR * diff[d];
+                }
+            }
+        });
+        std::copy(force.begin(), force.end(), forceItBegin);
         return energy;
+    }
+
+    template<bool WithVirial = false, typename InputPosIt, typename InputNeighIt>
+    EnergyResult<WithVirial> energyPairParticleExtraMolecule(const int& indexParticle, InputPosIt posItBegin,
+                                  InputNeighIt NeighItBegin, const int& lenNeigh, const int& typeMoleculeI) const
+    {
+
+        const int& particleType {m_particleArray[indexParticle].type};
+        const Real diameter {getDiameterI(indexParticle)};
+
+        return m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            double energy { 0. };
+            double virial { 0. };
+
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
+            {
+                const int indexJ {*it};
+                const int& typeMoleculeJ {m_moleculeTypeArray[indexJ]};
+
+                if (typeMoleculeJ != typeMoleculeI)
+                {
+                    const ParticleRecord& particleJ {m_particleArray[indexJ]};
+                    const Real squareDistance { squareDistancePair(posItBegin, particleJ.position)};
+                    energy += pairEnergyIJ(pairStyle, squareDistance, particleType, diameter, indexJ);
+
+                    if constexpr (WithVirial)
+                    {
+                        virial += pairForceDivRIJ(pairStyle, squareDistance, particleType, diameter, indexJ)
+                                  * squareDistance;
+                    }
+                }
+            }
+            return makeEnergyResult<WithVirial>(energy, virial);
+        });
 
     }
 
-    template<typename InputNeighIt>
-    double energyPairParticleExtraMolecule(const int& indexParticle,
+    template<bool WithVirial = false, typename InputNeighIt>
+    EnergyResult<WithVirial> energyPairParticleExtraMolecule(const int& indexParticle,
                                        InputNeighIt NeighItBegin, const int& lenNeigh, const int& typeMoleculeI) const
     {
-        auto posItBegin {m_positionArray.begin() + m_nDims * indexParticle};
-        return energyPairParticleExtraMolecule(indexParticle, posItBegin, NeighItBegin, lenNeigh, typeMoleculeI);
+        auto posItBegin {getPosItBeginI(indexParticle)};
+        return energyPairParticleExtraMolecule<WithVirial>(indexParticle, posItBegin, NeighItBegin, lenNeigh,
+                                                           typeMoleculeI);
     }
 
 
 
-    template<typename InputPosIt, typename InputNeighIt>
-    double energyPairParticleSwap(const int& indexParticle, InputPosIt posItBegin,
-                                  InputNeighIt NeighItBegin, const int& lenNeigh,
-                                  const int& indexSwap) const
+    template<bool WithVirial = false, typename InputPosIt, typename InputNeighIt, typename ExcludedIt>
+    EnergyResult<WithVirial> energyParticleExcluding(const int& indexParticle, InputPosIt posItBegin,
+                                   InputNeighIt NeighItBegin, const int& lenNeigh,
+                                   ExcludedIt excludedItBegin, ExcludedIt excludedItEnd) const
+/*
+ * Pair and bond energy of a particle with all the particles that are not in the sorted range
+ * [excludedItBegin, excludedItEnd). Used by the moves that displace a group of particles rigidly: the energy between
+ * the moved particles does not change.
+ */
     {
-        double energy { 0. };
-        const int& particleType {m_particleTypeArray[indexParticle]};
-        const int& swapParticleType {m_particleTypeArray[indexSwap]};
+        const int& particleType {m_particleArray[indexParticle].type};
+        const Real diameter {getDiameterI(indexParticle)};
+        const auto isExcluded {[&](const int& indexJ)
+                               { return std::binary_search(excludedItBegin, excludedItEnd, indexJ); }};
 
-        for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; it++)
+        EnergyResult<WithVirial> energy {m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
         {
-            const int& indexJ {*it};
-            if (indexJ != indexSwap)
-            {
+            double pairEnergy { 0. };
+            double pairVirial { 0. };
 
-                const int& typeJ { m_particleTypeArray[indexJ] };
-                const double squareDistance { squareDistancePair(posItBegin,
-                                                                 m_positionArray.begin() + m_nDims*indexJ) };
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
+            {
+                if (!isExcluded(*it))
+                {
+                    const ParticleRecord& particleJ {m_particleArray[*it]};
+                    const Real squareDistance { squareDistancePair(posItBegin, particleJ.position) };
+                    pairEnergy += pairEnergyIJ(pairStyle, squareDistance, particleType, diameter, *it);
+
+                    if constexpr (WithVirial)
+                    {
+                        pairVirial += pairForceDivRIJ(pairStyle, squareDistance, particleType, diameter, *it)
+                                      * squareDistance;
+                    }
+                }
+            }
+            return makeEnergyResult<WithVirial>(pairEnergy, pairVirial);
+        })};
 
-                energy += m_systemPairPotentials.ljPairEnergy(squareDistance, swapParticleType, typeJ);
-                energy -= m_systemPairPotentials.ljPairEnergy(squareDistance, particleType, typeJ);
+        energy += m_systemBondPotentials.visitStyle([&](const auto& bondStyle)
+        {
+            double bondEnergy { 0. };
+            double bondVirial { 0. };
 
+            for (auto it = getBondsItBeginI(indexParticle); it < getBondsItEndI(indexParticle); ++it)
+            {
+                if (!isExcluded(*it))
+                {
+                    const ParticleRecord& particleJ {m_particleArray[*it]};
+                    const Real squareDistance { squareDistancePair(posItBegin, particleJ.position) };
+                    bondEnergy += m_systemBondPotentials.bondEnergyIJ(bondStyle, squareDistance,
+                                                                      particleType, particleJ.type);
+
+                    if constexpr (WithVirial)
+                    {
+                        bondVirial += m_systemBondPotentials.bondForceDivR(bondStyle, squareDistance, particleType,
+                                                                           particleJ.type) * squareDistance;
+                    }
+                }
             }
-        }
+            return makeEnergyResult<WithVirial>(bondEnergy, bondVirial);
+        });
         return energy;
     }
 
-    template<typename InputIt>
-    [[nodiscard]] double feneBondEnergyISwap(const int& indexParticle, InputIt posItBegin,
-                               const int& indexSwap) const
+    template<typename CandidateIt>
+    void energyTrialBatch(const int& indexParticle, const Real* trialArray, const int& nTrials,
+                          CandidateIt candidateItBegin, CandidateIt candidateItEnd, double* energyArray) const
+/*
+ * Pair energies of nTrials positions of the particle indexParticle with the candidate particles.
+ */
     {
-        double energy { 0. };
+        energyTrialBatch(m_particleArray[indexParticle].type, getDiameterI(indexParticle), trialArray, nTrials,
+                         candidateItBegin, candidateItEnd, energyArray);
+    }
+
+    template<typename CandidateIt>
+    void energyTrialBatch(const int& particleType, const Real& diameter, const Real* trialArray, const int& nTrials,
+                          CandidateIt candidateItBegin, CandidateIt candidateItEnd, double* energyArray) const
+/*
+ * Pair energies of nTrials positions of a particle of type particleType and diameter diameter with the candidate
+ * particles. trialArray stores the trials as structure of arrays: x of all trials, then y, then z. Each candidate is
+ * loaded once and the inner loop over the trials has no data-dependent branch, so it vectorizes. In polydisperse mode
+ * the square distances are scaled by sigma_ij^2, computed once per candidate.
+ */
+    {
+        const Real lengthCube {static_cast<Real>(m_lengthCube)};
+        const Real halfLengthCube {static_cast<Real>(m_halfLengthCube)};
+        const Real* trialX {trialArray};
+        const Real* trialY {trialArray + nTrials};
+        const Real* trialZ {trialArray + 2 * nTrials};
+        std::fill(energyArray, energyArray + nTrials, 0.);
+
+        m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            for (auto it = candidateItBegin; it < candidateItEnd; ++it)
+            {
+                const ParticleRecord& particleJ {m_particleArray[*it]};
+                const Real squareSigmaIJ {m_polydisperse
+                                          ? m_systemPairPotentials.getSquareSigmaIJ(diameter, m_diameterArray[*it])
+                                          : Real{1}};
+
+                for (int k = 0; k < nTrials; k++)
+                {
+                    Real dx {trialX[k] - particleJ.position[0]};
+                    Real dy {trialY[k] - particleJ.position[1]};
+                    Real dz {trialZ[k] - particleJ.position[2]};
+                    dx = (dx > halfLengthCube) ? dx - lengthCube : ((dx < -halfLengthCube) ? dx + lengthCube : dx);
+                    dy = (dy > halfLengthCube) ? dy - lengthCube : ((dy < -halfLengthCube) ? dy + lengthCube : dy);
+                    dz = (dz > halfLengthCube) ? dz - lengthCube : ((dz < -halfLengthCube) ? dz + lengthCube : dz);
+                    energyArray[k] += m_systemPairPotentials.pairEnergy(pairStyle,
+                                                                        (dx * dx + dy * dy + dz * dz) / squareSigmaIJ,
+                                                                        particleType, particleJ.type);
+                }
+            }
+        });
+    }
+
+    void energyDiffBatch(const std::vector<int>& indexArray, const std::vector<Real>& newPositionArray,
+                         const std::vector<const int*>& rowArray, const std::vector<int>& lenArray,
+                         std::vector<double>& diffEnergyArray) const;
+
+    template<bool WithVirial = false, typename IndexIt, typename InputPosIt>
+    EnergyResult<WithVirial> energyPairsWithin(IndexIt indexItBegin, const int& len, InputPosIt posItBegin) const
+/*
+ * Pair energy of the non-bonded pairs among the particles indexItBegin[0..len) placed at posItBegin, with the minimum
+ * image convention. The rigid moves leave it unchanged, except for molecules larger than half the box whose members
+ * meet the images of other members.
+ */
+    {
+        return m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            double energy { 0. };
+            double virial { 0. };
+
+            for (int j = 0; j < len; j++)
+            {
+                const int& indexJ {indexItBegin[j]};
+                const int& particleType {m_particleArray[indexJ].type};
+                const Real diameter {getDiameterI(indexJ)};
+
+                for (int k = j + 1; k < len; k++)
+                {
+                    if (areBondedIJ(indexJ, indexItBegin[k]))
+                    {
+                        continue;
+                    }
+                    const Real squareDistance {squareDistancePair(posItBegin + m_nDims * j, posItBegin + m_nDims * k)};
+                    energy += pairEnergyIJ(pairStyle, squareDistance, particleType, diameter, indexItBegin[k]);
+
+                    if constexpr (WithVirial)
+                    {
+                        virial += pairForceDivRIJ(pairStyle, squareDistance, particleType, diameter, indexItBegin[k])
+                                  * squareDistance;
+                    }
+                }
+            }
+            return makeEnergyResult<WithVirial>(energy, virial);
+        });
+    }
 
+    template<typename InputItI, typename InputItJ>
+    [[nodiscard]] double pairEnergyPositions(InputItI posItBeginI, const int& indexI,
+                                             InputItJ posItBeginJ, const int& indexJ) const
+/*
+ * Pair energy of the particles indexI and indexJ placed at posItBeginI and posItBeginJ.
+ */
+    {
+        const Real squareDistance {squareDistancePair(posItBeginI, posItBeginJ)};
+        return m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            return static_cast<double>(pairEnergyIJ(pairStyle, squareDistance, m_particleArray[indexI].type,
+                                                    getDiameterI(indexI), indexJ));
+        });
+    }
+
+    template<typename InputItI, typename InputItJ>
+    [[nodiscard]] double bondEnergyPositions(InputItI posItBeginI, const int& typeI,
+                                             InputItJ posItBeginJ, const int& typeJ) const
+    {
+        return m_systemBondPotentials.bondEnergyIJ(squareDistancePair(posItBeginI, posItBeginJ), typeI, typeJ);
+    }
+
+    [[nodiscard]] bool areBondedIJ(const int& i, const int& j) const
+    {
+        return std::find(getBondsItBeginI(i), getBondsItEndI(i), j) != getBondsItEndI(i);
+    }
+
+    template<bool WithVirial = false, typename MemberPosition, typename InputNeighIt>
+    EnergyResult<WithVirial> energyMoleculeExtraMembers(const int& indexBegin, const int& lenMolecule, MemberPosition memberPosition,
+                               InputNeighIt NeighItBegin, const int& lenNeigh) const
+/*
+ * Pair energy of a molecule with the particles of its molecule neighbor list (see
+ * Neighbors::createMoleculeNeighborList). Each external particle is loaded once and interacts with all the members.
+ * memberPosition(k) returns the position of the member k.
+ */
+    {
+        return m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            double energy { 0. };
+            double virial { 0. };
+
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
+            {
+                const ParticleRecord& particleJ {m_particleArray[*it]};
+
+                for (int k = 0; k < lenMolecule; k++)
+                {
+                    const int& typeK {m_particleArray[indexBegin + k].type};
+                    const Real diameterK {getDiameterI(indexBegin + k)};
+                    const Real squareDistance { squareDistancePair(memberPosition(k), particleJ.position)};
+                    energy += pairEnergyIJ(pairStyle, squareDistance, typeK, diameterK, *it);
+
+                    if constexpr (WithVirial)
+                    {
+                        virial += pairForceDivRIJ(pairStyle, squareDistance, typeK, diameterK, *it) * squareDistance;
+                    }
+                }
+            }
+            return makeEnergyResult<WithVirial>(energy, virial);
+        });
+    }
+
+    template<bool WithVirial = false, typename InputPosIt, typename InputNeighIt>
+    EnergyResult<WithVirial> energyMoleculeExtra(const int& indexBegin, const int& lenMolecule, InputPosIt posItBegin,
+                                                 InputNeighIt NeighItBegin, const int& lenNeigh) const
+    {
+        return energyMoleculeExtraMembers<WithVirial>(indexBegin, lenMolecule,
+                                   [&](const int& k) { return posItBegin + m_nDims * k; },
+                                   NeighItBegin, lenNeigh);
+    }
+
+    template<bool WithVirial = false, typename InputNeighIt>
+    EnergyResult<WithVirial> energyMoleculeExtra(const int& indexBegin, const int& lenMolecule,
+                                                 InputNeighIt NeighItBegin, const int& lenNeigh) const
+    {
+        return energyMoleculeExtraMembers<WithVirial>(indexBegin, lenMolecule,
+                                   [&](const int& k) { return getPosItBeginI(indexBegin + k); },
+                                   NeighItBegin, lenNeigh);
+    }
+
+    template<bool WithVirial = false, typename InputPosIt, typename InputNeighIt>
+    EnergyResult<WithVirial> energyPairParticleRetype(const int& indexParticle, InputPosIt posItBegin,
+                                                      InputNeighIt NeighItBegin, const int& lenNeigh,
+                                                      const int& newType, const Real& newDiameter,
+                                                      const int& indexExcluded) const
+/*
+ * Pair energy difference when indexParticle takes the type newType and the diameter newDiameter. The pair with
+ * indexExcluded (-1 for none) is left out.
+ */
+    {
+        const int& particleType {m_particleArray[indexParticle].type};
+        const Real diameter {getDiameterI(indexParticle)};
+
+        return m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            double energy { 0. };
+            double virial { 0. };
+
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; it++)
+            {
+                const int& indexJ {*it};
+                if (indexJ != indexExcluded)
+                {
+                    const ParticleRecord& particleJ {m_particleArray[indexJ]};
+                    const Real squareDistance { squareDistancePair(posItBegin, particleJ.position) };
+
+                    energy += pairEnergyIJ(pairStyle, squareDistance, newType, newDiameter, indexJ);
+                    energy -= pairEnergyIJ(pairStyle, squareDistance, particleType, diameter, indexJ);
+
+                    if constexpr (WithVirial)
+                    {
+                        virial += (pairForceDivRIJ(pairStyle, squareDistance, newType, newDiameter, indexJ)
+                                   - pairForceDivRIJ(pairStyle, squareDistance, particleType, diameter, indexJ))
+                                  * squareDistance;
+                    }
+                }
+            }
+            return makeEnergyResult<WithVirial>(energy, virial);
+        });
+    }
+
+    template<bool WithVirial = false, typename InputIt>
+    [[nodiscard]] EnergyResult<WithVirial> bondEnergyIRetype(const int& indexParticle, InputIt posItBegin,
+                                                             const int& newType, const int& indexExcluded) const
+    {
         const auto &bondsItBegin { getBondsItBeginI(indexParticle) };
         const auto &bondsItEnd {getBondsItEndI(indexParticle)};
-        const int& particleTypeI { m_particleTypeArray[indexParticle] };
-        const int& swapParticleTypeI {m_particleTypeArray[indexSwap]};
+        const int& particleTypeI { m_particleArray[indexParticle].type };
+
+        return m_systemBondPotentials.visitStyle([&](const auto& bondStyle)
+        {
+            double energy { 0. };
+            double virial { 0. };
+
+            for (auto it = bondsItBegin; it < bondsItEnd; it++)
+            {
+                const int& indexJ {*it};
+
+                if (indexJ != indexExcluded)
+                {
+                    const ParticleRecord& particleJ {m_particleArray[indexJ]};
+
+                    const Real squareDistance { squareDistancePair(posItBegin, particleJ.position) };
+
+                    energy += m_systemBondPotentials.bondEnergyIJ(bondStyle, squareDistance,
+                                                                  newType, particleJ.type);
+                    energy -= m_systemBondPotentials.bondEnergyIJ(bondStyle, squareDistance,
+                                                                  particleTypeI, particleJ.type);
+
+                    if constexpr (WithVirial)
+                    {
+                        virial += (m_systemBondPotentials.bondForceDivR(bondStyle, squareDistance,
+                                                                        newType, particleJ.type)
+                                   - m_systemBondPotentials.bondForceDivR(bondStyle, squareDistance,
+                                                                          particleTypeI, particleJ.type))
+                                  * squareDistance;
+                    }
+                }
+            }
+            return makeEnergyResult<WithVirial>(energy, virial);
+        });
+    }
+
+    template<bool WithVirial = false, typename InputPosIt, typename InputNeighIt>
+    EnergyResult<WithVirial> energyPairParticleSwap(const int& indexParticle, InputPosIt posItBegin,
+                                  InputNeighIt NeighItBegin, const int& lenNeigh,
+                                  const int& indexSwap) const
+    {
+        // A polydisperse swap exchanges the diameters and keeps the types, a discrete swap exchanges the types.
+        const int& swapParticleType {m_particleArray[m_polydisperse ? indexParticle : indexSwap].type};
+
+        return energyPairParticleRetype<WithVirial>(indexParticle, posItBegin, NeighItBegin, lenNeigh,
+                                                    swapParticleType, getDiameterI(indexSwap), indexSwap);
+    }
+
+    template<bool WithVirial = false, typename InputIt>
+    [[nodiscard]] EnergyResult<WithVirial> bondEnergyISwap(const int& indexParticle, InputIt posItBegin,
+                                         const int& indexSwap) const
+    {
+        return bondEnergyIRetype<WithVirial>(indexParticle, posItBegin, m_particleArray[indexSwap].type, indexSwap);
+    }
+
+    template<bool WithVirial = false, typename InputNeighIt>
+    EnergyResult<WithVirial> energyParticleMoleculeSwap(const int& indexParticle, InputNeighIt NeighItBegin,
+                                                        const int& lenNeigh, const int& indexSwap) const
+    {
+        EnergyResult<WithVirial> energy {};
+        const auto& posItBegin {getPosItBeginI(indexParticle)};
+        energy += energyPairParticleSwap<WithVirial>(indexParticle, posItBegin, NeighItBegin, lenNeigh, indexSwap);
 
-        for (auto it = bondsItBegin; it < bondsItEnd; it++)
+        if (!m_polydisperse) // The bonds only depend on the types.
         {
-            const int& indexJ {*it};
+            energy += bondEnergyISwap<WithVirial>(indexParticle, posItBegin, indexSwap);
+        }
+        return energy;
+    }
+
+    template<bool WithVirial = false, typename InputNeighIt>
+    EnergyResult<WithVirial> energyParticleMoleculeMutation(const int& indexParticle, InputNeighIt NeighItBegin,
+                                                            const int& lenNeigh, const int& newType) const
+/*
+ * Energy difference when indexParticle alone takes the type newType (semi-grand canonical mutation).
+ */
+    {
+        const auto& posItBegin {getPosItBeginI(indexParticle)};
+        return energyPairParticleRetype<WithVirial>(indexParticle, posItBegin, NeighItBegin, lenNeigh, newType,
+                                                    getDiameterI(indexParticle), -1)
+               + bondEnergyIRetype<WithVirial>(indexParticle, posItBegin, newType, -1);
+    }
+
+    /***************************************************************************
+     * TYPE-RESOLVED ENERGY CACHE
+     * Row i of m_typeEnergyArray holds, for each particle type t, the pair
+     * energy particle i would have with its neighbor row if its type was t.
+     * Bonds are not cached: FENE energies of hypothetical types can be
+     * infinite and they are cheap to compute directly.
+     **************************************************************************/
+
+    template<typename InputPosIt, typename InputNeighIt, typename OutputIt>
+    void typeEnergyParticle(InputPosIt posItBegin, InputNeighIt NeighItBegin, const int& lenNeigh,
+                            OutputIt energyItBegin) const
+    {
+        const int nParticleTypes {m_systemPairPotentials.getParticleTypes()};
+        std::fill(energyItBegin, energyItBegin + nParticleTypes, 0.);
 
-            if (indexJ != indexSwap)
+        m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
             {
-                const int& particleTypeJ { m_particleTypeArray[indexJ] };
+                const ParticleRecord& particleJ {m_particleArray[*it]};
+                const Real squareDistance { squareDistancePair(posItBegin, particleJ.position) };
 
-                const double squareDistance { squareDistancePair(posItBegin,
-                                                                 m_positionArray.begin() + m_nDims*indexJ) };
+                for (int type = 1; type <= nParticleTypes; type++)
+                {
+                    energyItBegin[type - 1] += m_systemPairPotentials.pairEnergy(pairStyle, squareDistance,
+                                                                                 type, particleJ.type);
+                }
+            }
+        });
+    }
 
-                energy += m_systemBondPotentials.feneBondEnergyIJ(squareDistance,
-                                                                  swapParticleTypeI, particleTypeJ);
-                energy -= m_systemBondPotentials.feneBondEnergyIJ(squareDistance, particleTypeI, particleTypeJ);
+    template<typename InputPosIt, typename InputNeighIt>
+    void updateTypeEnergyNeighbors(const int& indexParticle, InputPosIt newPosItBegin, const int& newType,
+                                   InputNeighIt NeighItBegin, const int& lenNeigh)
+/*
+ * Updates the cache rows of the neighbors of indexParticle when it moves to newPosItBegin and/or takes the type
+ * newType. Must be called before the position or the type of indexParticle is changed.
+ */
+    {
+        const int nParticleTypes {m_systemPairPotentials.getParticleTypes()};
+        const ParticleRecord& particleI {m_particleArray[indexParticle]};
 
+        m_systemPairPotentials.visitStyle([&](const auto& pairStyle)
+        {
+            for (auto it = NeighItBegin; it < NeighItBegin + lenNeigh; ++it)
+            {
+                const int& indexJ {*it};
+                const Real* posItBeginJ {m_particleArray[indexJ].position};
+                const Real oldSquareDistance { squareDistancePair(particleI.position, posItBeginJ) };
+                const Real newSquareDistance { squareDistancePair(newPosItBegin, posItBeginJ) };
+                auto energyItBeginJ {m_typeEnergyArray.begin() + nParticleTypes * indexJ};
 
+                for (int type = 1; type <= nParticleTypes; type++)
+                {
+                    energyItBeginJ[type - 1] += m_systemPairPotentials.pairEnergy(pairStyle, newSquareDistance,
+                                                                                  type, newType);
+                    energyItBeginJ[type - 1] -= m_systemPairPotentials.pairEnergy(pairStyle, oldSquareDistance,
+                                                                                  type, particleI.type);
+                }
             }
+        });
+    }
+
+    template<typename InputPosIt, typename InputNeighIt>
+    void updateTypeEnergyTranslation(const int& indexParticle, InputPosIt newPosItBegin,
+                                     InputNeighIt NeighItBegin, const int& lenNeigh)
+    {
+        if (m_typeEnergyArray.empty())
+        {
+            return;
         }
-        return energy;
+        const int nParticleTypes {m_systemPairPotentials.getParticleTypes()};
+        updateTypeEnergyNeighbors(indexParticle, newPosItBegin, m_particleArray[indexParticle].type,
+                                  NeighItBegin, lenNeigh);
+        typeEnergyParticle(newPosItBegin, NeighItBegin, lenNeigh,
+                           m_typeEnergyArray.begin() + nParticleTypes * indexParticle);
     }
+
     template<typename InputNeighIt>
-    double energyParticleMoleculeSwap(const int& indexParticle, InputNeighIt NeighItBegin, const int& lenNeigh,
-                                      const int& indexSwap) const
+    void updateTypeEnergySwap(const int& indexParticle, const int& newType,
+                              InputNeighIt NeighItBegin, const int& lenNeigh)
     {
-        double energy { 0. };
-        const auto& posItBegin {m_positionArray.begin() + 3 * indexParticle};
-        energy += energyPairParticleSwap(indexParticle, posItBegin, NeighItBegin, lenNeigh, indexSwap);
-        energy += feneBondEnergyISwap(indexParticle, posItBegin, indexSwap);
-        return energy;
+        if (m_typeEnergyArray.empty())
+        {
+            return;
+        }
+        updateTypeEnergyNeighbors(indexParticle, getPosItBeginI(indexParticle), newType, NeighItBegin, lenNeigh);
     }
 
+    void initializeTypeEnergy(const Neighbors &systemNeighbors);
+
+    [[nodiscard]] bool hasTypeEnergy() const;
+
+    [[nodiscard]] double energySwapTypeEnergy(const int &indexSwap1, const int &indexSwap2) const;
+
+    [[nodiscard]] double energyMutationTypeEnergy(const int &indexParticle, const int &newType) const;
+
+    template<typename IndexIt, typename OutputIt>
+    void unwrapChain(IndexIt indexItBegin, const int& len, OutputIt outItBegin) const
+/*
+ * Writes the positions of the particles indexItBegin[0..len) relative to the first one, by adding the minimum image
+ * vectors between consecutive particles. The result is right for molecules larger than half the box as long as
+ * consecutive particles (bonded ones, in chain order) are closer than half the box.
+ */
+    {
+        std::fill(outItBegin, outItBegin + m_nDims, 0.);
+
+        for (int k = 1; k < len; k++)
+        {
+            separationPair(getPosItBeginI(indexItBegin[k - 1]), getPosItBeginI(indexItBegin[k]),
+                           outItBegin + m_nDims * k);
+
+            for (int d = 0; d < m_nDims; d++)
+            {
+                outItBegin[m_nDims * k + d] += outItBegin[m_nDims * (k - 1) + d];
+            }
+        }
+    }
+
+    template<typename InputItI, typename InputItJ, typename OutputIt>
+    void separationPair(InputItI firstI, InputItJ firstJ, OutputIt outIt) const
+/*
+ * Writes the minimum image vector from particle I to particle J.
+ */
+    {
+        for (int i = 0; i < m_nDims; i++)
+        {
+            double diff {static_cast<double>(firstJ[i]) - static_cast<double>(firstI[i])};
+
+            if (diff > m_halfLengthCube)
+            {
+                diff -= m_lengthCube;
+            }
+            else if (diff < -m_halfLengthCube)
+            {
+                diff += m_lengthCube;
+            }
+            outIt[i] = diff;
+        }
+    }
 
     template<typename InputItI, typename InputItJ>
-    double squareDistancePair(InputItI firstI, InputItJ firstJ) const
+    Real squareDistancePair(InputItI firstI, InputItJ firstJ) const
     {
-        double squareDistance { 0. };
+        const Real lengthCube {static_cast<Real>(m_lengthCube)};
+        const Real halfLengthCube {static_cast<Real>(m_halfLengthCube)};
+        Real squareDistance { 0. };
 
         for (int i = 0; i < m_nDims; i++)
         {
-            double diff = *firstI - *firstJ;
-            double absDiff {fabs(diff) };
-            if (absDiff> m_halfLengthCube)
+            Real diff = *firstI - *firstJ;
+            Real absDiff {std::fabs(diff) };
+            if (absDiff> halfLengthCube)
             {
-                if (diff < 0.0)
+                if (diff < 0)
                 {
-                    diff += m_lengthCube;
+                    diff += lengthCube;
                 }
                 else
                 {
-                    diff -= m_lengthCube;
+                    diff -= lengthCube;
                 }
             }
 
@@ -475,16 +1268,12 @@ public:
 
     [[nodiscard]] PosIterator getPosItBeginI(const int &i) const
     {
-        const int realIndex { i * m_nDims };
-        auto outIt {m_positionArray.begin() + realIndex};
-        return outIt;
+        return m_particleArray[i].position;
     }
 
     [[nodiscard]] PosIterator getPosItEndI(const int &i) const
     {
-        const int realIndex { (i+1) * m_nDims };
-        auto outIt {m_positionArray.begin() + realIndex};
-        return outIt;
+        return m_particleArray[i].position + m_nDims;
     }
 
     [[nodiscard]] BondsIterator getBondsItBeginI(const int &i) const
@@ -502,9 +1291,25 @@ public:
 
     [[nodiscard]] const int& getNDims() const;
 
-    [[nodiscard]] double getCosAngleMolecule(const std::vector<int>& orderVector, const int& indexMolecule) const;
+    [[nodiscard]] double getCosAngleMolecule(const std::vector<int>& orderVector) const;
 
     [[nodiscard]] std::vector<int> getOrderVector(const int &indexMolecule) const;
+
+    void initializeMoleculeTable();
+
+    [[nodiscard]] int getNMolecules() const;
+
+    [[nodiscard]] const int& getMoleculeBeginI(const int &indexMolecule) const;
+
+    [[nodiscard]] int getMoleculeLengthI(const int &indexMolecule) const;
+
+    [[nodiscard]] const int& getParticleMoleculeI(const int &indexParticle) const;
+
+    void initializeChainTable();
+
+    [[nodiscard]] bool isLinearMoleculeI(const int &indexMolecule) const;
+
+    [[nodiscard]] std::vector<int>::const_iterator getChainItBeginI(const int &indexMolecule) const;
 };
 
 #endif /* MOLECULES_H_ */
@@ -0,0 +1,222 @@
+#ifndef MOVEREGISTRY_H_
+#define MOVEREGISTRY_H_
+
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+/*******************************************************************************
+ * Registry of the Monte Carlo moves. The moves enabled in inputVar.txt are
+ * turned into MoveRecords once per run, each with its weight in the move mix
+ * and its counters. mcMove draws a record from an alias table and visits its
+ * variant, so the move is a compile-time type (see MonteCarlo::runMove) and
+ * the hot loop does not test the configuration flags. Move types sharing a
+ * name (e.g. the translation variants) share the record of the enabled one.
+ * The cost of a move, returned by runMove, is the number of particle moves it
+ * counts for in the N moves of a time step.
+ ******************************************************************************/
+namespace move
+{
+    // Translation of a random particle. Cost: 1.
+    struct Translation
+    {
+        static constexpr std::string_view name {"Translation"};
+    };
+
+    // Multiple-try translation (mtmTrials > 1). Cost: 1.
+    struct MultipleTryTranslation
+    {
+        static constexpr std::string_view name {"Translation"};
+    };
+
+    // Translations of a sublattice of independent cells. Cost: the number of particles of the batch.
+    struct BatchTranslation
+    {
+        static constexpr std::string_view name {"Translation"};
+    };
+
+    // Translation deferred to the parallel sweep at the end of the time step. Cost: 1.
+    struct PendingTranslation
+    {
+        static constexpr std::string_view name {"Translation"};
+    };
+
+    // Type swap inside a molecule. Cost: 1.
+    struct Swap
+    {
+        static constexpr std::string_view name {"Swap"};
+    };
+
+    // Type swap with a partner of the whole box or of the neighbor row (swapMode). Cost: 1.
+    struct NonLocalSwap
+    {
+        static constexpr std::string_view name {"Swap"};
+    };
+
+    // Diameter swap of continuous polydispersity. Cost: 1.
+    struct DiameterSwap
+    {
+        static constexpr std::string_view name {"Swap"};
+    };
+
+    // Rigid translation of a molecule. Cost: the length of the molecule.
+    struct MoleculeTranslation
+    {
+        static constexpr std::string_view name {"Molecule translation"};
+    };
+
+    // Rigid rotation of a molecule. Cost: the length of the molecule.
+    struct MoleculeRotation
+    {
+        static constexpr std::string_view name {"Molecule rotation"};
+    };
+
+    // Pivot of a chain end. Cost: the number of rotated particles.
+    struct Pivot
+    {
+        static constexpr std::string_view name {"Pivot"};
+    };
+
+    // Crankshaft rotation of one bead. Cost: 1.
+    struct Crankshaft
+    {
+        static constexpr std::string_view name {"Crankshaft"};
+    };
+
+    // Configurational-bias regrowth of a chain end. Cost: the number of regrown beads.
+    struct Regrowth
+    {
+        static constexpr std::string_view name {"Regrowth"};
+    };
+
+    // Isothermal-isobaric volume move. Cost: 1.
+    struct Volume
+    {
+        static constexpr std::string_view name {"Volume"};
+    };
+
+    // Semi-grand canonical type mutation. Cost: 1.
+    struct Mutation
+    {
+        static constexpr std::string_view name {"Mutation"};
+    };
+
+    // Hybrid Monte Carlo trajectory. Cost: 1.
+    struct Hybrid
+    {
+        static constexpr std::string_view name {"Hybrid"};
+    };
+}
+
+using Move = std::variant<move::Translation, move::MultipleTryTranslation, move::BatchTranslation,
+                          move::PendingTranslation, move::Swap, move::NonLocalSwap, move::DiameterSwap,
+                          move::MoleculeTranslation, move::MoleculeRotation, move::Pivot, move::Crankshaft,
+                          move::Regrowth, move::Volume, move::Mutation, move::Hybrid>;
+
+// Index of the alternative MoveType in the Move variant.
+template<typename MoveType, std::size_t Index = 0>
+constexpr std::size_t getMoveIndex()
+{
+    static_assert(Index < std::variant_size_v<Move>, "Unknown move type.");
+
+    if constexpr (std::is_same_v<MoveType, std::variant_alternative_t<Index, Move>>)
+    {
+        return Index;
+    }
+    else
+    {
+        return getMoveIndex<MoveType, Index + 1>();
+    }
+}
+
+// Name of the alternative index of the Move variant.
+template<std::size_t Index = 0>
+std::string_view getMoveName(const std::size_t& index)
+{
+    if constexpr (Index + 1 < std::variant_size_v<Move>)
+    {
+        if (index != Index)
+        {
+            return getMoveName<Index + 1>(index);
+        }
+    }
+    return std::variant_alternative_t<Index, Move>::name;
+}
+
+struct MoveRecord
+{
+    Move move {};
+    double weight {};                                               // Probability of the move in the mix.
+    int nAttempts {0};                                              // Attempts of the current time step.
+    double attemptRate {0.};                                        // Attempts per particle summed over the time steps.
+    double acceptanceRate {0.};                                     // Accepted moves per particle, same sum.
+    double cpuTime {0.};                                            // Seconds spent in the move, timed by the tuner only.
+};
+
+/*******************************************************************************
+ * Walker's alias table (Vose's construction): samples an index with
+ * probability proportional to its weight from one uniform number, in O(1).
+ ******************************************************************************/
+class AliasTable
+{
+private:
+    std::vector<double> m_probabilityArray {};                      // Probability to keep the drawn column.
+    std::vector<int> m_aliasArray {};                               // Index taken otherwise.
+
+public:
+    AliasTable() = default;
+
+    explicit AliasTable(const std::vector<double>& weightArray)
+
+        : m_probabilityArray (weightArray.size(), 1.)
+            , m_aliasArray (weightArray.size())
+    {
+        const int nColumns {static_cast<int>(weightArray.size())};
+        double sumWeight {0.};
+
+        for (const auto& weight : weightArray)
+        {
+            sumWeight += weight;
+        }
+
+        std::vector<double> scaledArray (nColumns);
+        std::vector<int> smallArray {};
+        std::vector<int> largeArray {};
+
+        for (int k = 0; k < nColumns; k++)
+        {
+            m_aliasArray[k] = k;
+            scaledArray[k] = weightArray[k] * nColumns / sumWeight;
+            (scaledArray[k] < 1. ? smallArray : largeArray).push_back(k);
+        }
+
+        while (!smallArray.empty() && !largeArray.empty())
+        {
+            const int small {smallArray.back()};
+            const int large {largeArray.back()};
+            smallArray.pop_back();
+            largeArray.pop_back();
+            m_probabilityArray[small] = scaledArray[small];
+            m_aliasArray[small] = large;
+            scaledArray[large] += scaledArray[small] - 1.;
+            (scaledArray[large] < 1. ? smallArray : largeArray).push_back(large);
+        }
+        // The columns left over are full up to rounding errors.
+    }
+
+    [[nodiscard]] int size() const
+    {
+        return static_cast<int>(m_probabilityArray.size());
+    }
+
+    // uniform is drawn in [0, size()): its integer part picks the column, its fractional part the alias.
+    [[nodiscard]] int sample(const double& uniform) const
+    {
+        const int column {std::min(static_cast<int>(uniform), size() - 1)};
+        return (uniform - column < m_probabilityArray[column]) ? column : m_aliasArray[column];
+    }
+};
+
+#endif /* MOVEREGISTRY_H_ */
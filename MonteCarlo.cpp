@@ -9,19 +9,26 @@
 #include <vector>
 #include <cmath>
 #include <string>
+#include <numeric>
+#include <algorithm>
+#include <chrono>
 #include "MonteCarlo.h"
 #include "Random_mt.h"
 #include "readSaveFile.h"
 #include "util.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /*******************************************************************************
  * This function is the core of the Monte Carlo program. It iterates over
  * m_timeSteps steps that the user defines. At each step m_nParticles Monte
  * Carlo moves are made. For now the Monte Carlo move is a translation of a
  * randomly chosen particle.
- * The energy, particles positions, particles displacements and pressure
- * (optional) are written in files.
+ * The energy, particles positions, particles displacements and virial pressure
+ * (optional) are written in files. When tuneSteps > 0 the step sizes and the
+ * move mix are tuned first, see tuneMoves.
  ******************************************************************************/
 void MonteCarlo::mcTotal()
 {
@@ -31,19 +38,55 @@ void MonteCarlo::mcTotal()
 	const std::string preNameDisp ("./disp/displacement");
 	const std::string extnameDisp {".txt"};
     const std::string energyFilePath{"./outE.txt"};
-    //std::string pressureFilePath {"./outP.txt"};
-    // std::vector<double> radiusArray (divideVectorByScalar(m_typeArray, 2));
+    const std::string msdFilePath{"./outMSD.txt"};
+    const std::string lengthFilePath{"./outL.txt"};
+    const std::string pressureFilePath{"./outP.txt"};
+    const std::string compositionFilePath{"./outComposition.txt"};
+    const std::string inherentFilePath{"./outIS.txt"};
+    const std::string widomFilePath{"./outWidom.txt"};
+    const std::string preNameInherent ("./outXYZ/inherent");
+    const std::string tuneFilePath{"./outTune.txt"};
+
+    if (m_tuneSteps > 0)
+    {
+        tuneMoves(tuneFilePath);
+    }
+
+    // The root rank writes the files. With a domain decomposition the configurations are gathered on it, so every
+    // rank calls saveInXYZ.
+    const bool saveFiles {m_systemDomain.isRoot()};
+    saveInXYZ(preName + std::to_string(0) + extname);
+
+    if (saveFiles)
+    {
+        saveEnergy(energyFilePath);
+
+        if (m_calculatePressure)
+        {
+            saveDoubleTXT(pressure(), pressureFilePath);
+        }
+
+        if (m_quench)
+        {
+            saveInherentStructure(0, inherentFilePath, preNameInherent + std::to_string(0) + extname);
+        }
+    }
+
+    if (m_saveDisplacement)
+    {
+        m_referencePositionArray = m_systemMolecules.getUnwrappedPositionArray();
 
-	m_systemMolecules.saveInXYZ(preName + std::to_string(0) + extname );
-    saveDoubleTXT(m_energy / m_nParticles, energyFilePath);
-	// saveDisplacement(m_totalDisplacementMatrix, preNameDisp + std::to_string(0) + extnameDisp);
+        if (saveFiles)
+        {
+            m_systemMolecules.saveDisplacement(m_referencePositionArray,
+                                               preNameDisp + std::to_string(0) + extnameDisp);
+            saveDoubleTXT(0., msdFilePath);
+        }
+    }
 
 	const std::vector<int> saveTimeStepArray ( createSaveTime(m_timeSteps, m_saveUpdate, 1.1));
 
 	int save_index { 0 };
-    double swapRate {0.};
-    double transRate {0.};
-    double molTransRate {0.};
 	for (int i = 0; i < m_timeSteps; i++) //Iteration over m_timeSteps
 	{
         int j { 0 };
@@ -52,7 +95,21 @@ void MonteCarlo::mcTotal()
             j += mcMove();
         }
 
-        m_systemNeighbors.checkInterDisplacement(m_systemMolecules);
+        mcPendingTranslations();
+        checkNeighbors();
+
+        if (m_widomRate > 0 && (i + 1) % m_widomRate == 0 && saveFiles)
+        {
+            widomSampling();
+        }
+
+        if (m_mutation)
+        {
+            for (int type = 0; type < static_cast<int>(m_typeCountArray.size()); type++)
+            {
+                ++m_compositionHistogramArray[type * (m_nParticles + 1) + m_typeCountArray[type]];
+            }
+        }
 
 		// Next, the results of the simulations are saved.
 
@@ -61,393 +118,3052 @@ void MonteCarlo::mcTotal()
 			//radiusArray = divideVectorByScalar(m_typeArray, 2);
             std::string nameXYZ {preName};
             nameXYZ.append(std::to_string(i + 1)).append(extname);
-            //std::string nameDisp {preNameDisp};
-            //nameDisp.append(std::to_string(i + 1)).append(extnameDisp);
-            m_systemMolecules.saveInXYZ(nameXYZ );
-			//saveDisplacement (m_totalDisplacementMatrix, nameDisp);
+            saveInXYZ(nameXYZ);
+
+            if (m_saveDisplacement && saveFiles)
+            {
+                std::string nameDisp {preNameDisp};
+                nameDisp.append(std::to_string(i + 1)).append(extnameDisp);
+                m_systemMolecules.saveDisplacement(m_referencePositionArray, nameDisp);
+                saveDoubleTXT(m_systemMolecules.meanSquareDisplacement(m_referencePositionArray), msdFilePath);
+            }
+
+            if (m_quench && saveFiles)
+            {
+                saveInherentStructure(i + 1, inherentFilePath, preNameInherent + std::to_string(i + 1) + extname);
+            }
 			++save_index;
 		}
 
-		if (i % m_saveRate == 0)
-		{
-            double realEnergy {m_systemMolecules.energySystemMolecule(m_systemNeighbors)};
-			saveDoubleTXT(m_energy / m_nParticles, energyFilePath); //Energy is saved at each time step.
-		}
-        swapRate += static_cast<double>(m_nSwap) / m_nParticles;
-        transRate += static_cast<double>(m_nTrans) / m_nParticles;
-        molTransRate += static_cast<double>(m_nMolTrans) / m_nParticles;
-        m_nSwap = 0;
-        m_nTrans = 0;
-        m_nMolTrans = 0;
-
-        /***
-		if (m_calculatePressure) // Saves pressure if m_calculatePressure is True
+        if (m_energyCheckRate > 0 && (i + 1) % m_energyCheckRate == 0)
+        {
+            checkEnergyDrift(i + 1);
+        }
+
+        if (m_calculatePressure)
+        {
+            const bool virialCheck {m_virialCheckRate > 0 && (i + 1) % m_virialCheckRate == 0};
+
+            if (virialCheck || (!m_virialIncremental && i % m_saveRate == 0))
+            {
+                m_virial = systemVirial();
+            }
+        }
+
+		if (i % m_saveRate == 0 && saveFiles)
 		{
-			saveDoubleTXT( m_pressure, pressureFilePath);
-		}
-        ***/
+			saveEnergy(energyFilePath); //Energy is saved at each time step.
+
+            if (m_calculatePressure)
+            {
+                saveDoubleTXT(pressure(), pressureFilePath);
+            }
 
+            if (m_volumeMove)
+            {
+                saveDoubleTXT(m_systemMolecules.getLengthCube(), lengthFilePath);
+            }
+		}
+        accumulateMoveRates();
 	}
 
-    m_systemMolecules.saveInXYZ( preName + std::to_string(m_timeSteps) + extname );
-    const double totalRate { transRate + swapRate + molTransRate};
-    double totalAcceptanceRate = (totalRate != 0) ?
-            (m_acceptanceRateTrans + m_acceptanceRateSwap + m_acceptanceRateMolTrans) / totalRate : 0.;
-	m_acceptanceRateTrans = (transRate != 0.) ? m_acceptanceRateTrans / transRate : 0.;
-    m_acceptanceRateSwap = (swapRate != 0.) ? m_acceptanceRateSwap / swapRate : 0.;
-    m_acceptanceRateSwap12 = (m_pSwap12 != 0.) ? m_acceptanceRateSwap12 / (swapRate * m_pSwap12): 0.;
-    m_acceptanceRateSwap13 = (m_pSwap13 != 0.) ? m_acceptanceRateSwap13 / (swapRate * m_pSwap13): 0.;
-    m_acceptanceRateSwap23 = (m_pSwap23 != 0.) ? m_acceptanceRateSwap23 / (swapRate * m_pSwap23): 0.;
-    m_acceptanceRateMolTrans = (molTransRate != 0.) ? m_acceptanceRateMolTrans / molTransRate : 0.;
+    saveInXYZ(preName + std::to_string(m_timeSteps) + extname);
 
+    if (saveFiles)
+    {
+        if (m_mutation)
+        {
+            saveCompositionHistogram(compositionFilePath);
+        }
 
-    constexpr std::string_view translationString{"Translation MC move acceptance rate: "};
-    constexpr std::string_view swapString { "Swap MC move acceptance rate: " };
+        if (m_widomRate > 0)
+        {
+            saveWidom(widomFilePath);
+        }
+    }
     constexpr std::string_view swapString12 { "Swap12 MC move acceptance rate: " };
     constexpr std::string_view swapString13 { "Swap13 MC move acceptance rate: " };
     constexpr std::string_view swapString23 { "Swap23 MC move acceptance rate: " };
-    constexpr std::string_view molTranslationString { "Molecule translation MC move acceptance rate: " };
     constexpr std::string_view totalString { "Total MC move acceptance rate: " };
 
-    std::cout << translationString << m_acceptanceRateTrans << "\n";
-    std::cout << swapString << m_acceptanceRateSwap << "\n";
-    std::cout << swapString12 << m_acceptanceRateSwap12 << "\n";
-    std::cout << swapString13 << m_acceptanceRateSwap13 << "\n";
-    std::cout << swapString23 << m_acceptanceRateSwap23 << "\n";
-    std::cout << molTranslationString << m_acceptanceRateMolTrans << "\n";
+    // The report follows the registry: one line per enabled move, in the order of m_moveArray.
+    double totalRate {0.};
+    double totalAcceptanceRate {0.};
+
+    for (const auto& record : m_moveArray)
+    {
+        std::cout << getMoveName(record.move.index()) << " MC move acceptance rate: "
+                  << ((record.attemptRate != 0.) ? record.acceptanceRate / record.attemptRate : 0.) << "\n";
+        totalRate += record.attemptRate;
+        totalAcceptanceRate += record.acceptanceRate;
+
+        if (std::holds_alternative<move::Swap>(record.move))
+        {
+            const double swapRate {record.attemptRate};
+            m_acceptanceRateSwap12 = (m_pSwap12 != 0.) ? m_acceptanceRateSwap12 / (swapRate * m_pSwap12): 0.;
+            m_acceptanceRateSwap13 = (m_pSwap13 != 0.) ? m_acceptanceRateSwap13 / (swapRate * m_pSwap13): 0.;
+            m_acceptanceRateSwap23 = (m_pSwap23 != 0.) ? m_acceptanceRateSwap23 / (swapRate * m_pSwap23): 0.;
+            std::cout << swapString12 << m_acceptanceRateSwap12 << "\n";
+            std::cout << swapString13 << m_acceptanceRateSwap13 << "\n";
+            std::cout << swapString23 << m_acceptanceRateSwap23 << "\n";
+        }
+    }
+    totalAcceptanceRate = (totalRate != 0.) ? totalAcceptanceRate / totalRate : 0.;
+
     std::cout << totalString << totalAcceptanceRate << "\n";
 
 
     double updateRate { static_cast<double>(m_systemNeighbors.getUpdateRate()) / m_timeSteps};
     constexpr std::string_view neighborString { "Neighbor list update rate: "};
     constexpr std::string_view neighborErrorString  { "Number of neighbor list errors: "};
+    if (m_speculativeThreads > 0)
+    {
+        const double nAttempts {static_cast<double>(std::max(m_nSpeculativeAttempts, 1LL))};
+        std::cout << "Speculative translation commit rate: " << m_nSpeculativeCommits / nAttempts << "\n";
+        std::cout << "Speculative translation conflict rate: " << m_nSpeculativeConflicts / nAttempts << "\n";
+        std::cout << "Speculative translation retry rate: " << m_nSpeculativeRetries / nAttempts << "\n";
+    }
+
 	std::cout << neighborString  << updateRate << "\n";
 	std::cout << neighborErrorString <<  m_systemNeighbors.getErrors() << "\n";
 
 }
 
 /*******************************************************************************
- * This function implements a Monte Carlo move: translation of a random particle,
- * calculation of the energy of the new system and then acceptation or not of
- * the move according to the Metropolis criterion. It is called N times in one
- * time step.
+ * This function implements a Monte Carlo move: a move of the registry is drawn
+ * from the alias table according to its weight and run, see runMove. It is
+ * called until N particle moves are made in one time step.
+ *
+ * @return Number of particle moves the move counts for.
  ******************************************************************************/
 int MonteCarlo::mcMove()
 {
-    const double randomDouble { Random::doubleGenerator(0., 1.) } ;
-    const bool swapped {randomDouble < m_pSwap};
-    const bool molTranslation {randomDouble > (1 - m_pMolTranslation)};
-    int step {0};
-
-    if ( swapped && m_swap)
-    {
+    MoveRecord& record {m_moveArray[m_moveTable.sample(Random::doubleGenerator(0., m_moveTable.size()))]};
 
-        ++m_nSwap;
-        ++step;
-        mcSwap();
-    }
-    else if ( molTranslation && m_molTranslation )
-    {
-        ++m_nMolTrans;
-        step += 3;
-        mcMoleculeTranslation();
-    }
-    else
-    {
-
-        ++m_nTrans;
-        ++step;
-        mcTranslation();
-    }
-    return step;
+    return std::visit([&](const auto& move) { return runMove(move, record); }, record.move);
 }
 
 /*******************************************************************************
- * This function implements a Monte Carlo move: translation of a the whole
- * polymer, calculation of the energy of the new system and then acceptation or not of
- * the move according to the Metropolis criterion. It is called ??? times in one
- * time step.
+ * This function builds the move registry from the parameters: one record per
+ * enabled move with its probability, the translation first with the
+ * probability left by the other moves. The translation and swap variants are
+ * chosen here once per run (pending, batch, multiple-try or single translation;
+ * diameter, non-local or molecule swap), so mcMove does not test the flags.
+ * The alternatives sharing a name are mapped to the same record for
+ * countAccepted.
  ******************************************************************************/
-
-void MonteCarlo::mcMoleculeTranslation()
+void MonteCarlo::initializeMoves()
 {
-	constexpr int lenMolecule {3};
-    const int typeMolecule { Random::intGenerator(0, (m_nParticles - 1) / lenMolecule) }; // randomly chosen Molecule
-    const int indexTranslation { m_systemMolecules.getNDims() * typeMolecule};
-	std::vector<double> randomVector ( Random::vectorDoubleGenerator(3, -m_rBoxMolTrans, m_rBoxMolTrans) );
-	double oldEnergyMolecule {0};
-	double newEnergyMolecule {0};
-    std::vector<double> positionArrayTranslation;
-
-	for (int j = 0; j < lenMolecule; j++)
-	{
+    Move translation {move::Translation {}};
 
-        const int newIndexTranslation {indexTranslation + j };
-        std::vector<double> posTranslation{ vectorTranslation(newIndexTranslation,
-                                                            randomVector.begin())};
-
-        positionArrayTranslation.insert( positionArrayTranslation.end(),
-                                         posTranslation.begin(),
-                                         posTranslation.begin() + m_systemMolecules.getNDims());
-
-        const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(newIndexTranslation) };
-        const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(newIndexTranslation)};
+    if (m_speculativeThreads > 0 || m_domainDecomposition)
+    {
+        translation = move::PendingTranslation {};
+    }
+    else if (m_batchTranslation)
+    {
+        translation = move::BatchTranslation {};
+    }
+    else if (m_mtmTrials > 1)
+    {
+        translation = move::MultipleTryTranslation {};
+    }
+    m_moveArray.push_back(MoveRecord {translation});
 
-        oldEnergyMolecule += m_systemMolecules.energyPairParticleExtraMolecule( newIndexTranslation,
-                                                                                neighItBegin, lenNeigh,
-                                                                                typeMolecule);
-		newEnergyMolecule += m_systemMolecules.energyPairParticleExtraMolecule( newIndexTranslation,
-                                                                                posTranslation.begin(),
-                                                                                neighItBegin, lenNeigh,
-                                                                                typeMolecule);
-	}
+    Move swap {move::Swap {}};
 
-    const double diffEnergy {newEnergyMolecule - oldEnergyMolecule};
-    // Metropolis criterion
-    const bool acceptMove{ metropolis(diffEnergy) };
+    if (m_systemMolecules.isPolydisperse())
+    {
+        swap = move::DiameterSwap {};
+    }
+    else if (m_swapMode != SwapMode::molecule)
+    {
+        swap = move::NonLocalSwap {};
+    }
 
-    // If the move is accepted, then the energy, the position array and the displacement array can be updated.
-    // If the m_calculatePressure is set to True, then the pressure is calculated.
-    if (acceptMove)
+    const auto addMove {[&](const bool& enabled, const Move& move, const double& weight)
     {
-        generalUpdate(diffEnergy);
-        m_acceptanceRateMolTrans += 1. / m_nParticles; // increment of the acceptance rate.
+        if (enabled)
+        {
+            m_moveArray.push_back(MoveRecord {move, weight});
+        }
+    }};
 
+    addMove(m_swap, swap, m_pSwap);
+    addMove(m_molTranslation, move::MoleculeTranslation {}, m_pMolTranslation);
+    addMove(m_molRotation, move::MoleculeRotation {}, m_pMolRotation);
+    addMove(m_pivot, move::Pivot {}, m_pPivot);
+    addMove(m_crankshaft, move::Crankshaft {}, m_pCrankshaft);
+    addMove(m_regrowth, move::Regrowth {}, m_pRegrowth);
+    addMove(m_volumeMove, move::Volume {}, m_pVolume);
+    addMove(m_mutation, move::Mutation {}, m_pMutation);
+    addMove(m_hybrid, move::Hybrid {}, m_pHybrid);
 
-        //if (m_calculatePressure)
-        //{
-        //    const double newPressureParticle {pressureParticle(m_temp, indexTranslation, positionParticleTranslation, m_positionArray, neighborIList, m_typeArray, m_squareRc, m_lengthCube, m_halfLengthCube)};
-        //    const double oldPressureParticle {pressureParticle(m_temp, indexTranslation, m_positionArray[indexTranslation], m_positionArray, neighborIList, m_typeArray, m_squareRc, m_lengthCube, m_halfLengthCube)};
-        //    m_pressure += newPressureParticle - oldPressureParticle;
-        //}
+    m_moveRecordIndexArray.fill(-1);
 
-        m_systemMolecules.updateFlags(indexTranslation);
-        m_systemMolecules.updatePositionI(indexTranslation, positionArrayTranslation.begin(), lenMolecule*m_systemMolecules.getNDims());
-        for (int j = 0; j < lenMolecule; j++)
+    for (int index = 0; index < static_cast<int>(m_moveRecordIndexArray.size()); index++)
+    {
+        for (int k = 0; k < static_cast<int>(m_moveArray.size()); k++)
         {
-            // TO DO INTER DISPLACEMENT
-            const int newIndexTranslation {indexTranslation + j };
-            m_systemNeighbors.updateInterDisplacement(newIndexTranslation,
-                                                      randomVector.begin());
-
+            if (getMoveName(index) == getMoveName(m_moveArray[k].move.index()))
+            {
+                m_moveRecordIndexArray[index] = k;
+            }
         }
     }
-    m_systemMolecules.reinitializeFlags();
+    initializeMoveTable();
 }
+
 /*******************************************************************************
- * This function returns a tentative new particle position.
- *
- * @param indexTranslation Translated particle's index.
- *        randomVector Random vector of size 3. The components of the vector are
- *                     taken from a uniform distribution U(-m_rBox, m_rBox).
- * @return Tentative new particle position.
+ * This function sets the weights of the swap and molecule translation records
+ * from m_pSwap and m_pMolTranslation (changed by the tuner), gives the rest to
+ * the translation and rebuilds the alias table of mcMove.
  ******************************************************************************/
-void MonteCarlo::mcTranslation()
+void MonteCarlo::initializeMoveTable()
 {
+    if (m_swap)
+    {
+        m_moveArray[m_moveRecordIndexArray[getMoveIndex<move::Swap>()]].weight = m_pSwap;
+    }
 
-    const int indexTranslation{Random::intGenerator(0, m_nParticles - 1)}; // randomly chosen particle
-    const std::vector<double>& randomVector(Random::vectorDoubleGenerator(3, -m_rBox, m_rBox));
-    const std::vector<double>& positionTranslation { vectorTranslation(indexTranslation, randomVector.begin()) };
-
-    const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexTranslation) };
-    const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexTranslation)};
+    if (m_molTranslation)
+    {
+        m_moveArray[m_moveRecordIndexArray[getMoveIndex<move::MoleculeTranslation>()]].weight = m_pMolTranslation;
+    }
+    double otherWeight {0.};
 
-    double oldEnergyParticle { m_systemMolecules.energyParticleMolecule(indexTranslation, neighItBegin,
-                                                                        lenNeigh)};
-    double newEnergyParticle { m_systemMolecules.energyParticleMolecule(indexTranslation,
-                                                                        positionTranslation.begin(),
-                                                                        neighItBegin, lenNeigh)};
+    for (auto it = m_moveArray.begin() + 1; it != m_moveArray.end(); ++it)
+    {
+        otherWeight += it->weight;
+    }
 
-    const double diff_energy {newEnergyParticle - oldEnergyParticle};
+    if (otherWeight > 1.)
+    {
+        std::cerr << "The probabilities of the enabled moves (pSwap, pMolTranslation, ...) sum to " << otherWeight
+                  << " > 1\n";
+        std::abort();
+    }
+    m_moveArray.front().weight = 1. - otherWeight;
 
-    // Metropolis criterion
-    const bool acceptMove{ metropolis(diff_energy) };
+    std::vector<double> weightArray {};
 
-    // If the move is accepted, then the energy, the position array and the displacement array can be updated.
-    // If the m_calculatePressure is set to True, then the pressure is calculated.
-    if (acceptMove)
+    for (const auto& record : m_moveArray)
     {
-        generalUpdate(diff_energy);
-        m_acceptanceRateTrans += 1. / m_nParticles; // increment of the acceptance rate.
+        weightArray.push_back(record.weight);
+    }
+    m_moveTable = AliasTable(weightArray);
+}
 
-        /***
-        if (m_calculatePressure)
+/*******************************************************************************
+ * This function is mcMove with the move timed in the cpuTime of its record. It
+ * draws the same random numbers as mcMove and is only used by the tuner, so
+ * the production loop does not pay for the clock.
+ ******************************************************************************/
+int MonteCarlo::mcMoveTimed()
+{
+    MoveRecord& record {m_moveArray[m_moveTable.sample(Random::doubleGenerator(0., m_moveTable.size()))]};
+    const auto start {std::chrono::steady_clock::now()};
+    const int step {std::visit([&](const auto& move) { return runMove(move, record); }, record.move)};
+    record.cpuTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return step;
+}
+
+/*******************************************************************************
+ * This function runs the translations deferred by runMove(PendingTranslation)
+ * at the end of a time step, in parallel.
+ ******************************************************************************/
+void MonteCarlo::mcPendingTranslations()
+{
+    if (m_nPendingTranslations > 0)
+    {
+        if (m_domainDecomposition)
         {
-            const double newPressureParticle {pressureParticle(m_temp, indexTranslation, positionParticleTranslation, m_positionArray, neighborIList, m_typeArray, m_squareRc, m_lengthCube, m_halfLengthCube)};
-            const double oldPressureParticle {pressureParticle(m_temp, indexTranslation, m_positionArray[indexTranslation], m_positionArray, neighborIList, m_typeArray, m_squareRc, m_lengthCube, m_halfLengthCube)};
-            m_pressure += newPressureParticle - oldPressureParticle;
+            mcDomainTranslations(m_nPendingTranslations);
         }
-        ***/
-        m_systemNeighbors.updateInterDisplacement(indexTranslation, randomVector.begin());
-        m_systemMolecules.updatePositionI(indexTranslation, positionTranslation.begin());
-        m_systemMolecules.updateFlags(indexTranslation);
+        else
+        {
+            mcSpeculativeTranslations(m_nPendingTranslations);
+        }
+        m_nPendingTranslations = 0;
     }
-    m_systemMolecules.reinitializeFlags();
 }
 
 /*******************************************************************************
- * This function returns a tentative new particle position.
- *
- * @param indexTranslation Translated particle's index.
- *        randomVector Random vector of size 3. The components of the vector are
- *                     taken from a uniform distribution U(-m_rBox, m_rBox).
- * @return Tentative new particle position.
+ * This function adds the attempts of the time step, per particle, to the
+ * attempt rates of the records and resets them.
  ******************************************************************************/
-
-void MonteCarlo::mcSwap()
+void MonteCarlo::accumulateMoveRates()
 {
-    double pSwapType { Random::doubleGenerator(0, 1) };
-    int swapType {1};
-    int indexMolecule { Random::intGenerator(0, m_nParticles - 1) };
-    // int indexSwap2 { randomIntGenerator(0, m_nParticles - 1) };
-    // !!!! THIS NEXT PART IS ONLY BECAUSE WE STUDY TRI-MERS VERY SPECIFIC!!!
-    indexMolecule -= indexMolecule % 3;
-
-    std::vector<int> orderVector { m_systemMolecules.getOrderVector(indexMolecule) };
-    // double cosAngle { m_systemMolecules.getCosAngleMolecule(orderVector, indexMolecule ) };
+    for (auto& record : m_moveArray)
+    {
+        record.attemptRate += static_cast<double>(record.nAttempts) / m_nParticles;
+        record.nAttempts = 0;
+    }
+}
 
-    int indexSwap1 {indexMolecule};
-    int indexSwap2 {indexMolecule};
+/*******************************************************************************
+ * This function runs the equilibration phase of the tuner: m_tuneSteps time
+ * steps before the production run.
+ * - First half: every m_tuneWindow steps, rBox and rBoxMolTranslation are
+ *   scaled toward m_targetAcceptance (see tuneStepSizes).
+ * - Second half: the candidate move mixes, pSwap and pMolTranslation scaled by
+ *   1/2, 1 or 2, run an equal share of the steps each. The candidate with the
+ *   largest progress per second of its per-move timers (see runTuneWindow) is
+ *   kept.
+ * The tuned values are then frozen for the whole production run, which keeps
+ * the detailed balance, printed with the cost of each move and saved in path
+ * in the format of inputVar.txt. The acceptance counters restart at 0.
+ ******************************************************************************/
+void MonteCarlo::tuneMoves(const std::string& path)
+{
+    const int nStepSizeSteps {m_tuneSteps / 2};
 
-    if (pSwapType < m_pSwap12)
+    for (int i = 0; i < nStepSizeSteps; i += m_tuneWindow)
     {
-        indexSwap1 += orderVector[0];
-        indexSwap2 += orderVector[1];
+        const std::vector<MoveRecord> windowArray {m_moveArray};
+        runTuneWindow(std::min(m_tuneWindow, nStepSizeSteps - i));
+        tuneStepSizes(windowArray);
     }
-    else if (pSwapType < (m_pSwap12 + m_pSwap13))
+
+    const std::vector<double> scaleArray {0.5, 1., 2.};
+    const std::vector<double> swapScaleArray {m_swap ? scaleArray : std::vector<double> {1.}};
+    const std::vector<double> molTranslationScaleArray {m_molTranslation ? scaleArray : std::vector<double> {1.}};
+    const int nCandidates {static_cast<int>(swapScaleArray.size() * molTranslationScaleArray.size())};
+    const int nCandidateSteps {std::max((m_tuneSteps - nStepSizeSteps) / nCandidates, 1)};
+    // Weight of the moves whose probability is not tuned.
+    const double fixedWeight {1. - m_moveArray.front().weight - (m_swap ? m_pSwap : 0.)
+                              - (m_molTranslation ? m_pMolTranslation : 0.)};
+    const double pSwap {m_pSwap};
+    const double pMolTranslation {m_pMolTranslation};
+    double bestEfficiency {-1.};
+    double bestPSwap {pSwap};
+    double bestPMolTranslation {pMolTranslation};
+
+    for (const auto& swapScale : swapScaleArray)
     {
-        swapType = 2;
-        indexSwap1 += orderVector[0];
-        indexSwap2 += orderVector[2];
+        for (const auto& molTranslationScale : molTranslationScaleArray)
+        {
+            m_pSwap = pSwap * swapScale;
+            m_pMolTranslation = pMolTranslation * molTranslationScale;
+
+            if (fixedWeight + (m_swap ? m_pSwap : 0.) + (m_molTranslation ? m_pMolTranslation : 0.) > 1.)
+            {
+                continue;
+            }
+            initializeMoveTable();
+            const double efficiency {runTuneWindow(nCandidateSteps)};
+
+            if (efficiency > bestEfficiency)
+            {
+                bestEfficiency = efficiency;
+                bestPSwap = m_pSwap;
+                bestPMolTranslation = m_pMolTranslation;
+            }
+        }
     }
-    else
+    m_pSwap = bestPSwap;
+    m_pMolTranslation = bestPMolTranslation;
+    initializeMoveTable();
+
+    for (const auto& record : m_moveArray)
     {
-        swapType = 3;
-        indexSwap1 += orderVector[1];
-        indexSwap2 += orderVector[2];
+        const double nAttempts {record.attemptRate * m_nParticles};
+        std::cout << getMoveName(record.move.index()) << " MC move cost (microseconds): "
+                  << ((nAttempts != 0.) ? 1e6 * record.cpuTime / nAttempts : 0.) << "\n";
     }
-    /***
-    if (cosAngle < - 0.3)
-    {
 
-        indexSwap1 += orderVector[0];
-        indexSwap2 += orderVector[2];
-    }
-a
-    else
+    if (m_systemDomain.isRoot())
     {
-        indexSwap1 += Random::intGenerator(0, 2);
-        indexSwap2 += Random::intGenerator(0, 2);
-
-        while (indexSwap1 == indexSwap2)
-        {
-            indexSwap2 = indexMolecule;
-            indexSwap2 += Random::intGenerator(0, 2);
-        }mv t
+        saveTuning(path);
     }
-    ***/
-    const auto& neighItBegin1 { m_systemNeighbors.getNeighItBeginI(indexSwap1) };
-    const int& lenNeigh1 {m_systemNeighbors.getLenIndexBegin(indexSwap1)};
-    const auto& neighItBegin2 { m_systemNeighbors.getNeighItBeginI(indexSwap2) };
-    const int& lenNeigh2 {m_systemNeighbors.getLenIndexBegin(indexSwap2)};
+    resetMoveCounters();
+}
 
+/*******************************************************************************
+ * This function scales rBox and rBoxMolTranslation by the ratio of their
+ * acceptance rate over the last window to m_targetAcceptance, by a factor 2 at
+ * most. A step component is capped at (rSkin - maxRc) / (2 sqrt(3)), so that a
+ * single step never moves a particle beyond the neighbor skin.
+ *
+ * @param windowArray Records at the beginning of the window.
+ ******************************************************************************/
+void MonteCarlo::tuneStepSizes(const std::vector<MoveRecord>& windowArray)
+{
+    const double maxStepSize {m_systemNeighbors.getMaxStepSize()};
 
-    double diffEnergySwap1{ m_systemMolecules.energyParticleMoleculeSwap(indexSwap1, neighItBegin1,
-                                                                   lenNeigh1, indexSwap2)};
+    const auto scaleStepSize {[&](const int& k, const std::string& name, double& stepSize)
+    {
+        const double attemptRate {m_moveArray[k].attemptRate - windowArray[k].attemptRate};
 
+        if (attemptRate > 0.)
+        {
+            const double acceptance {(m_moveArray[k].acceptanceRate - windowArray[k].acceptanceRate) / attemptRate};
+            const double scaledStepSize {stepSize * std::clamp(acceptance / m_targetAcceptance, 0.5, 2.)};
+
+            if (scaledStepSize > maxStepSize)
+            {
+                std::cout << name << " capped at the neighbor skin: " << maxStepSize << " instead of "
+                          << scaledStepSize << "\n";
+            }
+            stepSize = std::min(scaledStepSize, maxStepSize);
+        }
+    }};
 
-    double diffEnergySwap2 { m_systemMolecules.energyParticleMoleculeSwap(indexSwap2, neighItBegin2,
-                                                               lenNeigh2, indexSwap1)};
+    scaleStepSize(0, "rBox", m_rBox);
 
+    if (m_molTranslation)
+    {
+        scaleStepSize(m_moveRecordIndexArray[getMoveIndex<move::MoleculeTranslation>()], "rBoxMolTranslation",
+                      m_rBoxMolTrans);
+    }
+}
 
-    const double diffEnergy{ diffEnergySwap1 + diffEnergySwap2 };
-    // Metropolis criterion
-    const bool acceptMove { metropolis( diffEnergy) };
+/*******************************************************************************
+ * This function runs nSteps time steps of the tuner with timed moves and
+ * returns their progress per second of the per-move timers. The progress is the
+ * mean square displacement over the window (tuneMetric=msd) or the mean
+ * squared energy change between two time steps (tuneMetric=energy). The
+ * parallel pending translations are timed with the translation.
+ *
+ * @param nSteps Number of time steps of the window.
+ *
+ * @return Progress per second.
+ ******************************************************************************/
+double MonteCarlo::runTuneWindow(const int& nSteps)
+{
+    const std::vector<double> referencePositionArray {(m_tuneMetric == TuneMetric::msd) ?
+                                                      m_systemMolecules.getUnwrappedPositionArray()
+                                                      : std::vector<double> {}};
+    double cpuTime {0.};
+    double squareEnergyChange {0.};
 
-    // If the move is accepted, then the energy, the position array and the displacement array can be updated.
-    // If the m_calculatePressure is set to True, then the pressure is calculated.
-    if ( acceptMove )
+    for (const auto& record : m_moveArray)
     {
-        generalUpdate( diffEnergy );
-        switch (swapType)
-        {
-            case 1:
-                m_acceptanceRateSwap12 += 1. / m_nParticles;
-                break;
-            case 2:
-                m_acceptanceRateSwap13 += 1. / m_nParticles;
-                break;
-            case 3:
-                m_acceptanceRateSwap23 += 1. / m_nParticles;
-                break;
-            default:
-                break;
-        }
-        m_acceptanceRateSwap += 1. / m_nParticles;
-        m_systemMolecules.swapParticleTypesIJ(indexSwap1, indexSwap2);
+        cpuTime -= record.cpuTime;
+    }
 
-        /***
-        if (m_calculatePressure)
-        {
-            const double pressureParticleSwap1 {pressureParticle(m_temp, indexSwap1,
-                                                           m_positionArray[indexSwap1],
-                                                           m_positionArray, neighborIList1,
-                                                           m_typeArray, m_squareRc,
-                                                           m_lengthCube, m_halfLengthCube)};
+    for (int i = 0; i < nSteps; i++)
+    {
+        const double energy {m_energy};
+        int j { 0 };
 
-            const double pressureParticleSwap2 {pressureParticle(m_temp, indexSwap2,
-                                                           m_positionArray[indexSwap2],
-                                                           m_positionArray, neighborIList2,
-                                                           m_typeArray, m_squareRc,
-                                                           m_lengthCube, m_halfLengthCube)};
+        while (j < m_nParticles)
+        {
+            j += mcMoveTimed();
+        }
+        const auto start {std::chrono::steady_clock::now()};
+        mcPendingTranslations();
+        m_moveArray.front().cpuTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-            m_typeArray[indexSwap1] = type1;
-            m_typeArray[indexSwap2] = type2;
+        checkNeighbors();
+        accumulateMoveRates();
+        squareEnergyChange += (m_energy - energy) * (m_energy - energy);
+    }
 
-            const double pressureParticle1 {pressureParticle(m_temp, indexSwap1,
-                                                           m_positionArray[indexSwap1],
-                                                           m_positionArray, neighborIList1,
-                                                           m_typeArray, m_squareRc,
-                                                           m_lengthCube, m_halfLengthCube)};
+    for (const auto& record : m_moveArray)
+    {
+        cpuTime += record.cpuTime;
+    }
+    const double progress {(m_tuneMetric == TuneMetric::msd) ?
+                           m_systemMolecules.meanSquareDisplacement(referencePositionArray)
+                           : squareEnergyChange / nSteps};
+    return (cpuTime > 0.) ? progress / cpuTime : 0.;
+}
 
+/*******************************************************************************
+ * This function resets the acceptance counters of the moves, so that the
+ * report of mcTotal covers the production run only.
+ ******************************************************************************/
+void MonteCarlo::resetMoveCounters()
+{
+    for (auto& record : m_moveArray)
+    {
+        record.nAttempts = 0;
+        record.attemptRate = 0.;
+        record.acceptanceRate = 0.;
+    }
+    m_acceptanceRateSwap12 = 0.;
+    m_acceptanceRateSwap13 = 0.;
+    m_acceptanceRateSwap23 = 0.;
+}
 
-            const double pressureParticle2 {pressureParticle(m_temp, indexSwap2,
-                                                           m_positionArray[indexSwap2],
-                                                           m_positionArray, neighborIList2,
-                                                           m_typeArray, m_squareRc,
-                                                           m_lengthCube, m_halfLengthCube)};
+/*******************************************************************************
+ * This function prints the tuned parameters and saves them in path, one
+ * "name=value" line each as in inputVar.txt, so that they can be reused.
+ ******************************************************************************/
+void MonteCarlo::saveTuning(const std::string& path) const
+{
+    std::ofstream tuneFile {path};
+    tuneFile.precision(10);
+    std::cout << "Tuned parameters (" << path << "):\n";
+    const auto saveParameter {[&](const std::string& name, const double& value)
+    {
+        std::cout << name << "=" << value << "\n";
+        tuneFile << name << "=" << value << "\n";
+    }};
 
-            m_typeArray[indexSwap1] = type2;
-            m_typeArray[indexSwap2] = type1;
+    saveParameter("rBox", m_rBox);
 
-            m_pressure += pressureParticleSwap1 + pressureParticleSwap2 - pressureParticle1 - pressureParticle2;
-        }
-        ***/
+    if (m_swap)
+    {
+        saveParameter("pSwap", m_pSwap);
     }
-    /***
-    switch (swapType)
+
+    if (m_molTranslation)
     {
-        case 1:
-            saveDoubleIntTXT(cosAngle, acceptMove, "./thetatau12.txt");
-            break;
-        case 2:
-            saveDoubleIntTXT(cosAngle, acceptMove, "./thetatau13.txt");
-            break;
-        case 3:
-            saveDoubleIntTXT(cosAngle, acceptMove, "./thetatau23.txt");
-            break;
-        default:
-            break;
+        saveParameter("pMolTranslation", m_pMolTranslation);
+        saveParameter("rBoxMolTranslation", m_rBoxMolTrans);
     }
-    ***/
+}
 
+/*******************************************************************************
+ * These functions run one move of the registry, count its attempts in record
+ * and return the number of particle moves it counts for.
+ ******************************************************************************/
+int MonteCarlo::runMove(const move::Translation&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcTranslation();
+    return 1;
 }
 
+int MonteCarlo::runMove(const move::MultipleTryTranslation&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcTranslationMultipleTry();
+    return 1;
+}
 
-void MonteCarlo::generalUpdate(double diffEnergy)
+int MonteCarlo::runMove(const move::BatchTranslation&, MoveRecord& record)
 {
-    m_energy += diffEnergy;
+    // The sublattices need at least 4 cells per side, which a volume move can break.
+    if (!m_systemNeighbors.hasSublattices())
+    {
+        return (m_mtmTrials > 1) ? runMove(move::MultipleTryTranslation {}, record)
+                                 : runMove(move::Translation {}, record);
+    }
+    const int nBatch {mcBatchTranslation()};
+    record.nAttempts += nBatch;
+    return std::max(nBatch, 1);
+}
 
+int MonteCarlo::runMove(const move::PendingTranslation&, MoveRecord& record)
+{
+    // Run in parallel at the end of the time step, see mcSpeculativeTranslations and mcDomainTranslations.
+    ++record.nAttempts;
+    ++m_nPendingTranslations;
+    return 1;
+}
+
+int MonteCarlo::runMove(const move::Swap&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcSwap();
+    return 1;
+}
+
+int MonteCarlo::runMove(const move::NonLocalSwap&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcNonLocalSwap();
+    return 1;
+}
+
+int MonteCarlo::runMove(const move::DiameterSwap&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcDiameterSwap();
+    return 1;
+}
+
+int MonteCarlo::runMove(const move::MoleculeTranslation&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    return mcMoleculeTranslation();
+}
+
+int MonteCarlo::runMove(const move::MoleculeRotation&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    return mcMoleculeRotation();
+}
+
+int MonteCarlo::runMove(const move::Pivot&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    return mcPivot();
+}
+
+int MonteCarlo::runMove(const move::Crankshaft&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    return mcCrankshaft();
+}
+
+int MonteCarlo::runMove(const move::Regrowth&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    return mcRegrowth();
+}
+
+int MonteCarlo::runMove(const move::Volume&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcVolume();
+    return 1;
+}
+
+int MonteCarlo::runMove(const move::Mutation&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcMutation();
+    return 1;
+}
+
+int MonteCarlo::runMove(const move::Hybrid&, MoveRecord& record)
+{
+    ++record.nAttempts;
+    mcHybrid();
+    return 1;
+}
+
+/*******************************************************************************
+ * This function implements a Monte Carlo move: translation of a the whole
+ * molecule, calculation of the energy of the new system and then acceptation or
+ * not of the move according to the Metropolis criterion. Molecules of length 2,
+ * 3 and 4 use a fixed-length instantiation of the move.
+ *
+ * @return Number of particles of the chosen molecule.
+ ******************************************************************************/
+int MonteCarlo::mcMoleculeTranslation()
+{
+    const int indexMolecule { Random::intGenerator(0, m_systemMolecules.getNMolecules() - 1) }; // randomly chosen Molecule
+    const int lenMolecule {m_systemMolecules.getMoleculeLengthI(indexMolecule)};
+
+    switch (lenMolecule)
+    {
+        case 2:
+            mcMoleculeTranslationLen<2>(indexMolecule);
+            break;
+        case 3:
+            mcMoleculeTranslationLen<3>(indexMolecule);
+            break;
+        case 4:
+            mcMoleculeTranslationLen<4>(indexMolecule);
+            break;
+        default:
+            mcMoleculeTranslationLen<0>(indexMolecule);
+            break;
+    }
+    return lenMolecule;
+}
+
+/*******************************************************************************
+ * This function implements a Monte Carlo move: rigid rotation of a whole
+ * molecule about its center of mass, by a random angle in
+ * [-m_maxAngleMolRotation, m_maxAngleMolRotation] around a random axis. Only
+ * the intermolecular energy changes, plus the inner pairs of molecules larger
+ * than half the box (see energyRigidBodyDiff). Rotations that move a member past the
+ * neighbor skin are rejected, see prepareNeighborRows.
+ *
+ * @return Number of particles of the chosen molecule.
+ ******************************************************************************/
+int MonteCarlo::mcMoleculeRotation()
+{
+    constexpr int nDims {3};
+    const int indexMolecule { Random::intGenerator(0, m_systemMolecules.getNMolecules() - 1) };
+    const int& indexBegin {m_systemMolecules.getMoleculeBeginI(indexMolecule)};
+    const int lenMolecule {m_systemMolecules.getMoleculeLengthI(indexMolecule)};
+    const std::vector<double> axis {Random::unitVectorGenerator(nDims)};
+    const double angle {Random::doubleGenerator(-m_maxAngleMolRotation, m_maxAngleMolRotation)};
+    const auto chainItBegin {m_systemMolecules.getChainItBeginI(indexMolecule)};
+    const auto posItBeginRef {m_systemMolecules.getPosItBeginI(chainItBegin[0])};
+
+    // Positions relative to the first member of the chain order, unwrapped along the chain: the molecule can be
+    // larger than half the box.
+    std::vector<double> relativeArray (nDims * lenMolecule);
+    m_systemMolecules.unwrapChain(chainItBegin, lenMolecule, relativeArray.begin());
+    std::array<double, nDims> centerOfMass {};
+
+    for (int k = 0; k < lenMolecule; k++)
+    {
+        for (int d = 0; d < nDims; d++)
+        {
+            centerOfMass[d] += relativeArray[nDims * k + d] / lenMolecule;
+        }
+    }
+
+    // Positions and displacements in the order of the members.
+    std::vector<Real> positionArrayRotation (nDims * lenMolecule);
+    std::vector<double> displacementArray (nDims * lenMolecule);
+    double maxArm {0.};
+
+    for (int k = 0; k < lenMolecule; k++)
+    {
+        const int j {chainItBegin[k] - indexBegin};
+        std::array<double, nDims> arm {};
+        std::array<double, nDims> rotatedArm {};
+        std::transform(relativeArray.begin() + nDims * k, relativeArray.begin() + nDims * (k + 1),
+                       centerOfMass.begin(), arm.begin(), std::minus<>());
+        rotateVector(arm.begin(), axis.begin(), angle, rotatedArm.begin());
+        maxArm = std::max(maxArm, std::sqrt(getSquareNormVector(arm.begin(), arm.end())));
+
+        for (int d = 0; d < nDims; d++)
+        {
+            positionArrayRotation[nDims * j + d] = static_cast<Real>(posItBeginRef[d] + centerOfMass[d]
+                                                                     + rotatedArm[d]);
+            displacementArray[nDims * j + d] = rotatedArm[d] - arm[d];
+        }
+        m_systemMolecules.periodicBC(positionArrayRotation.begin() + nDims * j);
+    }
+
+    std::vector<int> indexArray (lenMolecule);
+    std::iota(indexArray.begin(), indexArray.end(), indexBegin);
+
+    if (!prepareNeighborRows(indexArray.begin(), lenMolecule, displacementArray.begin()))
+    {
+        return lenMolecule;
+    }
+
+    double diffVirial {};
+    const double diffEnergy {energyVirialDiff([&](auto withVirial)
+    {
+        constexpr bool WithVirial {decltype(withVirial)::value};
+        return energyMoleculeExtraDiff<0, WithVirial>(indexMolecule, positionArrayRotation.begin())
+               + energyRigidBodyDiff<WithVirial>(indexArray.begin(), lenMolecule, positionArrayRotation.begin(),
+                                                 maxArm);
+    }, diffVirial)};
+
+    if (metropolis(diffEnergy))
+    {
+        generalUpdate(diffEnergy, diffVirial);
+        countAccepted<move::MoleculeRotation>();
+        updateMovedParticles(indexArray.begin(), lenMolecule, positionArrayRotation.begin(), displacementArray.begin());
+    }
+    return lenMolecule;
+}
+
+/*******************************************************************************
+ * This function implements a Monte Carlo move: pivot of a linear chain. A
+ * random inner monomer is chosen and one of the two sides of the chain is
+ * rotated about it by a random angle in [-m_maxAnglePivot, m_maxAnglePivot].
+ * Molecules that are not linear chains of at least three particles are not
+ * moved (the move is counted as rejected). Pivots that move a bead past the
+ * neighbor skin are rejected, see prepareNeighborRows.
+ *
+ * @return Number of moved particles (at least 1).
+ ******************************************************************************/
+int MonteCarlo::mcPivot()
+{
+    constexpr int nDims {3};
+    const int indexMolecule { Random::intGenerator(0, m_systemMolecules.getNMolecules() - 1) };
+    const int lenMolecule {m_systemMolecules.getMoleculeLengthI(indexMolecule)};
+
+    if (!m_systemMolecules.isLinearMoleculeI(indexMolecule) || lenMolecule < 3)
+    {
+        return 1;
+    }
+
+    const auto chainItBegin {m_systemMolecules.getChainItBeginI(indexMolecule)};
+    const int indexPivot {Random::intGenerator(1, lenMolecule - 2)};
+    const bool moveStart {Random::intGenerator(0, 1) == 0};
+    const int nMoved {moveStart ? indexPivot : lenMolecule - indexPivot - 1};
+    // The pivot then the moved side, walking away from the pivot along the chain.
+    std::vector<int> walkArray (nMoved + 1);
+
+    for (int k = 0; k <= nMoved; k++)
+    {
+        walkArray[k] = chainItBegin[moveStart ? indexPivot - k : indexPivot + k];
+    }
+    const std::vector<int> movedArray (walkArray.begin() + 1, walkArray.end());
+    const std::vector<double> axis {Random::unitVectorGenerator(nDims)};
+    const double angle {Random::doubleGenerator(-m_maxAnglePivot, m_maxAnglePivot)};
+    const auto posItBeginPivot {m_systemMolecules.getPosItBeginI(chainItBegin[indexPivot])};
+
+    // Arms from the pivot, unwrapped along the chain: the chain can be larger than half the box.
+    std::vector<double> armArray (nDims * (nMoved + 1));
+    m_systemMolecules.unwrapChain(walkArray.begin(), nMoved + 1, armArray.begin());
+    std::vector<Real> positionArrayPivot (nDims * nMoved);
+    std::vector<double> displacementArray (nDims * nMoved);
+    double maxArm {0.};
+
+    for (int j = 0; j < nMoved; j++)
+    {
+        const auto armItBegin {armArray.begin() + nDims * (j + 1)};
+        std::array<double, nDims> rotatedArm {};
+        rotateVector(armItBegin, axis.begin(), angle, rotatedArm.begin());
+        maxArm = std::max(maxArm, std::sqrt(getSquareNormVector(armItBegin, armItBegin + nDims)));
+
+        for (int d = 0; d < nDims; d++)
+        {
+            positionArrayPivot[nDims * j + d] = static_cast<Real>(posItBeginPivot[d] + rotatedArm[d]);
+            displacementArray[nDims * j + d] = rotatedArm[d] - armItBegin[d];
+        }
+        m_systemMolecules.periodicBC(positionArrayPivot.begin() + nDims * j);
+    }
+
+    // The far beads of a long chain can move past the skin: such pivots are rejected.
+    if (!prepareNeighborRows(movedArray.begin(), nMoved, displacementArray.begin()))
+    {
+        return nMoved;
+    }
+
+    // The moved side is rigid: its energy with the rest of the system changes, its inner pairs only through the
+    // periodic images (see energyRigidBodyDiff).
+    std::vector<int> sortedMovedArray {movedArray};
+    std::sort(sortedMovedArray.begin(), sortedMovedArray.end());
+    double diffVirial {};
+    const double diffEnergy {energyVirialDiff([&](auto withVirial)
+    {
+        constexpr bool WithVirial {decltype(withVirial)::value};
+        EnergyResult<WithVirial> oldEnergy {};
+        EnergyResult<WithVirial> newEnergy {};
+
+        for (int j = 0; j < nMoved; j++)
+        {
+            const int& indexParticle {movedArray[j]};
+            const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+            const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexParticle)};
+
+            oldEnergy += m_systemMolecules.energyParticleExcluding<WithVirial>(
+                    indexParticle, m_systemMolecules.getPosItBeginI(indexParticle), neighItBegin, lenNeigh,
+                    sortedMovedArray.begin(), sortedMovedArray.end());
+            newEnergy += m_systemMolecules.energyParticleExcluding<WithVirial>(
+                    indexParticle, positionArrayPivot.begin() + nDims * j, neighItBegin, lenNeigh,
+                    sortedMovedArray.begin(), sortedMovedArray.end());
+        }
+        return newEnergy - oldEnergy
+               + energyRigidBodyDiff<WithVirial>(movedArray.begin(), nMoved, positionArrayPivot.begin(), maxArm);
+    }, diffVirial)};
+
+    if (metropolis(diffEnergy))
+    {
+        generalUpdate(diffEnergy, diffVirial);
+        countAccepted<move::Pivot>();
+        updateMovedParticles(movedArray.begin(), nMoved, positionArrayPivot.begin(), displacementArray.begin());
+    }
+    return nMoved;
+}
+
+/*******************************************************************************
+ * This function implements a Monte Carlo move: crankshaft rotation of an inner
+ * monomer of a linear chain about the axis joining its two bonded neighbors,
+ * by a random angle in [-m_maxAngleCrankshaft, m_maxAngleCrankshaft]. The bond
+ * lengths are unchanged. A rotation past the neighbor skin is rejected.
+ *
+ * @return 1, one particle is moved.
+ ******************************************************************************/
+int MonteCarlo::mcCrankshaft()
+{
+    constexpr int nDims {3};
+    const int indexMolecule { Random::intGenerator(0, m_systemMolecules.getNMolecules() - 1) };
+    const int lenMolecule {m_systemMolecules.getMoleculeLengthI(indexMolecule)};
+
+    if (!m_systemMolecules.isLinearMoleculeI(indexMolecule) || lenMolecule < 3)
+    {
+        return 1;
+    }
+
+    const auto chainItBegin {m_systemMolecules.getChainItBeginI(indexMolecule)};
+    const int indexChain {Random::intGenerator(1, lenMolecule - 2)};
+    const int& indexParticle {chainItBegin[indexChain]};
+    const auto posItBeginPrevious {m_systemMolecules.getPosItBeginI(chainItBegin[indexChain - 1])};
+    const auto posItBeginNext {m_systemMolecules.getPosItBeginI(chainItBegin[indexChain + 1])};
+    const double angle {Random::doubleGenerator(-m_maxAngleCrankshaft, m_maxAngleCrankshaft)};
+
+    std::array<double, nDims> axis {};
+    m_systemMolecules.separationPair(posItBeginPrevious, posItBeginNext, axis.begin());
+    const double normAxis {std::sqrt(getSquareNormVector(axis.begin(), axis.end()))};
+    std::for_each(axis.begin(), axis.end(), [&normAxis](double& n) { n /= normAxis; });
+
+    std::array<double, nDims> arm {};
+    std::array<double, nDims> rotatedArm {};
+    m_systemMolecules.separationPair(posItBeginPrevious, m_systemMolecules.getPosItBeginI(indexParticle), arm.begin());
+    rotateVector(arm.begin(), axis.begin(), angle, rotatedArm.begin());
+
+    std::array<Real, nDims> positionCrankshaft {};
+    std::array<double, nDims> displacement {};
+
+    for (int d = 0; d < nDims; d++)
+    {
+        positionCrankshaft[d] = static_cast<Real>(posItBeginPrevious[d] + rotatedArm[d]);
+        displacement[d] = rotatedArm[d] - arm[d];
+    }
+    m_systemMolecules.periodicBC(positionCrankshaft.begin());
+
+    if (!prepareNeighborRows(&indexParticle, 1, displacement.begin()))
+    {
+        return 1;
+    }
+
+    const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+    const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexParticle)};
+    double diffVirial {};
+    const double diffEnergy {energyVirialDiff([&](auto withVirial)
+    {
+        constexpr bool WithVirial {decltype(withVirial)::value};
+        return m_systemMolecules.energyParticleMolecule<WithVirial>(indexParticle, positionCrankshaft.begin(),
+                                                                    neighItBegin, lenNeigh)
+               - m_systemMolecules.energyParticleMolecule<WithVirial>(indexParticle, neighItBegin, lenNeigh);
+    }, diffVirial)};
+
+    if (metropolis(diffEnergy))
+    {
+        generalUpdate(diffEnergy, diffVirial);
+        countAccepted<move::Crankshaft>();
+        updateMovedParticles(&indexParticle, 1, positionCrankshaft.begin(), displacement.begin());
+    }
+    return 1;
+}
+
+/*******************************************************************************
+ * This function implements a Monte Carlo move: configurational-bias regrowth
+ * of a linear chain. The last nRegrow beads of the chain (from a random end,
+ * nRegrow uniform in [1, m_cbmcMaxBeads]) are removed and regrown bead by bead.
+ * Each bead gets m_cbmcTrials trial positions, uniform in a ball of radius
+ * m_cbmcBondRadius around the previous bead (uniform in the box for the first
+ * bead of a fully regrown chain), and one is chosen with its Boltzmann weight.
+ * The old configuration is retraced the same way and the move is accepted
+ * with the ratio of the Rosenbluth weights.
+ *
+ * @return Number of regrown beads.
+ ******************************************************************************/
+int MonteCarlo::mcRegrowth()
+{
+    constexpr int nDims {3};
+    const int indexMolecule { Random::intGenerator(0, m_systemMolecules.getNMolecules() - 1) };
+    const int lenMolecule {m_systemMolecules.getMoleculeLengthI(indexMolecule)};
+
+    if (!m_systemMolecules.isLinearMoleculeI(indexMolecule))
+    {
+        return 1;
+    }
+
+    const int nRegrow {Random::intGenerator(1, std::min(lenMolecule, m_cbmcMaxBeads))};
+    const auto chainItBegin {m_systemMolecules.getChainItBeginI(indexMolecule)};
+    std::vector<int> chainArray (chainItBegin, chainItBegin + lenMolecule);
+
+    if (Random::intGenerator(0, 1) == 1)
+    {
+        std::reverse(chainArray.begin(), chainArray.end());
+    }
+
+    const int firstRegrown {lenMolecule - nRegrow};
+    const std::vector<int> regrownArray (chainArray.begin() + firstRegrown, chainArray.end());
+    std::vector<int> sortedRegrownArray {regrownArray};
+    std::sort(sortedRegrownArray.begin(), sortedRegrownArray.end());
+
+    // The old bonds must be reachable by the trial generation, otherwise the reverse move does not exist.
+    for (int b = std::max(firstRegrown, 1); b < lenMolecule; b++)
+    {
+        const double squareBond {m_systemMolecules.squareDistancePair(
+                m_systemMolecules.getPosItBeginI(chainArray[b - 1]), m_systemMolecules.getPosItBeginI(chainArray[b]))};
+
+        if (squareBond > m_cbmcBondRadius * m_cbmcBondRadius)
+        {
+            return nRegrow;
+        }
+    }
+
+    std::vector<Real> oldPositionArray (nDims * nRegrow);
+    std::vector<Real> newPositionArray (nDims * nRegrow);
+    std::vector<Real> trialArray (nDims * m_cbmcTrials);
+    std::vector<double> trialEnergyArray (m_cbmcTrials);
+    std::vector<double> weightArray (m_cbmcTrials);
+    double logWeightOld {0.};
+    double logWeightNew {0.};
+    double energyOld {0.};
+    double energyNew {0.};
+
+    for (const bool isNew : {false, true})
+    {
+        std::vector<Real>& placedArray {isNew ? newPositionArray : oldPositionArray};
+        double& logWeight {isNew ? logWeightNew : logWeightOld};
+        double& energy {isNew ? energyNew : energyOld};
+
+        for (int b = 0; b < nRegrow; b++)
+        {
+            const int& indexParticle {regrownArray[b]};
+            const int chainPosition {firstRegrown + b};
+            const Real* previousPosIt {(chainPosition == 0) ? nullptr
+                                       : (b == 0) ? m_systemMolecules.getPosItBeginI(chainArray[chainPosition - 1])
+                                       : placedArray.data() + nDims * (b - 1)};
+
+            for (int k = 0; k < m_cbmcTrials; k++)
+            {
+                std::array<Real, nDims> trial {};
+
+                if (!isNew && k == 0) // The old position is the first trial of the old configuration.
+                {
+                    std::copy(m_systemMolecules.getPosItBeginI(indexParticle),
+                              m_systemMolecules.getPosItBeginI(indexParticle) + nDims, trial.begin());
+                }
+                else if (previousPosIt == nullptr)
+                {
+                    for (int d = 0; d < nDims; d++)
+                    {
+                        trial[d] = static_cast<Real>(Random::doubleGenerator(0., m_systemMolecules.getLengthCube()));
+                    }
+                }
+                else
+                {
+                    const std::vector<double> direction {Random::unitVectorGenerator(nDims)};
+                    const double radius {m_cbmcBondRadius * std::cbrt(Random::doubleGenerator(0., 1.))};
+
+                    for (int d = 0; d < nDims; d++)
+                    {
+                        trial[d] = static_cast<Real>(previousPosIt[d] + radius * direction[d]);
+                    }
+                }
+                m_systemMolecules.periodicBC(trial.begin());
+
+                for (int d = 0; d < nDims; d++)
+                {
+                    trialArray[d * m_cbmcTrials + k] = trial[d];
+                }
+            }
+
+            regrowthTrialEnergies(regrownArray, sortedRegrownArray, b, placedArray, trialArray, trialEnergyArray);
+
+            // Rosenbluth factor of the bead, shifted by the lowest energy to avoid overflows.
+            const double minEnergy {*std::min_element(trialEnergyArray.begin(), trialEnergyArray.end())};
+
+            if (!std::isfinite(minEnergy))
+            {
+                return nRegrow; // Every trial overlaps or breaks a bond.
+            }
+            std::transform(trialEnergyArray.begin(), trialEnergyArray.end(), weightArray.begin(),
+                           [&](const double& u) { return std::exp(-(u - minEnergy) / m_temp); });
+            const double sumWeight {std::accumulate(weightArray.begin(), weightArray.end(), 0.)};
+            logWeight += std::log(sumWeight) - minEnergy / m_temp;
+
+            int chosenTrial {0};
+
+            if (isNew)
+            {
+                double cumulativeWeight {Random::doubleGenerator(0., sumWeight) - weightArray[0]};
+
+                while (cumulativeWeight > 0. && chosenTrial < m_cbmcTrials - 1)
+                {
+                    ++chosenTrial;
+                    cumulativeWeight -= weightArray[chosenTrial];
+                }
+            }
+
+            for (int d = 0; d < nDims; d++)
+            {
+                placedArray[nDims * b + d] = trialArray[d * m_cbmcTrials + chosenTrial];
+            }
+            energy += trialEnergyArray[chosenTrial];
+        }
+    }
+
+    // Metropolis criterion on the ratio of the Rosenbluth weights.
+    if (metropolis(m_temp * (logWeightOld - logWeightNew)))
+    {
+        generalUpdate(energyNew - energyOld);
+        countAccepted<move::Regrowth>();
+
+        // The regrown beads can land anywhere in the box. Their unwrapped displacements follow the new chain: each
+        // bead is placed from the previous one by its minimum image bond, the first one from the kept bead or, for
+        // a whole chain, from its old position.
+        std::vector<double> displacementArray (nDims * nRegrow);
+        std::array<double, nDims> previousUnwrapped {};
+        const Real* previousPosIt {nullptr};
+
+        if (firstRegrown > 0)
+        {
+            m_systemMolecules.getUnwrappedPositionI(chainArray[firstRegrown - 1], previousUnwrapped.begin());
+            previousPosIt = m_systemMolecules.getPosItBeginI(chainArray[firstRegrown - 1]);
+        }
+        else
+        {
+            m_systemMolecules.getUnwrappedPositionI(regrownArray[0], previousUnwrapped.begin());
+            previousPosIt = m_systemMolecules.getPosItBeginI(regrownArray[0]);
+        }
+
+        for (int b = 0; b < nRegrow; b++)
+        {
+            const Real* newPosIt {newPositionArray.data() + nDims * b};
+            std::array<double, nDims> oldUnwrapped {};
+            std::array<double, nDims> step {};
+            m_systemMolecules.getUnwrappedPositionI(regrownArray[b], oldUnwrapped.begin());
+            m_systemMolecules.separationPair(previousPosIt, newPosIt, step.begin());
+
+            for (int d = 0; d < nDims; d++)
+            {
+                previousUnwrapped[d] += step[d];
+                displacementArray[nDims * b + d] = previousUnwrapped[d] - oldUnwrapped[d];
+            }
+            previousPosIt = newPosIt;
+        }
+        updateMovedParticles(regrownArray.begin(), nRegrow, newPositionArray.begin(), displacementArray.begin());
+    }
+    return nRegrow;
+}
+
+/*******************************************************************************
+ * This function calculates the energies of the trial positions of the regrown
+ * bead b. It counts the pair energy with the particles of the cell grid that
+ * are not regrown and not bonded to the bead, plus the bond energies with the
+ * kept partners and the energies with the beads already placed.
+ ******************************************************************************/
+void MonteCarlo::regrowthTrialEnergies(const std::vector<int>& regrownArray,
+                                       const std::vector<int>& sortedRegrownArray, const int& b,
+                                       const std::vector<Real>& placedArray, const std::vector<Real>& trialArray,
+                                       std::vector<double>& trialEnergyArray)
+{
+    constexpr int nDims {3};
+    const int& indexParticle {regrownArray[b]};
+    const int& particleType {m_systemMolecules.getParticleTypeI(indexParticle)};
+    const auto trialPosition {[&](const int& k)
+                              { return std::array<Real, nDims> {trialArray[k], trialArray[m_cbmcTrials + k],
+                                                                trialArray[2 * m_cbmcTrials + k]}; }};
+
+    m_regrowthCellArray.clear();
+
+    for (int k = 0; k < m_cbmcTrials; k++)
+    {
+        m_systemNeighbors.appendCellNeighborhood(m_systemNeighbors.getCellI(trialPosition(k).begin()),
+                                                 m_regrowthCellArray);
+    }
+    std::sort(m_regrowthCellArray.begin(), m_regrowthCellArray.end());
+    m_regrowthCellArray.erase(std::unique(m_regrowthCellArray.begin(), m_regrowthCellArray.end()),
+                              m_regrowthCellArray.end());
+
+    m_regrowthCandidateArray.clear();
+
+    for (const int& indexCell : m_regrowthCellArray)
+    {
+        std::copy_if(m_systemNeighbors.getCellItBeginI(indexCell), m_systemNeighbors.getCellItEndI(indexCell),
+                     std::back_inserter(m_regrowthCandidateArray), [&](const int& j)
+                     {
+                         return !std::binary_search(sortedRegrownArray.begin(), sortedRegrownArray.end(), j)
+                                && !m_systemMolecules.areBondedIJ(indexParticle, j);
+                     });
+    }
+
+    m_systemMolecules.energyTrialBatch(indexParticle, trialArray.data(), m_cbmcTrials,
+                                       m_regrowthCandidateArray.begin(), m_regrowthCandidateArray.end(),
+                                       trialEnergyArray.data());
+
+    for (int k = 0; k < m_cbmcTrials; k++)
+    {
+        const std::array<Real, nDims> trial {trialPosition(k)};
+
+        // Beads already placed.
+        for (int p = 0; p < b; p++)
+        {
+            const int& indexPlaced {regrownArray[p]};
+            const int& typePlaced {m_systemMolecules.getParticleTypeI(indexPlaced)};
+            const Real* placedPosIt {placedArray.data() + nDims * p};
+            trialEnergyArray[k] += m_systemMolecules.areBondedIJ(indexParticle, indexPlaced)
+                    ? m_systemMolecules.bondEnergyPositions(trial.begin(), particleType, placedPosIt, typePlaced)
+                    : m_systemMolecules.pairEnergyPositions(trial.begin(), indexParticle, placedPosIt, indexPlaced);
+        }
+
+        // Bonds with the kept particles.
+        for (auto it = m_systemMolecules.getBondsItBeginI(indexParticle);
+             it < m_systemMolecules.getBondsItEndI(indexParticle); ++it)
+        {
+            if (!std::binary_search(sortedRegrownArray.begin(), sortedRegrownArray.end(), *it))
+            {
+                trialEnergyArray[k] += m_systemMolecules.bondEnergyPositions(
+                        trial.begin(), particleType, m_systemMolecules.getPosItBeginI(*it),
+                        m_systemMolecules.getParticleTypeI(*it));
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * This function implements a Monte Carlo volume move in the isothermal-isobaric
+ * ensemble: random walk in ln(V), all positions scaled with the box. The
+ * energy of the scaled system is recomputed with the current neighbor list when
+ * the scaling stays within its skin (see Neighbors::isValidScale); otherwise the
+ * list is rebuilt first. The acceptance rule is
+ * exp(-[dU + P dV - (N + 1) T ln(V'/V)] / T).
+ ******************************************************************************/
+void MonteCarlo::mcVolume()
+{
+    const double oldLength {m_systemMolecules.getLengthCube()};
+    const double lnVolumeChange {Random::doubleGenerator(-m_maxLnVolume, m_maxLnVolume)};
+    const double scaleFactor {std::exp(lnVolumeChange / 3.)};
+    const double oldVolume {oldLength * oldLength * oldLength};
+    const double newVolume {oldVolume * std::exp(lnVolumeChange)};
+
+    if (!m_systemNeighbors.isValidScale(scaleFactor))
+    {
+        m_systemNeighbors.updateNeighborList(m_systemMolecules);
+        resetNeighborDependents();
+    }
+
+    m_volumeParticleArray = m_systemMolecules.getParticleRecordArray();
+    m_systemMolecules.rescaleBox(scaleFactor);
+    const double newEnergy {m_systemMolecules.energySystemMolecule(m_systemNeighbors)};
+    const double diffEnthalpy {newEnergy - m_energy + m_pressureTarget * (newVolume - oldVolume)
+                               - (m_nParticles + 1) * m_temp * lnVolumeChange};
+
+    if (metropolis(diffEnthalpy))
+    {
+        m_systemNeighbors.rescaleBox(m_systemMolecules, scaleFactor);
+        m_energy = newEnergy;
+        m_energyCompensation = 0.;
+        countAccepted<move::Volume>(); // increment of the acceptance rate.
+
+        if (m_systemMolecules.hasTypeEnergy())
+        {
+            m_systemMolecules.initializeTypeEnergy(m_systemNeighbors);
+        }
+    }
+    else
+    {
+        m_systemMolecules.restoreBox(m_volumeParticleArray, oldLength);
+    }
+}
+
+/*******************************************************************************
+ * This function rebuilds the neighbor list when a particle moved more than
+ * the skin allows, and then refreshes the structures built on it.
+ ******************************************************************************/
+void MonteCarlo::checkNeighbors()
+{
+    if (m_domainDecomposition)
+    {
+        // All ranks update together, migrating the particles that left their slab, see migrateDomain.
+        const long long nDisplaced {std::count_if(m_domainOwnedArray.begin(), m_domainOwnedArray.end(),
+                                                  [this](const int& i) { return m_systemNeighbors.isDisplacedI(i); })};
+
+        if (m_systemDomain.sumAll(nDisplaced) > 0)
+        {
+            migrateDomain();
+            resetNeighborDependents();
+        }
+        return;
+    }
+
+    if (m_systemNeighbors.checkInterDisplacement(m_systemMolecules))
+    {
+        resetNeighborDependents();
+    }
+}
+
+/*******************************************************************************
+ * This function rebuilds the data that depend on the neighbor list or on the
+ * cell grid after a list update. The grid size changes with the volume moves.
+ ******************************************************************************/
+void MonteCarlo::resetNeighborDependents()
+{
+    if (m_systemMolecules.hasTypeEnergy())
+    {
+        m_systemMolecules.initializeTypeEnergy(m_systemNeighbors);
+    }
+
+    if (m_speculativeThreads > 0 && static_cast<int>(m_cellVersionArray.size()) != m_systemNeighbors.getNCells())
+    {
+        m_cellVersionArray = std::vector<std::atomic<unsigned int>> (m_systemNeighbors.getNCells());
+    }
+}
+
+/*******************************************************************************
+ * This function implements a multiple-try Metropolis translation. m_mtmTrials
+ * trial positions are drawn around the particle and one is selected with its
+ * Boltzmann weight. m_mtmTrials - 1 reference positions are then drawn around
+ * the selected one, the old position being the last reference. The move is
+ * accepted with min(1, sum of trial weights / sum of reference weights).
+ ******************************************************************************/
+void MonteCarlo::mcTranslationMultipleTry()
+{
+    constexpr int nDims {3};
+    const int indexTranslation{Random::intGenerator(0, m_nParticles - 1)}; // randomly chosen particle
+    const auto posItBegin {m_systemMolecules.getPosItBeginI(indexTranslation)};
+    std::vector<double> displacementArray (nDims * m_mtmTrials);
+    std::vector<Real> trialArray (nDims * m_mtmTrials);
+    std::vector<Real> referenceArray (nDims * m_mtmTrials);
+    std::vector<double> trialEnergyArray (m_mtmTrials);
+    std::vector<double> referenceEnergyArray (m_mtmTrials);
+
+    // Writes the position startPosIt + displacement as trial k of a structure of arrays.
+    const auto setTrial {[&](std::vector<Real>& soaArray, const int& k, const auto& startPosIt,
+                             const double* displacement)
+    {
+        std::array<Real, nDims> trial {};
+
+        for (int d = 0; d < nDims; d++)
+        {
+            trial[d] = static_cast<Real>(startPosIt[d] + displacement[d]);
+        }
+        m_systemMolecules.periodicBC(trial.begin());
+
+        for (int d = 0; d < nDims; d++)
+        {
+            soaArray[d * m_mtmTrials + k] = trial[d];
+        }
+    }};
+
+    for (int k = 0; k < m_mtmTrials; k++)
+    {
+        const std::vector<double> randomVector (Random::vectorDoubleGenerator(nDims, -m_rBox, m_rBox));
+        std::copy(randomVector.begin(), randomVector.end(), displacementArray.begin() + nDims * k);
+        setTrial(trialArray, k, posItBegin, randomVector.data());
+    }
+    translationTrialEnergies(indexTranslation, trialArray, trialEnergyArray);
+
+    // Selection of a trial with its Boltzmann weight, the weights being shifted by the lowest energy.
+    const double minTrialEnergy {*std::min_element(trialEnergyArray.begin(), trialEnergyArray.end())};
+
+    if (!std::isfinite(minTrialEnergy))
+    {
+        return;
+    }
+
+    std::vector<double> weightArray (m_mtmTrials);
+    std::transform(trialEnergyArray.begin(), trialEnergyArray.end(), weightArray.begin(),
+                   [&](const double& u) { return std::exp(-(u - minTrialEnergy) / m_temp); });
+    const double sumTrialWeight {std::accumulate(weightArray.begin(), weightArray.end(), 0.)};
+    int chosenTrial {0};
+    double cumulativeWeight {Random::doubleGenerator(0., sumTrialWeight) - weightArray[0]};
+
+    while (cumulativeWeight > 0. && chosenTrial < m_mtmTrials - 1)
+    {
+        ++chosenTrial;
+        cumulativeWeight -= weightArray[chosenTrial];
+    }
+
+    const std::array<Real, nDims> chosenPosition {trialArray[chosenTrial], trialArray[m_mtmTrials + chosenTrial],
+                                                  trialArray[2 * m_mtmTrials + chosenTrial]};
+
+    for (int k = 0; k < m_mtmTrials - 1; k++)
+    {
+        const std::vector<double> randomVector (Random::vectorDoubleGenerator(nDims, -m_rBox, m_rBox));
+        setTrial(referenceArray, k, chosenPosition.begin(), randomVector.data());
+    }
+    const double zeroDisplacement[nDims] {};
+    setTrial(referenceArray, m_mtmTrials - 1, posItBegin, zeroDisplacement);
+    translationTrialEnergies(indexTranslation, referenceArray, referenceEnergyArray);
+
+    double sumReferenceWeight {0.};
+
+    for (const double& u : referenceEnergyArray)
+    {
+        sumReferenceWeight += std::exp(-(u - minTrialEnergy) / m_temp);
+    }
+
+    const double diffEnergy {trialEnergyArray[chosenTrial] - referenceEnergyArray[m_mtmTrials - 1]};
+
+    // Metropolis criterion on the ratio of the weight sums.
+    if (metropolis(m_temp * std::log(sumReferenceWeight / sumTrialWeight)))
+    {
+        generalUpdate(diffEnergy);
+        countAccepted<move::Translation>(); // increment of the acceptance rate.
+        m_systemNeighbors.updateInterDisplacement(indexTranslation, displacementArray.begin() + nDims * chosenTrial);
+        m_systemMolecules.updateTypeEnergyTranslation(indexTranslation, chosenPosition.begin(),
+                                                      m_systemNeighbors.getNeighItBeginI(indexTranslation),
+                                                      m_systemNeighbors.getLenIndexBegin(indexTranslation));
+        m_systemMolecules.updatePositionI(indexTranslation, chosenPosition.begin());
+    }
+}
+
+/*******************************************************************************
+ * This function implements a batch of independent translations. One particle
+ * is drawn in each cell of a random sublattice of the cell grid (cells whose
+ * coordinates have given parities), so no two of them are in each other's
+ * neighbor row. Particles bonded to an already drawn one are dropped. All the
+ * pair energy differences are evaluated together (Molecules::energyDiffBatch),
+ * then each translation is accepted or rejected on its own. The particles of
+ * the last cell layer of an odd grid, which no sublattice holds, are then
+ * translated one at a time (mcTranslationI), so that every particle can move.
+ *
+ * @return Number of attempted translations.
+ ******************************************************************************/
+int MonteCarlo::mcBatchTranslation()
+{
+    constexpr int nDims {3};
+    m_batchCellArray.clear();
+    const int parityX {Random::intGenerator(0, 1)};
+    const int parityY {Random::intGenerator(0, 1)};
+    const int parityZ {Random::intGenerator(0, 1)};
+    m_systemNeighbors.appendSublatticeCells(parityX, parityY, parityZ, m_batchCellArray);
+
+    m_batchIndexArray.clear();
+    m_batchFlagArray.resize(m_nParticles, false);
+
+    for (const int& indexCell : m_batchCellArray)
+    {
+        const auto cellItBegin {m_systemNeighbors.getCellItBeginI(indexCell)};
+        const int lenCell {static_cast<int>(m_systemNeighbors.getCellItEndI(indexCell) - cellItBegin)};
+
+        if (lenCell == 0)
+        {
+            continue;
+        }
+        const int& indexParticle {cellItBegin[Random::intGenerator(0, lenCell - 1)]};
+        const bool bondedToBatch {std::any_of(m_systemMolecules.getBondsItBeginI(indexParticle),
+                                              m_systemMolecules.getBondsItEndI(indexParticle),
+                                              [this](const int& j) { return m_batchFlagArray[j]; })};
+        if (!bondedToBatch)
+        {
+            m_batchFlagArray[indexParticle] = true;
+            m_batchIndexArray.push_back(indexParticle);
+        }
+    }
+
+    const int nLanes {static_cast<int>(m_batchIndexArray.size())};
+    std::vector<Real> newPositionArray (nDims * nLanes);
+    std::vector<double> displacementArray (nDims * nLanes);
+    std::vector<const int*> rowArray (nLanes);
+    std::vector<int> lenArray (nLanes);
+    std::vector<double> diffEnergyArray (nLanes);
+
+    for (int b = 0; b < nLanes; b++)
+    {
+        const int& indexParticle {m_batchIndexArray[b]};
+        m_batchFlagArray[indexParticle] = false;
+        const std::vector<double> randomVector (Random::vectorDoubleGenerator(nDims, -m_rBox, m_rBox));
+        const std::vector<Real> positionTranslation {vectorTranslation(indexParticle, randomVector.begin())};
+        std::copy(randomVector.begin(), randomVector.end(), displacementArray.begin() + nDims * b);
+
+        for (int d = 0; d < nDims; d++)
+        {
+            newPositionArray[d * nLanes + b] = positionTranslation[d];
+        }
+        rowArray[b] = &*m_systemNeighbors.getNeighItBeginI(indexParticle);
+        lenArray[b] = m_systemNeighbors.getLenIndexBegin(indexParticle);
+    }
+
+    m_systemMolecules.energyDiffBatch(m_batchIndexArray, newPositionArray, rowArray, lenArray, diffEnergyArray);
+
+    for (int b = 0; b < nLanes; b++)
+    {
+        const int& indexParticle {m_batchIndexArray[b]};
+        const std::array<Real, nDims> newPosition {newPositionArray[b], newPositionArray[nLanes + b],
+                                                   newPositionArray[2 * nLanes + b]};
+        const double diffEnergy {diffEnergyArray[b]
+                                 + m_systemMolecules.bondEnergyI(indexParticle, newPosition.begin())
+                                 - m_systemMolecules.bondEnergyI(indexParticle,
+                                                                 m_systemMolecules.getPosItBeginI(indexParticle))};
+
+        if (metropolis(diffEnergy))
+        {
+            generalUpdate(diffEnergy);
+            countAccepted<move::Translation>(); // increment of the acceptance rate.
+            m_systemNeighbors.updateInterDisplacement(indexParticle, displacementArray.begin() + nDims * b);
+            m_systemMolecules.updateTypeEnergyTranslation(indexParticle, newPosition.begin(),
+                                                          m_systemNeighbors.getNeighItBeginI(indexParticle),
+                                                          m_systemNeighbors.getLenIndexBegin(indexParticle));
+            m_systemMolecules.updatePositionI(indexParticle, newPosition.begin());
+        }
+    }
+
+    // The cells of the last layer of an odd grid are in no sublattice. Each of them is visited with the probability
+    // 1/8 of a sublattice cell and one of its particles is translated on its own.
+    m_batchCellArray.clear();
+    m_systemNeighbors.appendLastLayerCells(m_batchCellArray);
+    int nSingles {0};
+
+    for (const int& indexCell : m_batchCellArray)
+    {
+        const auto cellItBegin {m_systemNeighbors.getCellItBeginI(indexCell)};
+        const int lenCell {static_cast<int>(m_systemNeighbors.getCellItEndI(indexCell) - cellItBegin)};
+
+        if (lenCell == 0 || Random::doubleGenerator(0., 1.) >= 0.125)
+        {
+            continue;
+        }
+        mcTranslationI(cellItBegin[Random::intGenerator(0, lenCell - 1)]);
+        ++nSingles;
+    }
+    return nLanes + nSingles;
+}
+
+/*******************************************************************************
+ * This function runs nAttempts translations on m_speculativeThreads threads
+ * without locks. The energy difference of a move reads the particles of the
+ * cells around the moved particle (the neighbor rows and bonds only reach these
+ * cells between two neighbor list updates). Like a sequence lock, a worker
+ * records the versions of these cells before the evaluation and checks them
+ * afterwards; a move is committed by bumping the version of the particle's cell
+ * to an odd value with a compare-and-swap, validating the other cells and
+ * releasing the cell with the next even version. A conflict (a cell written in
+ * between) re-evaluates the same move on the current configuration, so that
+ * every decision is taken on a consistent state and the commits are
+ * serializable.
+ * The workers read the positions from m_speculativePositionArray with relaxed
+ * atomic loads (a torn read set fails the validation) and write both this copy
+ * and the particle records, which only the owner of the cell lock touches.
+ * The type energy cache is not updated by the workers; it is rebuilt after the
+ * parallel section.
+ ******************************************************************************/
+void MonteCarlo::mcSpeculativeTranslations(const int& nAttempts)
+{
+    constexpr int nDims {3};
+    const int nThreads {static_cast<int>(m_workerGeneratorArray.size())};
+    std::vector<double> threadEnergyArray (nThreads, 0.);
+    long long nCommits {0};
+    long long nConflicts {0};
+    long long nRetries {0};
+
+    for (int i = 0; i < m_nParticles; i++)
+    {
+        const auto posItBegin {m_systemMolecules.getPosItBeginI(i)};
+
+        for (int d = 0; d < nDims; d++)
+        {
+            m_speculativePositionArray[nDims * i + d].store(posItBegin[d], std::memory_order_relaxed);
+        }
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(nThreads) reduction(+:nCommits, nConflicts, nRetries)
+#endif
+    {
+        int indexThread {0};
+#ifdef _OPENMP
+        indexThread = omp_get_thread_num();
+#endif
+        std::mt19937& generator {m_workerGeneratorArray[indexThread]};
+        std::vector<int> readCellArray {};
+        std::vector<unsigned int> readVersionArray {};
+        std::vector<Real> readPositionArray {};
+        double energyThread {0.};
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic, 16)
+#endif
+        for (int k = 0; k < nAttempts; k++)
+        {
+            const int indexParticle {std::uniform_int_distribution{0, m_nParticles - 1}(generator)};
+            std::array<double, nDims> randomVector {};
+
+            for (auto& component : randomVector)
+            {
+                component = std::uniform_real_distribution<double> {-m_rBox, m_rBox}(generator);
+            }
+            const double randomAccept {std::uniform_real_distribution<double> {0., 1.}(generator)};
+
+            const int indexCell {m_systemNeighbors.getParticleCellI(indexParticle)};
+            readCellArray.clear();
+            m_systemNeighbors.appendCellNeighborhood(indexCell, readCellArray);
+            for (auto it = m_systemMolecules.getBondsItBeginI(indexParticle);
+                 it < m_systemMolecules.getBondsItEndI(indexParticle); ++it)
+            {
+                readCellArray.push_back(m_systemNeighbors.getParticleCellI(*it));
+            }
+            std::sort(readCellArray.begin(), readCellArray.end());
+            readCellArray.erase(std::unique(readCellArray.begin(), readCellArray.end()), readCellArray.end());
+            readVersionArray.resize(readCellArray.size());
+            const auto ownSlot {std::find(readCellArray.begin(), readCellArray.end(), indexCell)
+                                - readCellArray.begin()};
+
+            const auto neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+            const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexParticle)};
+            const auto bondsItBegin {m_systemMolecules.getBondsItBeginI(indexParticle)};
+            const int nBonds {static_cast<int>(m_systemMolecules.getBondsItEndI(indexParticle) - bondsItBegin)};
+            readPositionArray.resize(nDims * (1 + lenNeigh + nBonds));
+
+            // Read set: the particle, its neighbor row and its bonded particles, in the order of
+            // Molecules::energyParticleMoleculeAt.
+            const auto copyPosition = [&](const int& j, const int& slot)
+            {
+                for (int d = 0; d < nDims; d++)
+                {
+                    readPositionArray[nDims * slot + d] = m_speculativePositionArray[nDims * j + d].load(
+                            std::memory_order_relaxed);
+                }
+            };
+
+            const auto validate = [&]()
+            {
+                for (std::size_t c = 0; c < readCellArray.size(); c++)
+                {
+                    if (m_cellVersionArray[readCellArray[c]].load() != readVersionArray[c])
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+            bool conflicted {false};
+
+            while (true)
+            {
+                for (std::size_t c = 0; c < readCellArray.size(); c++)
+                {
+                    // Waits for the cells being written.
+                    do
+                    {
+                        readVersionArray[c] = m_cellVersionArray[readCellArray[c]].load(std::memory_order_acquire);
+                    } while (readVersionArray[c] & 1U);
+                }
+
+                copyPosition(indexParticle, 0);
+
+                for (int k = 0; k < lenNeigh; k++)
+                {
+                    copyPosition(neighItBegin[k], 1 + k);
+                }
+
+                for (int k = 0; k < nBonds; k++)
+                {
+                    copyPosition(bondsItBegin[k], 1 + lenNeigh + k);
+                }
+
+                std::array<Real, nDims> newPosition {};
+                const auto posItBegin {readPositionArray.begin()};
+                std::transform(posItBegin, posItBegin + nDims, randomVector.begin(), newPosition.begin(),
+                               std::plus<>());
+                m_systemMolecules.periodicBC(newPosition.begin());
+
+                const double diffEnergy {m_systemMolecules.energyParticleMoleculeAt(indexParticle, newPosition.begin(),
+                                                                                    neighItBegin, lenNeigh,
+                                                                                    posItBegin + nDims)
+                                         - m_systemMolecules.energyParticleMoleculeAt(indexParticle, posItBegin,
+                                                                                      neighItBegin, lenNeigh,
+                                                                                      posItBegin + nDims)};
+                const bool accepted {diffEnergy <= 0. || randomAccept < std::exp(-diffEnergy / m_temp)};
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (!accepted)
+                {
+                    if (validate())
+                    {
+                        break;
+                    }
+                    ++nConflicts;
+                    conflicted = true;
+                    continue;
+                }
+
+                unsigned int ownVersion {readVersionArray[ownSlot]};
+
+                if (!m_cellVersionArray[indexCell].compare_exchange_strong(ownVersion, ownVersion + 1))
+                {
+                    ++nConflicts;
+                    conflicted = true;
+                    continue;
+                }
+                readVersionArray[ownSlot] = ownVersion + 1;
+
+                if (!validate())
+                {
+                    m_cellVersionArray[indexCell].store(ownVersion, std::memory_order_release);
+                    ++nConflicts;
+                    conflicted = true;
+                    continue;
+                }
+
+                for (int d = 0; d < nDims; d++)
+                {
+                    m_speculativePositionArray[nDims * indexParticle + d].store(newPosition[d],
+                                                                                std::memory_order_relaxed);
+                }
+                m_systemMolecules.updatePositionI(indexParticle, newPosition.begin());
+                m_systemNeighbors.updateInterDisplacement(indexParticle, randomVector.begin());
+                energyThread += diffEnergy;
+                ++nCommits;
+                m_cellVersionArray[indexCell].store(ownVersion + 2, std::memory_order_release);
+                break;
+            }
+
+            if (conflicted)
+            {
+                ++nRetries;
+            }
+        }
+        threadEnergyArray[indexThread] = energyThread;
+    }
+
+    for (const double& energyThread : threadEnergyArray)
+    {
+        generalUpdate(energyThread);
+    }
+
+    if (m_systemMolecules.hasTypeEnergy())
+    {
+        m_systemMolecules.initializeTypeEnergy(m_systemNeighbors);
+    }
+
+    countAccepted<move::Translation>(static_cast<double>(nCommits));
+    m_nSpeculativeAttempts += nAttempts;
+    m_nSpeculativeCommits += nCommits;
+    m_nSpeculativeConflicts += nConflicts;
+    m_nSpeculativeRetries += nRetries;
+}
+
+/*******************************************************************************
+ * This function runs nAttempts translations split over the MPI ranks, each
+ * rank translating the particles of its slab with its own random stream. A
+ * rank draws its share of the nAttempts draws of a particle among all of them
+ * (binomial) and groups the drawn particles by the sublattice of their cell.
+ * The 8 sublattices are swept in a random order drawn from Random::mt, which
+ * all ranks share (the cells of a sublattice do not interact). After each
+ * sub-sweep the ranks send the particles they moved to the neighboring ranks
+ * that hold them as ghosts, see exchangeDomainHalo. Particles outside the
+ * sublattices, or bonded to a particle of another cell of the same
+ * sublattice, are translated after the sub-sweeps by the ranks in turn, two
+ * neighboring ranks never at the same time.
+ * The energy differences and the acceptances are summed over the ranks, so
+ * that every rank keeps the energy of the whole system.
+ ******************************************************************************/
+void MonteCarlo::mcDomainTranslations(const int& nAttempts)
+{
+    constexpr int nDims {3};
+    constexpr int nSublattices {8};
+    constexpr int lenRecord {1 + 2 * nDims}; // index, new position, displacement
+    const int nOwned {static_cast<int>(m_domainOwnedArray.size())};
+    const int nAttemptsRank {std::binomial_distribution<int> {
+            nAttempts, static_cast<double>(nOwned) / m_nParticles}(m_domainGenerator)};
+    std::array<std::vector<int>, nSublattices> sublatticeAttemptArray {};
+    std::vector<int> sharedAttemptArray {};
+
+    for (int k = 0; k < nAttemptsRank; k++)
+    {
+        const int indexParticle {
+                m_domainOwnedArray[std::uniform_int_distribution<int> {0, nOwned - 1}(m_domainGenerator)]};
+        const int indexCell {m_systemNeighbors.getParticleCellI(indexParticle)};
+        const int sublattice {m_systemNeighbors.getSublatticeI(indexCell)};
+        const bool bondedInSublattice {std::any_of(
+                m_systemMolecules.getBondsItBeginI(indexParticle), m_systemMolecules.getBondsItEndI(indexParticle),
+                [&](const int& j)
+                {
+                    const int cellJ {m_systemNeighbors.getParticleCellI(j)};
+                    return cellJ != indexCell && m_systemNeighbors.getSublatticeI(cellJ) == sublattice;
+                })};
+
+        if (sublattice < 0 || bondedInSublattice)
+        {
+            sharedAttemptArray.push_back(indexParticle);
+        }
+        else
+        {
+            sublatticeAttemptArray[sublattice].push_back(indexParticle);
+        }
+    }
+
+    std::array<int, nSublattices> sublatticeOrder {};
+    std::iota(sublatticeOrder.begin(), sublatticeOrder.end(), 0);
+    std::shuffle(sublatticeOrder.begin(), sublatticeOrder.end(), Random::mt);
+
+    double diffEnergyRank {0.};
+    long long nAcceptedRank {0};
+    std::vector<double> movedArray {};
+    std::array<double, nDims> displacement {};
+
+    const auto translateAttempts {[&](const std::vector<int>& attemptArray)
+    {
+        for (const int& indexParticle : attemptArray)
+        {
+            double diffEnergy {0.};
+
+            if (!translateParticle(indexParticle, m_domainGenerator, displacement, diffEnergy))
+            {
+                continue;
+            }
+            diffEnergyRank += diffEnergy;
+            ++nAcceptedRank;
+            m_systemNeighbors.updateInterDisplacement(indexParticle, displacement.begin());
+
+            if (m_domainSendSlotArray[0][indexParticle] < 0 && m_domainSendSlotArray[1][indexParticle] < 0)
+            {
+                continue; // Not a ghost of another rank.
+            }
+
+            if (m_domainSlotArray[indexParticle] < 0)
+            {
+                m_domainSlotArray[indexParticle] = static_cast<int>(movedArray.size());
+                movedArray.resize(movedArray.size() + lenRecord, 0.);
+                movedArray[m_domainSlotArray[indexParticle]] = indexParticle;
+            }
+            const auto recordIt {movedArray.begin() + m_domainSlotArray[indexParticle]};
+            const auto posItBegin {m_systemMolecules.getPosItBeginI(indexParticle)};
+            std::copy(posItBegin, posItBegin + nDims, recordIt + 1);
+            std::transform(recordIt + 1 + nDims, recordIt + lenRecord, displacement.begin(), recordIt + 1 + nDims,
+                           std::plus<>());
+        }
+    }};
+
+    for (const int& sublattice : sublatticeOrder)
+    {
+        translateAttempts(sublatticeAttemptArray[sublattice]);
+        exchangeDomainHalo(movedArray);
+    }
+
+    // Neighboring ranks take different turns, an odd number of ranks needs a third turn.
+    const int nRanks {m_systemDomain.getNRanks()};
+    const int rank {m_systemDomain.getRank()};
+    const int nTurns {(nRanks == 1) ? 1 : 2 + nRanks % 2};
+    const int turnRank {(nRanks > 1 && nRanks % 2 == 1 && rank == nRanks - 1) ? 2 : rank % 2};
+
+    for (int turn = 0; turn < nTurns; turn++)
+    {
+        if (turn == turnRank)
+        {
+            translateAttempts(sharedAttemptArray);
+        }
+        exchangeDomainHalo(movedArray);
+    }
+
+    const long long nAccepted {m_systemDomain.sumAll(nAcceptedRank)};
+    generalUpdate(m_systemDomain.sumAll(diffEnergyRank));
+    countAccepted<move::Translation>(static_cast<double>(nAccepted));
+}
+
+/*******************************************************************************
+ * This function sends the new positions and the displacements of the
+ * particles of movedArray (local index, position, displacement) to the ranks
+ * that hold them as ghosts, and applies the ones received. A record is sent
+ * with the slot of the particle in the send list, which the receiving rank
+ * maps to its ghost (see buildDomain). movedArray is cleared.
+ ******************************************************************************/
+void MonteCarlo::exchangeDomainHalo(std::vector<double>& movedArray)
+{
+    constexpr int nDims {3};
+    constexpr int lenRecord {1 + 2 * nDims};
+    std::array<std::vector<double>, 2> sendRecordArray {};
+
+    for (auto recordIt = movedArray.begin(); recordIt < movedArray.end(); recordIt += lenRecord)
+    {
+        const int indexParticle {static_cast<int>(recordIt[0])};
+        m_domainSlotArray[indexParticle] = -1;
+
+        for (int side = 0; side < 2; side++)
+        {
+            const int slot {m_domainSendSlotArray[side][indexParticle]};
+
+            if (slot >= 0)
+            {
+                sendRecordArray[side].push_back(slot);
+                sendRecordArray[side].insert(sendRecordArray[side].end(), recordIt + 1, recordIt + lenRecord);
+            }
+        }
+    }
+    movedArray.clear();
+
+    std::array<std::vector<double>, 2> receivedRecordArray {};
+    m_systemDomain.exchangeNeighbors(sendRecordArray[0], sendRecordArray[1], receivedRecordArray[0],
+                                     receivedRecordArray[1]);
+
+    for (int side = 0; side < 2; side++)
+    {
+        for (auto recordIt = receivedRecordArray[side].begin(); recordIt < receivedRecordArray[side].end();
+             recordIt += lenRecord)
+        {
+            const int indexParticle {m_domainReceiveArray[side][static_cast<int>(recordIt[0])]};
+            m_systemMolecules.updatePositionI(indexParticle, recordIt + 1);
+            m_systemNeighbors.updateInterDisplacement(indexParticle, recordIt + 1 + nDims);
+        }
+    }
+}
+
+/*******************************************************************************
+ * This function sets up the domain decomposition from the whole configuration,
+ * read by every rank: each rank keeps the particles of its slab and its ghost
+ * layers (see buildDomain), the rest is freed. Only the translations have a
+ * domain-local version, the other moves and the analyses that need the whole
+ * configuration are refused.
+ ******************************************************************************/
+void MonteCarlo::initializeDomain()
+{
+    const std::vector<std::pair<std::string, bool>> optionArray {
+            {"swap", m_swap}, {"molTranslation", m_molTranslation}, {"molRotation", m_molRotation},
+            {"pivot", m_pivot}, {"crankshaft", m_crankshaft}, {"regrowth", m_regrowth},
+            {"volumeMove", m_volumeMove}, {"hybrid", m_hybrid}, {"mutation", m_mutation},
+            {"mtmTrials", m_mtmTrials > 1}, {"batchTranslation", m_batchTranslation},
+            {"speculativeThreads", m_speculativeThreads > 0}, {"quench", m_quench}, {"widomRate", m_widomRate > 0},
+            {"saveDisplacement", m_saveDisplacement}, {"saveParticleEnergy", m_saveParticleEnergy}};
+
+    for (const auto& [option, enabled] : optionArray)
+    {
+        if (enabled)
+        {
+            std::cerr << option << " is not supported with domainDecomposition, which only runs translations\n";
+            std::abort();
+        }
+    }
+
+    if (!m_systemNeighbors.hasSublattices())
+    {
+        std::cerr << "domainDecomposition needs at least 4 cells per side of the box (lengthCube / rSkin)\n";
+        std::abort();
+    }
+
+    if (m_systemNeighbors.getNumCell() < m_systemDomain.getNRanks())
+    {
+        std::cerr << "domainDecomposition needs at least one cell layer (lengthCube / rSkin) per rank\n";
+        std::abort();
+    }
+    std::seed_seq seedSequence {static_cast<unsigned int>(Random::mt()),
+                                static_cast<unsigned int>(m_systemDomain.getRank())};
+    m_domainGenerator.seed(seedSequence);
+
+    m_domainGlobalIndexArray.resize(m_nParticles);
+    std::iota(m_domainGlobalIndexArray.begin(), m_domainGlobalIndexArray.end(), 0);
+    std::vector<double> ownedRecordArray {};
+
+    for (int indexParticle = 0; indexParticle < m_nParticles; indexParticle++)
+    {
+        if (getDomainOwnerI(indexParticle) == m_systemDomain.getRank())
+        {
+            packDomainParticle(indexParticle, ownedRecordArray);
+        }
+    }
+    buildDomain(ownedRecordArray);
+}
+
+/*******************************************************************************
+ * This function builds the local particles of the rank from the records of
+ * the particles of its slab (see packDomainParticle):
+ * - The particles of the slab less than rSkin from its left or right side are
+ *   sent to the left or right rank, which keeps them as ghosts, and the ghosts
+ *   of the neighboring slabs are received.
+ * - The local particles are sorted by global index, so that the particles of
+ *   a molecule stay contiguous, and the bonds are renumbered. The ghosts lose
+ *   their bonds to particles that are not local, the particles of the slab
+ *   must keep all theirs.
+ * - The neighbor list and the cell grid are rebuilt for the local particles.
+ ******************************************************************************/
+void MonteCarlo::buildDomain(const std::vector<double>& ownedRecordArray)
+{
+    const int numCell {m_systemNeighbors.getNumCell()};
+    const double cellLength {m_systemMolecules.getLengthCube() / numCell};
+    const double xBegin {m_systemDomain.getFirstLayer(m_systemDomain.getRank(), numCell) * cellLength};
+    const double xEnd {m_systemDomain.getFirstLayer(m_systemDomain.getRank() + 1, numCell) * cellLength};
+    const double rSkin {m_systemNeighbors.getRSkin()};
+    std::array<std::vector<double>, 2> ghostRecordArray {};
+
+    if (m_systemDomain.getNRanks() > 1)
+    {
+        for (const int& offset : getDomainRecordOffsets(ownedRecordArray))
+        {
+            const auto recordItBegin {ownedRecordArray.begin() + offset};
+            const auto recordItEnd {recordItBegin + m_lenDomainRecord + static_cast<int>(recordItBegin[m_lenDomainRecord - 1])};
+
+            if (recordItBegin[4] - xBegin < rSkin)
+            {
+                ghostRecordArray[0].insert(ghostRecordArray[0].end(), recordItBegin, recordItEnd);
+            }
+            if (xEnd - recordItBegin[4] < rSkin)
+            {
+                ghostRecordArray[1].insert(ghostRecordArray[1].end(), recordItBegin, recordItEnd);
+            }
+        }
+    }
+    std::array<std::vector<double>, 2> receivedRecordArray {};
+    m_systemDomain.exchangeNeighbors(ghostRecordArray[0], ghostRecordArray[1], receivedRecordArray[0],
+                                     receivedRecordArray[1]);
+
+    std::vector<double> localRecordArray {ownedRecordArray};
+    const auto nOwnedValues {static_cast<int>(localRecordArray.size())};
+    localRecordArray.insert(localRecordArray.end(), receivedRecordArray[0].begin(), receivedRecordArray[0].end());
+    localRecordArray.insert(localRecordArray.end(), receivedRecordArray[1].begin(), receivedRecordArray[1].end());
+    std::vector<int> offsetArray {getDomainRecordOffsets(localRecordArray)};
+    std::sort(offsetArray.begin(), offsetArray.end(), [&localRecordArray](const int& a, const int& b)
+    {
+        return localRecordArray[a] < localRecordArray[b];
+    });
+
+    const int nLocal {static_cast<int>(offsetArray.size())};
+    m_domainGlobalIndexArray.resize(nLocal);
+    m_domainOwnedFlagArray.assign(nLocal, false);
+    m_domainOwnedArray.clear();
+
+    for (int indexParticle = 0; indexParticle < nLocal; indexParticle++)
+    {
+        m_domainGlobalIndexArray[indexParticle] = static_cast<int>(localRecordArray[offsetArray[indexParticle]]);
+
+        if (offsetArray[indexParticle] < nOwnedValues)
+        {
+            m_domainOwnedFlagArray[indexParticle] = true;
+            m_domainOwnedArray.push_back(indexParticle);
+        }
+    }
+
+    const auto getLocalIndex {[this](const double& globalIndex)
+    {
+        const auto it {std::lower_bound(m_domainGlobalIndexArray.begin(), m_domainGlobalIndexArray.end(),
+                                        static_cast<int>(globalIndex))};
+        return (it != m_domainGlobalIndexArray.end() && *it == static_cast<int>(globalIndex))
+               ? static_cast<int>(it - m_domainGlobalIndexArray.begin()) : -1;
+    }};
+
+    std::vector<int> bondsArray {};
+    std::vector<int> bondsIndex {0};
+
+    for (int indexParticle = 0; indexParticle < nLocal; indexParticle++)
+    {
+        const auto recordIt {localRecordArray.begin() + offsetArray[indexParticle]};
+
+        for (int k = 0; k < static_cast<int>(recordIt[m_lenDomainRecord - 1]); k++)
+        {
+            const int indexJ {getLocalIndex(recordIt[m_lenDomainRecord + k])};
+
+            if (indexJ >= 0)
+            {
+                bondsArray.push_back(indexJ);
+            }
+            else if (m_domainOwnedFlagArray[indexParticle])
+            {
+                std::cerr << "Particle " << m_domainGlobalIndexArray[indexParticle] << " is bonded to a particle "
+                          << "beyond the ghost layer (rSkin) of its slab: domainDecomposition needs shorter bonds\n";
+                std::abort();
+            }
+        }
+        bondsIndex.push_back(static_cast<int>(bondsArray.size()));
+    }
+
+    for (int side = 0; side < 2; side++)
+    {
+        m_domainSendArray[side].clear();
+        m_domainSendSlotArray[side].assign(nLocal, -1);
+        m_domainReceiveArray[side].clear();
+
+        for (const int& offset : getDomainRecordOffsets(ghostRecordArray[side]))
+        {
+            m_domainSendSlotArray[side][getLocalIndex(ghostRecordArray[side][offset])]
+                    = static_cast<int>(m_domainSendArray[side].size());
+            m_domainSendArray[side].push_back(getLocalIndex(ghostRecordArray[side][offset]));
+        }
+
+        for (const int& offset : getDomainRecordOffsets(receivedRecordArray[side]))
+        {
+            m_domainReceiveArray[side].push_back(getLocalIndex(receivedRecordArray[side][offset]));
+        }
+    }
+
+    unpackDomainParticles(localRecordArray, offsetArray, std::move(bondsArray), std::move(bondsIndex),
+                          m_systemMolecules);
+    m_systemNeighbors.updateNeighborList(m_systemMolecules, false);
+    m_domainSlotArray.assign(nLocal, -1);
+}
+
+/*******************************************************************************
+ * This function moves the particles that left the slab of the rank since the
+ * last neighbor list update to the left or right rank, with their molecule
+ * type, image counters and bonds, then rebuilds the ghost layers and the local
+ * neighbor list (see buildDomain). The particles move by less than the skin
+ * between two updates, so they can only enter the slab of a neighboring rank.
+ ******************************************************************************/
+void MonteCarlo::migrateDomain()
+{
+    std::vector<double> ownedRecordArray {};
+    std::array<std::vector<double>, 2> leavingRecordArray {};
+
+    for (const int& indexParticle : m_domainOwnedArray)
+    {
+        const int owner {getDomainOwnerI(indexParticle)};
+
+        if (owner == m_systemDomain.getRank())
+        {
+            packDomainParticle(indexParticle, ownedRecordArray);
+        }
+        else if (owner == m_systemDomain.getRightRank())
+        {
+            packDomainParticle(indexParticle, leavingRecordArray[1]);
+        }
+        else if (owner == m_systemDomain.getLeftRank())
+        {
+            packDomainParticle(indexParticle, leavingRecordArray[0]);
+        }
+        else
+        {
+            std::cerr << "Particle " << m_domainGlobalIndexArray[indexParticle]
+                      << " crossed a whole slab between two neighbor list updates\n";
+            std::abort();
+        }
+    }
+
+    std::array<std::vector<double>, 2> arrivingRecordArray {};
+    m_systemDomain.exchangeNeighbors(leavingRecordArray[0], leavingRecordArray[1], arrivingRecordArray[0],
+                                     arrivingRecordArray[1]);
+    ownedRecordArray.insert(ownedRecordArray.end(), arrivingRecordArray[0].begin(), arrivingRecordArray[0].end());
+    ownedRecordArray.insert(ownedRecordArray.end(), arrivingRecordArray[1].begin(), arrivingRecordArray[1].end());
+    buildDomain(ownedRecordArray);
+}
+
+/*******************************************************************************
+ * This function appends the record of a local particle to recordArray: global
+ * index, molecule type, particle type, diameter, position, image counters,
+ * number of bonds (m_lenDomainRecord values), then the global indices of the
+ * bonded particles.
+ ******************************************************************************/
+void MonteCarlo::packDomainParticle(const int& indexParticle, std::vector<double>& recordArray) const
+{
+    constexpr int nDims {3};
+    const auto posItBegin {m_systemMolecules.getPosItBeginI(indexParticle)};
+    const auto flagItBegin {m_systemMolecules.getFlagsArray().begin() + nDims * indexParticle};
+    const auto bondsItBegin {m_systemMolecules.getBondsItBeginI(indexParticle)};
+    const auto bondsItEnd {m_systemMolecules.getBondsItEndI(indexParticle)};
+
+    recordArray.push_back(m_domainGlobalIndexArray[indexParticle]);
+    recordArray.push_back(m_systemMolecules.getMoleculeTypeI(indexParticle));
+    recordArray.push_back(m_systemMolecules.getParticleTypeI(indexParticle));
+    recordArray.push_back(m_systemMolecules.getDiameterI(indexParticle));
+    recordArray.insert(recordArray.end(), posItBegin, posItBegin + nDims);
+    recordArray.insert(recordArray.end(), flagItBegin, flagItBegin + nDims);
+    recordArray.push_back(static_cast<double>(bondsItEnd - bondsItBegin));
+
+    for (auto it = bondsItBegin; it < bondsItEnd; ++it)
+    {
+        recordArray.push_back(m_domainGlobalIndexArray[*it]);
+    }
+}
+
+/*******************************************************************************
+ * This function returns the offsets of the particle records of recordArray,
+ * see packDomainParticle.
+ ******************************************************************************/
+std::vector<int> MonteCarlo::getDomainRecordOffsets(const std::vector<double>& recordArray)
+{
+    std::vector<int> offsetArray {};
+
+    for (int offset = 0; offset < static_cast<int>(recordArray.size());
+         offset += m_lenDomainRecord + static_cast<int>(recordArray[offset + m_lenDomainRecord - 1]))
+    {
+        offsetArray.push_back(offset);
+    }
+    return offsetArray;
+}
+
+/*******************************************************************************
+ * This function gives to molecules the particles of the records of
+ * recordArray at the offsets of offsetArray, in this order, with the bonds
+ * bondsArray and bondsIndex (see Molecules::assignParticles).
+ ******************************************************************************/
+void MonteCarlo::unpackDomainParticles(const std::vector<double>& recordArray, const std::vector<int>& offsetArray,
+                                       std::vector<int> bondsArray, std::vector<int> bondsIndex,
+                                       Molecules& molecules)
+{
+    constexpr int nDims {3};
+    const int nLocal {static_cast<int>(offsetArray.size())};
+    std::vector<ParticleRecord> particleArray (nLocal);
+    std::vector<int> flagsArray (nDims * nLocal);
+    std::vector<int> moleculeTypeArray (nLocal);
+    std::vector<Real> diameterArray (molecules.isPolydisperse() ? nLocal : 0);
+
+    for (int indexParticle = 0; indexParticle < nLocal; indexParticle++)
+    {
+        const auto recordIt {recordArray.begin() + offsetArray[indexParticle]};
+        moleculeTypeArray[indexParticle] = static_cast<int>(recordIt[1]);
+        particleArray[indexParticle].type = static_cast<int>(recordIt[2]);
+
+        if (molecules.isPolydisperse())
+        {
+            diameterArray[indexParticle] = static_cast<Real>(recordIt[3]);
+        }
+
+        for (int d = 0; d < nDims; d++)
+        {
+            particleArray[indexParticle].position[d] = static_cast<Real>(recordIt[4 + d]);
+            flagsArray[nDims * indexParticle + d] = static_cast<int>(recordIt[4 + nDims + d]);
+        }
+    }
+    molecules.assignParticles(std::move(particleArray), std::move(flagsArray), std::move(moleculeTypeArray),
+                              std::move(diameterArray), std::move(bondsArray), std::move(bondsIndex));
+}
+
+/*******************************************************************************
+ * This function returns the rank whose slab contains the cell layer of the
+ * current position of a local particle.
+ ******************************************************************************/
+int MonteCarlo::getDomainOwnerI(const int& indexParticle) const
+{
+    const int numCell {m_systemNeighbors.getNumCell()};
+    const int layerX {m_systemNeighbors.getCellI(m_systemMolecules.getPosItBeginI(indexParticle)) / (numCell * numCell)};
+    return m_systemDomain.getOwnerLayer(layerX, numCell);
+}
+
+/*******************************************************************************
+ * This function recomputes the system's energy. With a domain decomposition
+ * each rank sums the energies of the particles of its slab, half of their pair
+ * and bond energies with the local particles, and the ranks add their sums.
+ ******************************************************************************/
+double MonteCarlo::systemEnergy() const
+{
+    if (!m_domainDecomposition)
+    {
+        return m_systemMolecules.energySystemMolecule(m_systemNeighbors);
+    }
+    const double energyRank {m_systemMolecules.reduceParticles([&](const int& indexParticle)
+    {
+        if (!m_domainOwnedFlagArray[indexParticle])
+        {
+            return 0.;
+        }
+        const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+        const int& lenNeigh { m_systemNeighbors.getLenIndexBegin(indexParticle)};
+        return m_systemMolecules.energyParticleMolecule(indexParticle, neighItBegin, lenNeigh) / 2.;
+    })};
+    return m_systemDomain.sumAll(energyRank);
+}
+
+/*******************************************************************************
+ * This function recomputes the virial sum_{i<j} r_ij . F_ij of the system, as
+ * systemEnergy.
+ ******************************************************************************/
+double MonteCarlo::systemVirial() const
+{
+    if (!m_domainDecomposition)
+    {
+        return m_systemMolecules.virialSystemMolecule(m_systemNeighbors);
+    }
+    const double virialRank {m_systemMolecules.reduceParticles([&](const int& indexParticle)
+    {
+        if (!m_domainOwnedFlagArray[indexParticle])
+        {
+            return 0.;
+        }
+        const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+        const int& lenNeigh { m_systemNeighbors.getLenIndexBegin(indexParticle)};
+        return m_systemMolecules.energyParticleMolecule<true>(indexParticle, neighItBegin, lenNeigh).virial / 2.;
+    })};
+    return m_systemDomain.sumAll(virialRank);
+}
+
+/*******************************************************************************
+ * This function returns the whole configuration on the root rank: with a
+ * domain decomposition the particles of the slabs are gathered with their
+ * bonds and sorted by global index, and the other ranks get no particles.
+ * Without domain decomposition it is a copy of the configuration.
+ ******************************************************************************/
+Molecules MonteCarlo::gatherMolecules() const
+{
+    Molecules wholeMolecules {m_systemMolecules};
+
+    if (!m_domainDecomposition)
+    {
+        return wholeMolecules;
+    }
+    std::vector<double> ownedRecordArray {};
+
+    for (const int& indexParticle : m_domainOwnedArray)
+    {
+        packDomainParticle(indexParticle, ownedRecordArray);
+    }
+    std::vector<double> globalRecordArray {};
+    m_systemDomain.gatherRoot(ownedRecordArray, globalRecordArray);
+
+    std::vector<int> offsetArray {getDomainRecordOffsets(globalRecordArray)};
+    std::sort(offsetArray.begin(), offsetArray.end(), [&globalRecordArray](const int& a, const int& b)
+    {
+        return globalRecordArray[a] < globalRecordArray[b];
+    });
+    // All the particles are gathered: the global indices are the new indices.
+    std::vector<int> bondsArray {};
+    std::vector<int> bondsIndex {0};
+
+    for (const int& offset : offsetArray)
+    {
+        const auto bondsItBegin {globalRecordArray.begin() + offset + m_lenDomainRecord};
+        bondsArray.insert(bondsArray.end(), bondsItBegin,
+                          bondsItBegin + static_cast<int>(globalRecordArray[offset + m_lenDomainRecord - 1]));
+        bondsIndex.push_back(static_cast<int>(bondsArray.size()));
+    }
+    unpackDomainParticles(globalRecordArray, offsetArray, std::move(bondsArray), std::move(bondsIndex),
+                          wholeMolecules);
+    return wholeMolecules;
+}
+
+/*******************************************************************************
+ * This function saves the configuration in path from the root rank. With a
+ * domain decomposition every rank must call it, see gatherMolecules.
+ ******************************************************************************/
+void MonteCarlo::saveInXYZ(const std::string& path) const
+{
+    if (!m_domainDecomposition)
+    {
+        if (m_systemDomain.isRoot())
+        {
+            m_systemMolecules.saveInXYZ(path);
+        }
+        return;
+    }
+    const Molecules wholeMolecules {gatherMolecules()};
+
+    if (m_systemDomain.isRoot())
+    {
+        wholeMolecules.saveInXYZ(path);
+    }
+}
+
+/*******************************************************************************
+ * This function calculates the energies of the trial positions of a particle
+ * (structure of arrays, see Molecules::energyTrialBatch) with its neighbor row
+ * in one pass, then adds the bond energies.
+ ******************************************************************************/
+void MonteCarlo::translationTrialEnergies(const int& indexParticle, const std::vector<Real>& trialArray,
+                                          std::vector<double>& trialEnergyArray) const
+{
+    constexpr int nDims {3};
+    const int nTrials {static_cast<int>(trialEnergyArray.size())};
+    const auto neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+    const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexParticle)};
+
+    m_systemMolecules.energyTrialBatch(indexParticle, trialArray.data(), nTrials, neighItBegin, neighItBegin + lenNeigh,
+                                       trialEnergyArray.data());
+
+    for (int k = 0; k < nTrials; k++)
+    {
+        const std::array<Real, nDims> trial {trialArray[k], trialArray[nTrials + k], trialArray[2 * nTrials + k]};
+        trialEnergyArray[k] += m_systemMolecules.bondEnergyI(indexParticle, trial.begin());
+    }
+}
+
+/*******************************************************************************
+ * This function returns a tentative new particle position.
+ *
+ * @param indexTranslation Translated particle's index.
+ *        randomVector Random vector of size 3. The components of the vector are
+ *                     taken from a uniform distribution U(-m_rBox, m_rBox).
+ * @return Tentative new particle position.
+ ******************************************************************************/
+void MonteCarlo::mcTranslation()
+{
+    mcTranslationI(Random::intGenerator(0, m_nParticles - 1)); // randomly chosen particle
+}
+
+/*******************************************************************************
+ * This function implements the translation of indexTranslation, see
+ * mcTranslation.
+ ******************************************************************************/
+void MonteCarlo::mcTranslationI(const int& indexTranslation)
+{
+    const std::vector<double>& randomVector(Random::vectorDoubleGenerator(3, -m_rBox, m_rBox));
+    const std::vector<Real>& positionTranslation { vectorTranslation(indexTranslation, randomVector.begin()) };
+
+    const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexTranslation) };
+    const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexTranslation)};
+
+    // The virial difference comes from the same neighbor pass when m_calculatePressure is set to True.
+    double diffVirial {};
+    const double diff_energy {energyVirialDiff([&](auto withVirial)
+    {
+        constexpr bool WithVirial {decltype(withVirial)::value};
+        return m_systemMolecules.energyParticleMolecule<WithVirial>(indexTranslation, positionTranslation.begin(),
+                                                                    neighItBegin, lenNeigh)
+               - m_systemMolecules.energyParticleMolecule<WithVirial>(indexTranslation, neighItBegin, lenNeigh);
+    }, diffVirial)};
+
+    // Metropolis criterion
+    const bool acceptMove{ metropolis(diff_energy) };
+
+    // If the move is accepted, then the energy, the virial, the position array and the displacement array can be
+    // updated.
+    if (acceptMove)
+    {
+        generalUpdate(diff_energy, diffVirial);
+        countAccepted<move::Translation>(); // increment of the acceptance rate.
+
+        m_systemNeighbors.updateInterDisplacement(indexTranslation, randomVector.begin());
+        m_systemMolecules.updateTypeEnergyTranslation(indexTranslation, positionTranslation.begin(),
+                                                      neighItBegin, lenNeigh);
+        m_systemMolecules.updatePositionI(indexTranslation, positionTranslation.begin());
+    }
+}
+
+/*******************************************************************************
+ * This function returns a tentative new particle position.
+ *
+ * @param indexTranslation Translated particle's index.
+ *        randomVector Random vector of size 3. The components of the vector are
+ *                     taken from a uniform distribution U(-m_rBox, m_rBox).
+ * @return Tentative new particle position.
+ ******************************************************************************/
+
+void MonteCarlo::mcSwap()
+{
+    double pSwapType { Random::doubleGenerator(0, 1) };
+    int swapType {1};
+    // The molecule of a random particle: molecules are chosen proportionally to their length.
+    const int indexMolecule { m_systemMolecules.getParticleMoleculeI(Random::intGenerator(0, m_nParticles - 1)) };
+    const std::vector<int> orderVector { m_systemMolecules.getOrderVector(indexMolecule) };
+    // double cosAngle { m_systemMolecules.getCosAngleMolecule(orderVector) };
+
+    if (orderVector.size() < 2)
+    {
+        return;
+    }
+
+    // Particles are ranked by type: swap12 exchanges the ranks 0 and 1, swap13 the ranks 0 and 2 and swap23 the
+    // ranks 1 and 2. Molecules of two particles can only do swap12.
+    int rankSwap1 {0};
+    int rankSwap2 {1};
+
+    if (orderVector.size() > 2)
+    {
+        if (pSwapType >= m_pSwap12 && pSwapType < (m_pSwap12 + m_pSwap13))
+        {
+            swapType = 2;
+            rankSwap2 = 2;
+        }
+        else if (pSwapType >= (m_pSwap12 + m_pSwap13))
+        {
+            swapType = 3;
+            rankSwap1 = 1;
+            rankSwap2 = 2;
+        }
+    }
+    const int indexSwap1 {orderVector[rankSwap1]};
+    const int indexSwap2 {orderVector[rankSwap2]};
+    /***
+    if (cosAngle < - 0.3)
+    {
+
+        indexSwap1 += orderVector[0];
+        indexSwap2 += orderVector[2];
+    }
+a
+    else
+    {
+        indexSwap1 += Random::intGenerator(0, 2);
+        indexSwap2 += Random::intGenerator(0, 2);
+
+        while (indexSwap1 == indexSwap2)
+        {
+            indexSwap2 = indexMolecule;
+            indexSwap2 += Random::intGenerator(0, 2);
+        }mv t
+    }
+    ***/
+    if (swapTypesIJ(indexSwap1, indexSwap2, 0.))
+    {
+        switch (swapType)
+        {
+            case 1:
+                m_acceptanceRateSwap12 += 1. / m_nParticles;
+                break;
+            case 2:
+                m_acceptanceRateSwap13 += 1. / m_nParticles;
+                break;
+            case 3:
+                m_acceptanceRateSwap23 += 1. / m_nParticles;
+                break;
+            default:
+                break;
+        }
+    }
+    /***
+    switch (swapType)
+    {
+        case 1:
+            saveDoubleIntTXT(cosAngle, acceptMove, "./thetatau12.txt");
+            break;
+        case 2:
+            saveDoubleIntTXT(cosAngle, acceptMove, "./thetatau13.txt");
+            break;
+        case 3:
+            saveDoubleIntTXT(cosAngle, acceptMove, "./thetatau23.txt");
+            break;
+        default:
+            break;
+    }
+    ***/
+
+}
+
+
+/*******************************************************************************
+ * This function exchanges the types of two particles with the Metropolis
+ * criterion. The energy and the virial differences come from the type-resolved
+ * cache when it is enabled. lnSelectionRatio is the log of the ratio of the
+ * reverse and forward selection probabilities of the pair (0 for a symmetric
+ * selection).
+ *
+ * @return True if the swap was accepted.
+ ******************************************************************************/
+bool MonteCarlo::swapTypesIJ(const int& indexSwap1, const int& indexSwap2, const double& lnSelectionRatio)
+{
+    const auto& neighItBegin1 { m_systemNeighbors.getNeighItBeginI(indexSwap1) };
+    const int& lenNeigh1 {m_systemNeighbors.getLenIndexBegin(indexSwap1)};
+    const auto& neighItBegin2 { m_systemNeighbors.getNeighItBeginI(indexSwap2) };
+    const int& lenNeigh2 {m_systemNeighbors.getLenIndexBegin(indexSwap2)};
+
+    const auto diffEnergySwap {[&](auto withVirial)
+    {
+        constexpr bool WithVirial {decltype(withVirial)::value};
+        return m_systemMolecules.energyParticleMoleculeSwap<WithVirial>(indexSwap1, neighItBegin1, lenNeigh1,
+                                                                        indexSwap2)
+               + m_systemMolecules.energyParticleMoleculeSwap<WithVirial>(indexSwap2, neighItBegin2, lenNeigh2,
+                                                                          indexSwap1);
+    }};
+    double diffEnergy {};
+    double diffVirial {};
+
+    if (m_systemMolecules.hasTypeEnergy())
+    {
+        diffEnergy = m_systemMolecules.energySwapTypeEnergy(indexSwap1, indexSwap2);
+    }
+    else
+    {
+        diffEnergy = energyVirialDiff(diffEnergySwap, diffVirial);
+    }
+    // Metropolis criterion
+    const bool acceptMove { metropolis( diffEnergy - m_temp * lnSelectionRatio) };
+
+    // If the move is accepted, then the energy, the virial and the types can be updated.
+    if ( acceptMove )
+    {
+        if (m_calculatePressure && m_systemMolecules.hasTypeEnergy())
+        {
+            // The cache only holds energies: the virial difference is computed for the accepted moves only.
+            diffVirial = diffEnergySwap(std::true_type {}).virial;
+        }
+        generalUpdate( diffEnergy, diffVirial );
+        countAccepted<move::Swap>();
+        const int typeSwap1 {m_systemMolecules.getParticleTypeI(indexSwap1)};
+        const int typeSwap2 {m_systemMolecules.getParticleTypeI(indexSwap2)};
+        m_systemMolecules.updateTypeEnergySwap(indexSwap1, typeSwap2, neighItBegin1, lenNeigh1);
+        m_systemMolecules.updateTypeEnergySwap(indexSwap2, typeSwap1, neighItBegin2, lenNeigh2);
+        m_systemMolecules.swapParticleTypesIJ(indexSwap1, indexSwap2);
+    }
+    return acceptMove;
+}
+
+/*******************************************************************************
+ * This function implements a swap between two particles of different types
+ * that need not belong to the same molecule.
+ * - global: a random particle i, then a random other type present in the
+ *   system, then a random particle j of that type from the type buckets. The
+ *   type counts do not change with a swap, so the selection is symmetric.
+ * - neighbor: a random particle i, then a random neighbor j of another type.
+ *   The number of such neighbors changes with the swap, so the acceptance gets
+ *   the ratio of the selection probabilities (1/m_i' + 1/m_j') / (1/m_i + 1/m_j).
+ ******************************************************************************/
+void MonteCarlo::mcNonLocalSwap()
+{
+    const int indexSwap1 {Random::intGenerator(0, m_nParticles - 1)};
+    const int typeSwap1 {m_systemMolecules.getParticleTypeI(indexSwap1)};
+
+    if (m_swapMode == SwapMode::global)
+    {
+        const int nParticleTypes {m_systemMolecules.getNParticleTypes()};
+        int nOtherTypes {0};
+
+        for (int type = 1; type <= nParticleTypes; type++)
+        {
+            nOtherTypes += (type != typeSwap1 && m_systemMolecules.getTypeBucketSize(type) > 0) ? 1 : 0;
+        }
+
+        if (nOtherTypes == 0)
+        {
+            return;
+        }
+
+        int rankType {Random::intGenerator(0, nOtherTypes - 1)};
+        int typeSwap2 {0};
+
+        while (rankType >= 0)
+        {
+            ++typeSwap2;
+            rankType -= (typeSwap2 != typeSwap1 && m_systemMolecules.getTypeBucketSize(typeSwap2) > 0) ? 1 : 0;
+        }
+        const int indexSwap2 {m_systemMolecules.getTypeBucketParticle(
+                typeSwap2, Random::intGenerator(0, m_systemMolecules.getTypeBucketSize(typeSwap2) - 1))};
+        swapTypesIJ(indexSwap1, indexSwap2, 0.);
+        return;
+    }
+
+    // Neighbor mode. The neighbor list is symmetric and does not change with a swap.
+    const auto neighItBegin1 { m_systemNeighbors.getNeighItBeginI(indexSwap1) };
+    const int& lenNeigh1 {m_systemNeighbors.getLenIndexBegin(indexSwap1)};
+    const auto isOtherType {[&](const int& j) { return m_systemMolecules.getParticleTypeI(j) != typeSwap1; }};
+    const int nCandidates1 {static_cast<int>(std::count_if(neighItBegin1, neighItBegin1 + lenNeigh1, isOtherType))};
+
+    if (nCandidates1 == 0)
+    {
+        return;
+    }
+
+    int rankCandidate {Random::intGenerator(0, nCandidates1 - 1)};
+    auto candidateIt {neighItBegin1};
+
+    for (; rankCandidate > 0 || !isOtherType(*candidateIt); ++candidateIt)
+    {
+        rankCandidate -= isOtherType(*candidateIt) ? 1 : 0;
+    }
+    const int indexSwap2 {*candidateIt};
+    const int typeSwap2 {m_systemMolecules.getParticleTypeI(indexSwap2)};
+
+    // Neighbors of indexParticle of another type than typeParticle, the partner having the type typePartner.
+    const auto countCandidates {[&](const int& indexParticle, const int& indexPartner, const int& typeParticle,
+                                    const int& typePartner)
+    {
+        const auto neighItBegin {m_systemNeighbors.getNeighItBeginI(indexParticle)};
+        const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexParticle)};
+        int nCandidates {typePartner != typeParticle ? 1 : 0};
+
+        for (auto it = neighItBegin; it < neighItBegin + lenNeigh; ++it)
+        {
+            nCandidates += (*it != indexPartner && m_systemMolecules.getParticleTypeI(*it) != typeParticle) ? 1 : 0;
+        }
+        return nCandidates;
+    }};
+    const int nCandidates2 {countCandidates(indexSwap2, indexSwap1, typeSwap2, typeSwap1)};
+    const int nCandidatesNew1 {countCandidates(indexSwap1, indexSwap2, typeSwap2, typeSwap1)};
+    const int nCandidatesNew2 {countCandidates(indexSwap2, indexSwap1, typeSwap1, typeSwap2)};
+    const double forwardSelection {1. / nCandidates1 + 1. / nCandidates2};
+    const double reverseSelection {1. / nCandidatesNew1 + 1. / nCandidatesNew2};
+    swapTypesIJ(indexSwap1, indexSwap2, std::log(reverseSelection / forwardSelection));
+}
+
+/*******************************************************************************
+ * This function implements the swap of continuous polydispersity: exchange of
+ * the diameters of two random particles anywhere in the box. The types, and so
+ * the bonds, are unchanged. sigma_ij is symmetric, so the pair of the two
+ * swapped particles keeps its energy.
+ ******************************************************************************/
+void MonteCarlo::mcDiameterSwap()
+{
+    const int indexSwap1 {Random::intGenerator(0, m_nParticles - 1)};
+    int indexSwap2 {Random::intGenerator(0, m_nParticles - 2)};
+    indexSwap2 += (indexSwap2 >= indexSwap1) ? 1 : 0; // Uniform among the other particles.
+
+    const auto& neighItBegin1 { m_systemNeighbors.getNeighItBeginI(indexSwap1) };
+    const int& lenNeigh1 {m_systemNeighbors.getLenIndexBegin(indexSwap1)};
+    const auto& neighItBegin2 { m_systemNeighbors.getNeighItBeginI(indexSwap2) };
+    const int& lenNeigh2 {m_systemNeighbors.getLenIndexBegin(indexSwap2)};
+
+    double diffVirial {};
+    const double diffEnergy {energyVirialDiff([&](auto withVirial)
+    {
+        constexpr bool WithVirial {decltype(withVirial)::value};
+        return m_systemMolecules.energyParticleMoleculeSwap<WithVirial>(indexSwap1, neighItBegin1, lenNeigh1,
+                                                                        indexSwap2)
+               + m_systemMolecules.energyParticleMoleculeSwap<WithVirial>(indexSwap2, neighItBegin2, lenNeigh2,
+                                                                          indexSwap1);
+    }, diffVirial)};
+
+    if (metropolis(diffEnergy))
+    {
+        generalUpdate(diffEnergy, diffVirial);
+        countAccepted<move::Swap>();
+        m_systemMolecules.swapParticleDiametersIJ(indexSwap1, indexSwap2);
+    }
+}
+
+/*******************************************************************************
+ * This function implements a semi-grand canonical mutation: a random particle
+ * takes a random other type at fixed chemical potential differences. The
+ * Metropolis criterion is applied to dU - (mu_new - mu_old). The energy
+ * difference comes from the type-resolved cache when it is enabled.
+ ******************************************************************************/
+void MonteCarlo::mcMutation()
+{
+    const int nParticleTypes {m_systemMolecules.getNParticleTypes()};
+
+    if (nParticleTypes < 2)
+    {
+        return;
+    }
+
+    const int indexParticle {Random::intGenerator(0, m_nParticles - 1)};
+    const int oldType {m_systemMolecules.getParticleTypeI(indexParticle)};
+    int newType {Random::intGenerator(1, nParticleTypes - 1)};
+    newType += (newType >= oldType) ? 1 : 0; // Uniform among the other types.
+
+    const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+    const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexParticle)};
+
+    const auto diffEnergyMutation {[&](auto withVirial)
+    {
+        constexpr bool WithVirial {decltype(withVirial)::value};
+        return m_systemMolecules.energyParticleMoleculeMutation<WithVirial>(indexParticle, neighItBegin, lenNeigh,
+                                                                            newType);
+    }};
+    double diffEnergy {};
+    double diffVirial {};
+
+    if (m_systemMolecules.hasTypeEnergy())
+    {
+        diffEnergy = m_systemMolecules.energyMutationTypeEnergy(indexParticle, newType);
+    }
+    else
+    {
+        diffEnergy = energyVirialDiff(diffEnergyMutation, diffVirial);
+    }
+    const double deltaMu {m_deltaMuArray[(oldType - 1) * nParticleTypes + newType - 1]};
+
+    if (metropolis(diffEnergy - deltaMu))
+    {
+        if (m_calculatePressure && m_systemMolecules.hasTypeEnergy())
+        {
+            diffVirial = diffEnergyMutation(std::true_type {}).virial;
+        }
+        generalUpdate(diffEnergy, diffVirial);
+        countAccepted<move::Mutation>();
+        m_systemMolecules.updateTypeEnergySwap(indexParticle, newType, neighItBegin, lenNeigh);
+        m_systemMolecules.setParticleTypeI(indexParticle, newType);
+        --m_typeCountArray[oldType - 1];
+        ++m_typeCountArray[newType - 1];
+    }
+}
+
+/*******************************************************************************
+ * This function implements a Hybrid Monte Carlo move: all the particles get
+ * Maxwell-Boltzmann momenta (unit mass), are integrated with velocity Verlet
+ * for m_hybridSteps steps of m_hybridTimeStep, and the trajectory is accepted
+ * with the Metropolis criterion on the change of the total Hamiltonian. The
+ * neighbor list is kept valid along the trajectory by the usual displacement
+ * check. A rejected trajectory restores the positions, the image counters and
+ * the displacements of the neighbor list.
+ ******************************************************************************/
+void MonteCarlo::mcHybrid()
+{
+    const int nDims {m_systemMolecules.getNDims()};
+    const auto kineticEnergy {[&]()
+    {
+        return std::inner_product(m_momentumArray.begin(), m_momentumArray.end(), m_momentumArray.begin(), 0.) / 2.;
+    }};
+
+    m_hybridParticleArray = m_systemMolecules.getParticleRecordArray();
+    m_hybridFlagsArray = m_systemMolecules.getFlagsArray();
+    m_momentumArray = Random::normalVectorGenerator(nDims * m_nParticles, std::sqrt(m_temp));
+
+    const double oldKineticEnergy {kineticEnergy()};
+    const auto [oldEnergy, newEnergy] {hybridTrajectory(m_momentumArray)};
+    const double oldHamiltonian {oldEnergy + oldKineticEnergy};
+
+    if (metropolis(newEnergy + kineticEnergy() - oldHamiltonian))
+    {
+        m_energy = newEnergy;
+        m_energyCompensation = 0.;
+        countAccepted<move::Hybrid>();
+
+        if (m_calculatePressure)
+        {
+            m_virial = m_systemMolecules.virialSystemMolecule(m_systemNeighbors);
+        }
+    }
+    else
+    {
+        m_systemMolecules.restoreParticles(m_hybridParticleArray, m_hybridFlagsArray);
+        std::transform(m_hybridDisplacementArray.begin(), m_hybridDisplacementArray.end(),
+                       m_hybridDisplacementArray.begin(), std::negate<>());
+
+        for (int indexParticle = 0; indexParticle < m_nParticles; indexParticle++)
+        {
+            m_systemNeighbors.updateInterDisplacement(indexParticle,
+                                                      m_hybridDisplacementArray.begin() + nDims * indexParticle);
+        }
+        checkNeighbors();
+    }
+
+    if (m_systemMolecules.hasTypeEnergy())
+    {
+        m_systemMolecules.initializeTypeEnergy(m_systemNeighbors);
+    }
+}
+
+/*******************************************************************************
+ * This function integrates m_hybridSteps velocity Verlet steps of
+ * m_hybridTimeStep from the momenta momentumArray, which holds the final
+ * momenta on return. The displacements are accumulated in
+ * m_hybridDisplacementArray.
+ *
+ * @return Potential energies at the start and at the end of the trajectory.
+ ******************************************************************************/
+std::array<double, 2> MonteCarlo::hybridTrajectory(std::vector<double>& momentumArray)
+{
+    const int nDims {m_systemMolecules.getNDims()};
+    const auto momentumHalfStep {[&]()
+    {
+        for (int k = 0; k < nDims * m_nParticles; k++)
+        {
+            momentumArray[k] += 0.5 * m_hybridTimeStep * m_forceArray[k];
+        }
+    }};
+
+    m_hybridDisplacementArray.assign(nDims * m_nParticles, 0.);
+    const double oldEnergy {m_systemMolecules.forceSystemMolecule(m_systemNeighbors, m_forceArray)};
+    double newEnergy {};
+
+    for (int step = 0; step < m_hybridSteps; step++)
+    {
+        momentumHalfStep();
+        hybridPositionStep(momentumArray);
+        newEnergy = m_systemMolecules.forceSystemMolecule(m_systemNeighbors, m_forceArray);
+        momentumHalfStep();
+    }
+    return {oldEnergy, newEnergy};
+}
+
+/*******************************************************************************
+ * This function moves all the particles by one time step of the momenta and
+ * rebuilds the neighbor list if a particle moved beyond the skin.
+ ******************************************************************************/
+void MonteCarlo::hybridPositionStep(const std::vector<double>& momentumArray)
+{
+    const int nDims {m_systemMolecules.getNDims()};
+    std::vector<double> displacement (nDims);
+    std::vector<Real> newPosition (nDims);
+
+    for (int indexParticle = 0; indexParticle < m_nParticles; indexParticle++)
+    {
+        const auto& posItBegin {m_systemMolecules.getPosItBeginI(indexParticle)};
+
+        for (int d = 0; d < nDims; d++)
+        {
+            displacement[d] = m_hybridTimeStep * momentumArray[nDims * indexParticle + d];
+            newPosition[d] = static_cast<Real>(posItBegin[d] + displacement[d]);
+            m_hybridDisplacementArray[nDims * indexParticle + d] += displacement[d];
+        }
+        m_systemMolecules.periodicBC(newPosition.begin());
+        m_systemNeighbors.updateInterDisplacement(indexParticle, displacement.begin());
+        m_systemMolecules.updatePositionI(indexParticle, newPosition.begin());
+    }
+    checkNeighbors();
+}
+
+/*******************************************************************************
+ * This function samples the excess chemical potential of each particle type
+ * by Widom test-particle insertions: m_widomInsertions ghost positions drawn
+ * from m_widomGenerator, each tried with every type (see widomEnergies),
+ * accumulate exp(-dU/T). The system is not modified.
+ ******************************************************************************/
+void MonteCarlo::widomSampling()
+{
+    constexpr int nDims {3};
+    const int nParticleTypes {static_cast<int>(m_widomSumArray.size())};
+    std::uniform_real_distribution<double> positionDistribution {0., m_systemMolecules.getLengthCube()};
+    std::vector<Real> positionArray (nDims * m_widomInsertions);
+
+    for (auto& position : positionArray)
+    {
+        position = static_cast<Real>(positionDistribution(m_widomGenerator));
+    }
+    std::vector<double> energyArray {};
+    widomEnergies(positionArray, energyArray);
+
+    for (int type = 1; type <= nParticleTypes; type++)
+    {
+        for (int k = 0; k < m_widomInsertions; k++)
+        {
+            m_widomSumArray[type - 1] += std::exp(-energyArray[(type - 1) * m_widomInsertions + k] / m_temp);
+        }
+    }
+    m_nWidomInsertions += m_widomInsertions;
+}
+
+/*******************************************************************************
+ * This function computes the energies of ghost particles of each type at the
+ * positions positionArray (x, y, z of each ghost, inside the box). The ghosts
+ * are sorted by cell of the neighbor grid, then the ghosts of one cell are
+ * evaluated as one batch (see Molecules::energyTrialBatch) against the
+ * particles of the 27 surrounding cells, which hold every particle within the
+ * cut-off while the neighbor list is valid. The ghosts are unbonded and have
+ * the unit diameter in polydisperse mode.
+ *
+ * @param energyArray Energy of the ghost k of type at (type - 1) * nGhosts + k.
+ ******************************************************************************/
+void MonteCarlo::widomEnergies(const std::vector<Real>& positionArray, std::vector<double>& energyArray) const
+{
+    constexpr int nDims {3};
+    const int nParticleTypes {m_systemMolecules.getNParticleTypes()};
+    const int nInsertions {static_cast<int>(positionArray.size()) / nDims};
+    const int nCells {m_systemNeighbors.getNCells()};
+
+    // Counting sort of the ghosts by cell. The ghosts of a cell are stored as a structure of arrays.
+    std::vector<int> ghostCellArray (nInsertions);
+    std::vector<int> cellIndex (nCells + 1, 0);
+
+    for (int k = 0; k < nInsertions; k++)
+    {
+        ghostCellArray[k] = m_systemNeighbors.getCellI(positionArray.begin() + nDims * k);
+        ++cellIndex[ghostCellArray[k] + 1];
+    }
+    std::partial_sum(cellIndex.begin(), cellIndex.end(), cellIndex.begin());
+
+    std::vector<Real> trialArray (nDims * nInsertions);
+    std::vector<int> sortedGhostArray (nInsertions);
+    std::vector<int> fillArray (cellIndex.begin(), cellIndex.end() - 1);
+
+    for (int k = 0; k < nInsertions; k++)
+    {
+        const int& indexCell {ghostCellArray[k]};
+        const int nGhosts {cellIndex[indexCell + 1] - cellIndex[indexCell]};
+        const int slot {fillArray[indexCell]++ - cellIndex[indexCell]};
+        sortedGhostArray[cellIndex[indexCell] + slot] = k;
+
+        for (int d = 0; d < nDims; d++)
+        {
+            trialArray[nDims * cellIndex[indexCell] + d * nGhosts + slot] = positionArray[nDims * k + d];
+        }
+    }
+
+    std::vector<int> cellArray {};
+    std::vector<int> candidateArray {};
+    std::vector<double> cellEnergyArray (nInsertions);
+    energyArray.assign(nParticleTypes * nInsertions, 0.);
+
+    for (int indexCell = 0; indexCell < nCells; indexCell++)
+    {
+        const int nGhosts {cellIndex[indexCell + 1] - cellIndex[indexCell]};
+
+        if (nGhosts == 0)
+        {
+            continue;
+        }
+        cellArray.clear();
+        candidateArray.clear();
+        m_systemNeighbors.appendCellNeighborhood(indexCell, cellArray);
+
+        for (const int& indexNeighborCell : cellArray)
+        {
+            candidateArray.insert(candidateArray.end(), m_systemNeighbors.getCellItBeginI(indexNeighborCell),
+                                  m_systemNeighbors.getCellItEndI(indexNeighborCell));
+        }
+
+        for (int type = 1; type <= nParticleTypes; type++)
+        {
+            m_systemMolecules.energyTrialBatch(type, Real{1}, trialArray.data() + nDims * cellIndex[indexCell],
+                                               nGhosts, candidateArray.begin(), candidateArray.end(),
+                                               cellEnergyArray.data());
+
+            for (int k = 0; k < nGhosts; k++)
+            {
+                energyArray[(type - 1) * nInsertions + sortedGhostArray[cellIndex[indexCell] + k]]
+                        = cellEnergyArray[k];
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * This function prints and saves, for each particle type, the Widom average
+ * <exp(-dU/T)> and the excess chemical potential mu_ex = -T ln <exp(-dU/T)>:
+ * one line "type average mu_ex" per type.
+ ******************************************************************************/
+void MonteCarlo::saveWidom(const std::string& path) const
+{
+    for (int type = 1; type <= static_cast<int>(m_widomSumArray.size()); type++)
+    {
+        const double average {(m_nWidomInsertions > 0) ? m_widomSumArray[type - 1] / m_nWidomInsertions : 0.};
+        const double excessChemicalPotential {-m_temp * std::log(average)};
+        std::cout << "Excess chemical potential of type " << type << ": " << excessChemicalPotential << "\n";
+        saveVectorTXT({static_cast<double>(type), average, excessChemicalPotential}, path);
+    }
+}
+
+/*******************************************************************************
+ * This function minimizes a copy of the system and of its neighbor list (see
+ * Minimizer) and appends the energy per particle of the inherent structure and
+ * the time step to path. The coordinates are saved in pathXYZ when
+ * m_saveQuenchXYZ is set. The simulated system is not modified.
+ ******************************************************************************/
+void MonteCarlo::saveInherentStructure(const int& timeStep, const std::string& path,
+                                       const std::string& pathXYZ) const
+{
+    Molecules inherentMolecules {m_systemMolecules};
+    Neighbors inherentNeighbors {m_systemNeighbors};
+    const double inherentEnergy {m_systemMinimizer.minimize(inherentMolecules, inherentNeighbors)};
+    saveDoubleIntTXT(inherentEnergy / m_nParticles, timeStep, path);
+
+    if (m_saveQuenchXYZ)
+    {
+        inherentMolecules.saveInXYZ(pathXYZ);
+    }
+}
+
+/*******************************************************************************
+ * This function appends the energy per particle to the energy file. With the
+ * type mutations, the number of particles of each type follows on the line.
+ ******************************************************************************/
+void MonteCarlo::saveEnergy(const std::string& path) const
+{
+    if (!m_mutation)
+    {
+        saveDoubleTXT(m_energy / m_nParticles, path);
+        return;
+    }
+    std::vector<double> energyLine {m_energy / m_nParticles};
+    energyLine.insert(energyLine.end(), m_typeCountArray.begin(), m_typeCountArray.end());
+    saveVectorTXT(energyLine, path);
+}
+
+/*******************************************************************************
+ * This function saves the composition histogram of the type mutations: one
+ * line per number of particles n reached by a type, then for each type the
+ * fraction of the time steps spent with n particles of that type.
+ ******************************************************************************/
+void MonteCarlo::saveCompositionHistogram(const std::string& path) const
+{
+    const int nParticleTypes {static_cast<int>(m_typeCountArray.size())};
+
+    for (int n = 0; n <= m_nParticles; n++)
+    {
+        std::vector<double> histogramLine {static_cast<double>(n)};
+        bool reached {false};
+
+        for (int type = 0; type < nParticleTypes; type++)
+        {
+            const long long count {m_compositionHistogramArray[type * (m_nParticles + 1) + n]};
+            histogramLine.push_back(static_cast<double>(count) / m_timeSteps);
+            reached = reached || count > 0;
+        }
+
+        if (reached)
+        {
+            saveVectorTXT(histogramLine, path);
+        }
+    }
+}
+
+void MonteCarlo::generalUpdate(double diffEnergy, double diffVirial)
+{
+    // Kahan summation: the low-order bits lost when adding diffEnergy are carried to the next update.
+    const double correctedDiff {diffEnergy - m_energyCompensation};
+    const double newEnergy {m_energy + correctedDiff};
+    m_energyCompensation = (newEnergy - m_energy) - correctedDiff;
+    m_energy = newEnergy;
+    m_virial += diffVirial; // Resynchronized by the periodic recomputes.
+}
+
+/*******************************************************************************
+ * This function returns the virial pressure of the current configuration,
+ * from the running virial.
+ ******************************************************************************/
+double MonteCarlo::pressure() const
+{
+    const double lengthCube {m_systemMolecules.getLengthCube()};
+    return pressureVirial(m_temp, m_nParticles, lengthCube * lengthCube * lengthCube, m_virial);
+}
+
+/*******************************************************************************
+ * This function recomputes the system's energy from scratch and compares it to
+ * the running energy. The drift per particle is appended to ./outDrift.txt and
+ * the running energy is resynchronized. The run stops if the drift exceeds
+ * m_energyDriftTolerance, which means that an energy difference is wrong.
+ *
+ * @param timeStep Current time step, saved with the drift.
+ ******************************************************************************/
+void MonteCarlo::checkEnergyDrift(const int& timeStep)
+{
+    const double realEnergy {systemEnergy()};
+    const double drift {(m_energy - realEnergy) / m_nParticles};
+
+    if (m_systemDomain.isRoot())
+    {
+        saveDoubleIntTXT(drift, timeStep, "./outDrift.txt");
+    }
+
+    if (m_saveParticleEnergy && m_systemDomain.isRoot())
+    {
+        saveVectorTXT(m_systemMolecules.energyParticleArray(m_systemNeighbors), "./outParticleE.txt");
+    }
+
+    if (!(std::abs(drift) <= m_energyDriftTolerance))
+    {
+        std::cerr << "Energy drift per particle " << drift << " at time step " << timeStep
+                  << " exceeds energyDriftTolerance=" << m_energyDriftTolerance << "\n";
+        std::abort();
+    }
+    m_energy = realEnergy;
+    m_energyCompensation = 0.;
+
+    if (m_calculatePressure)
+    {
+        m_virial = systemVirial();
+    }
 }
 
 
@@ -12,45 +12,153 @@
 #include <iterator>
 #include <fstream>
 #include <vector>
-#include "pressure.h"
+#include <array>
+#include <type_traits>
+#include <atomic>
+#include <random>
+#include "Random_mt.h"
 #include "INPUT/Parameter.h"
 #include "util.h"
 #include "MOLECULES/Molecules.h"
 #include "NEIGHBORS/Neighbors.h"
+#include "DOMAIN/Domain.h"
+#include "MINIMIZER/Minimizer.h"
+#include "MOVES/MoveRegistry.h"
+#include "pressure.h"
 #include <cmath>
 
 
+// Partner selection of the swaps ("swapMode" in inputVar.txt).
+enum class SwapMode
+{
+    molecule,                                                       // Two particles of the same molecule.
+    global,                                                         // Any particle of another type, from the type buckets.
+    neighbor                                                        // A neighbor of another type.
+};
+
+// Efficiency maximized by the move mix tuner ("tuneMetric" in inputVar.txt).
+enum class TuneMetric
+{
+    msd,                                                            // Mean square displacement per second.
+    energy                                                          // Squared energy change between time steps per second.
+};
+
 class MonteCarlo
 {
 
 private:
     Molecules m_systemMolecules;
     Neighbors m_systemNeighbors;
+    const Domain m_systemDomain;
+    const Minimizer m_systemMinimizer;
 	double m_energy {};                                             // System's energy.
-	double m_pressure {};                                           // System's pressure.
+    double m_energyCompensation {};                                 // Kahan compensation of the accepted energy differences.
+    double m_virial {};                                             // Running virial sum_{i<j} r_ij . F_ij.
 	const int m_nParticles {};                                            // System's number of particles.
-    int m_nTrans {0};
-	double m_acceptanceRateTrans { 0. };                                 // Monte Carlo translation acceptance rate.
-    int m_nSwap {0};
-    double m_acceptanceRateSwap { 0. };                                 // Monte Carlo swap acceptance rate.
+    std::vector<MoveRecord> m_moveArray {};                         // Enabled moves, the translation first.
+    AliasTable m_moveTable {};                                      // Samples m_moveArray by weight.
+    std::array<int, std::variant_size_v<Move>> m_moveRecordIndexArray {}; // Record of each Move alternative.
     double m_acceptanceRateSwap12 { 0. };
     double m_acceptanceRateSwap13 { 0. };
     double m_acceptanceRateSwap23 { 0. };
-    int m_nMolTrans {0};
-    double m_acceptanceRateMolTrans { 0. };                                 // Monte Carlo swap acceptance rate.
+    std::vector<ParticleRecord> m_volumeParticleArray {};           // Positions restored by a rejected volume move.
+    std::vector<ParticleRecord> m_hybridParticleArray {};           // Configuration restored by a rejected trajectory.
+    std::vector<int> m_hybridFlagsArray {};
+    std::vector<double> m_forceArray {};                            // Work arrays of the trajectories.
+    std::vector<double> m_momentumArray {};
+    std::vector<double> m_hybridDisplacementArray {};
+    std::vector<int> m_typeCountArray {};                           // Number of particles of each type.
+    // Time steps spent with n particles of type t, at index (t - 1) * (N + 1) + n.
+    std::vector<long long> m_compositionHistogramArray {};
+    std::vector<int> m_regrowthCellArray {};                        // Work arrays of the regrowth trial energies.
+    std::vector<int> m_regrowthCandidateArray {};
     const int m_saveRate {};
+    const int m_energyCheckRate {};                                 // Time steps between full energy recomputes (0: never).
+    const double m_energyDriftTolerance {};                         // Largest energy drift per particle before the run stops.
+    const bool m_saveParticleEnergy {};                             // Saves the particle energies at each energy check.
 	const bool m_calculatePressure {};                               // Boolean that decides if the pressure is calculated or not.
+    const int m_virialCheckRate {};                                 // Time steps between full virial recomputes (0: never).
+    bool m_virialIncremental {};                                    // Every enabled move updates the virial with its energy.
+    const bool m_saveDisplacement {};                               // Saves displacements and MSD from the unwrapped positions.
+    const bool m_quench {};                                         // Minimizes the saved configurations (inherent structures).
+    const int m_widomRate {};                                       // Time steps between Widom samplings (0: never).
+    const int m_widomInsertions {};                                 // Ghost insertions per sampling.
+    std::mt19937 m_widomGenerator {};                               // Own random stream: the Markov chain is unchanged.
+    std::vector<double> m_widomSumArray {};                         // Sum of exp(-dU/T) of the insertions of each type.
+    long long m_nWidomInsertions {0};
+    const bool m_saveQuenchXYZ {};                                  // Also saves the inherent structure coordinates.
+    std::vector<double> m_referencePositionArray {};                // Unwrapped positions at the first time step.
     const bool m_swap{};
-    const double m_pSwap{};
+    double m_pSwap{};                                               // Tuned when tuneSteps > 0.
     const double m_pSwap12 {};
     const double m_pSwap13 {};
     const double m_pSwap23 {};
+    const bool m_swapEnergyCache {};                                // Evaluates swaps from the type-resolved energy cache.
+    const SwapMode m_swapMode {};
 	const std::string m_simulationMol {};                       			// Type of system: can be either "polymer" or "atomic".
     const bool m_molTranslation {};
-    const double m_pMolTranslation {};
-    const double m_rBoxMolTrans {};
+    double m_pMolTranslation {};                                    // Tuned when tuneSteps > 0.
+    double m_rBoxMolTrans {};                                       // Tuned when tuneSteps > 0.
+    const bool m_molRotation {};
+    const double m_pMolRotation {};
+    const double m_maxAngleMolRotation {};
+    const bool m_pivot {};
+    const double m_pPivot {};
+    const double m_maxAnglePivot {};
+    const bool m_crankshaft {};
+    const double m_pCrankshaft {};
+    const double m_maxAngleCrankshaft {};
+    const bool m_regrowth {};
+    const double m_pRegrowth {};
+    const int m_cbmcTrials {};                                      // Trial positions per regrown bead.
+    const int m_cbmcMaxBeads {};                                    // Largest number of beads regrown at once.
+    const double m_cbmcBondRadius {};                               // Radius of the trial ball around the previous bead.
+    const bool m_volumeMove {};                                     // Isothermal-isobaric ensemble.
+    const double m_pVolume {};
+    const double m_pressureTarget {};                               // Imposed pressure of the volume moves.
+    const double m_maxLnVolume {};                                  // Largest change of ln(V) of a volume move.
+    const bool m_hybrid {};                                         // Hybrid Monte Carlo collective moves.
+    const double m_pHybrid {};
+    const int m_hybridSteps {};                                     // Velocity Verlet steps of a trajectory.
+    const double m_hybridTimeStep {};
+    const bool m_mutation {};                                       // Semi-grand canonical type mutations.
+    const double m_pMutation {};
+    const std::vector<double> m_deltaMuArray {};                    // mu_J - mu_I at index (I - 1) * nTypes + J - 1.
+    const int m_tuneSteps {};                                       // Equilibration time steps of the tuner (0: no tuning).
+    const int m_tuneWindow {};                                      // Time steps between two step size updates.
+    const double m_targetAcceptance {};                             // Acceptance rate aimed at by rBox and rBoxMolTranslation.
+    const TuneMetric m_tuneMetric {};
 	const double m_temp {};                                     	// Temperature.
-	const double m_rBox{};                               			// Length of the translation box.
+	double m_rBox{};                               			        // Length of the translation box (tuned when tuneSteps > 0).
+    const int m_mtmTrials {};                                       // Trials of the multiple-try translations (1: plain translation).
+    const bool m_batchTranslation {};                               // Translations by batches of independent particles.
+    std::vector<int> m_batchCellArray {};                           // Work arrays of the batch translations.
+    std::vector<int> m_batchIndexArray {};
+    std::vector<bool> m_batchFlagArray {};
+    const int m_speculativeThreads {};                              // Worker threads of the speculative translations (0: off).
+    int m_nPendingTranslations {0};                                 // Translations deferred to the end of the time step.
+    // Version of each cell of the neighbor grid: odd while a worker writes in the cell, bumped by 2 on each commit.
+    std::vector<std::atomic<unsigned int>> m_cellVersionArray {};
+    // Copy of the positions read and written by the workers with relaxed atomics, the reads being validated by the
+    // cell versions. The workers do not read the particle records, which they write under the cell lock.
+    std::vector<std::atomic<Real>> m_speculativePositionArray {};
+    std::vector<std::mt19937> m_workerGeneratorArray {};            // One random stream per worker thread.
+    long long m_nSpeculativeAttempts {0};
+    long long m_nSpeculativeCommits {0};
+    long long m_nSpeculativeConflicts {0};                          // Failed validations of a read set.
+    long long m_nSpeculativeRetries {0};                            // Moves evaluated more than once.
+    const bool m_domainDecomposition {};                            // Translations by sub-sweeps over the rank slabs.
+    std::mt19937 m_domainGenerator {};                              // Random stream of the moves of this rank.
+    // With a domain decomposition m_systemMolecules only holds the particles of the slab of the rank and of its ghost
+    // layers, sorted by global index. Index 0 of the arrays below is the left rank, index 1 the right rank.
+    std::vector<int> m_domainGlobalIndexArray {};                   // Global index of each local particle.
+    std::vector<int> m_domainOwnedArray {};                         // Local indices of the particles of the slab.
+    std::vector<bool> m_domainOwnedFlagArray {};
+    std::array<std::vector<int>, 2> m_domainSendArray {};           // Particles of the slab in the ghost layer of a rank.
+    std::array<std::vector<int>, 2> m_domainSendSlotArray {};       // Slot of each local particle in m_domainSendArray.
+    std::array<std::vector<int>, 2> m_domainReceiveArray {};        // Ghosts received from a rank, in its send order.
+    std::vector<int> m_domainSlotArray {};                          // Slot of each particle moved in a sub-sweep (-1: none).
+    static constexpr int m_lenDomainRecord {11};                    // Fixed part of a particle record, see packDomainParticle.
 	const int m_saveUpdate {};                           			// save xyz update frequency.
 	const std::string m_neighMethod {};                   			// Neighbor list method: "verlet" for verlet neighbor list. Any other value: no neighbor list.
 	const int m_timeSteps {};                             			// Number of time steps.
@@ -59,45 +167,306 @@ private:
 
 public:
     // Monte Carlo constructor
-    MonteCarlo (param::Parameter param, const Molecules& systemMolecules, Neighbors  systemNeighbors,
-                std::string folderPath)
+    MonteCarlo (param::Parameter param, Molecules systemMolecules, Neighbors  systemNeighbors,
+                const Domain& systemDomain, std::string folderPath)
 
-        : m_systemMolecules (systemMolecules)
+        : m_systemMolecules (std::move(systemMolecules))
             , m_systemNeighbors(std::move(systemNeighbors))
-            , m_nParticles(systemMolecules.getNParticles())
+            , m_systemDomain(systemDomain)
+            , m_systemMinimizer(param)
+            , m_nParticles(m_systemMolecules.getNParticles())
             , m_calculatePressure(param.get_bool("calcPressure", false))
+            , m_virialCheckRate(param.get_int("virialCheckRate", 100))
+            , m_saveDisplacement(param.get_bool("saveDisplacement", false))
+            , m_quench(param.get_bool("quench", false))
+            , m_widomRate(param.get_int("widomRate", 0))
+            , m_widomInsertions(param.get_int("widomInsertions", 1000))
+            , m_widomGenerator(std::random_device {}())
+            , m_saveQuenchXYZ(param.get_bool("saveQuenchXYZ", false))
             , m_swap(param.get_bool("swap", false))
             , m_pSwap (param.get_double("pSwap", 0.2))
             , m_pSwap12 (param.get_double("pSwap12", 0))
             , m_pSwap13 (param.get_double("pSwap13", 1))
             , m_pSwap23 (param.get_double("pSwap23", 0))
+            , m_swapEnergyCache (param.get_bool("swapEnergyCache", false))
+            , m_swapMode (initializeSwapMode(param))
             , m_molTranslation ( param.get_bool("molTranslation", false))
             , m_pMolTranslation ( param.get_double("pMolTranslation", 0.1))
             , m_rBoxMolTrans ( param.get_double("rBoxMolTranslation", 0.05))
+            , m_molRotation ( param.get_bool("molRotation", false))
+            , m_pMolRotation ( param.get_double("pMolRotation", 0.1))
+            , m_maxAngleMolRotation ( param.get_double("maxAngleMolRotation", 0.1))
+            , m_pivot ( param.get_bool("pivot", false))
+            , m_pPivot ( param.get_double("pPivot", 0.05))
+            , m_maxAnglePivot ( param.get_double("maxAnglePivot", 0.2))
+            , m_crankshaft ( param.get_bool("crankshaft", false))
+            , m_pCrankshaft ( param.get_double("pCrankshaft", 0.05))
+            , m_maxAngleCrankshaft ( param.get_double("maxAngleCrankshaft", 0.5))
+            , m_regrowth ( param.get_bool("regrowth", false))
+            , m_pRegrowth ( param.get_double("pRegrowth", 0.05))
+            , m_cbmcTrials ( param.get_int("cbmcTrials", 8))
+            , m_cbmcMaxBeads ( param.get_int("cbmcMaxBeads", 1))
+            , m_cbmcBondRadius ( param.get_double("cbmcBondRadius", 1.5))
+            , m_volumeMove ( param.get_bool("volumeMove", false))
+            , m_pVolume ( param.get_double("pVolume", 0.001))
+            , m_pressureTarget ( param.get_double("pressure", 0.))
+            , m_maxLnVolume ( param.get_double("maxLnVolume", 0.01))
+            , m_hybrid ( param.get_bool("hybrid", false))
+            , m_pHybrid ( param.get_double("pHybrid", 0.001))
+            , m_hybridSteps ( param.get_int("hybridSteps", 10))
+            , m_hybridTimeStep ( param.get_double("hybridTimeStep", 0.005))
+            , m_mutation ( param.get_bool("mutation", false))
+            , m_pMutation ( param.get_double("pMutation", 0.05))
+            , m_deltaMuArray (initializeDeltaMu(param, m_systemMolecules.getNParticleTypes()))
+            , m_tuneSteps ( param.get_int("tuneSteps", 0))
+            , m_tuneWindow ( param.get_int("tuneWindow", 20))
+            , m_targetAcceptance ( param.get_double("targetAcceptance", 0.4))
+            , m_tuneMetric (initializeTuneMetric(param))
             , m_temp { param.get_double( "temp") }
             , m_rBox { param.get_double( "rBox") }
+            , m_mtmTrials { param.get_int( "mtmTrials", 1) }
+            , m_batchTranslation { param.get_bool( "batchTranslation", false) }
+            , m_speculativeThreads { param.get_int( "speculativeThreads", 0) }
+            , m_domainDecomposition { param.get_bool( "domainDecomposition", false) }
             , m_saveUpdate { param.get_int( "waitingTime") }
             , m_timeSteps { param.get_int( "timeSteps") }
             , m_saveRate { param.get_int("saveRate", 1000)}
+            , m_energyCheckRate { param.get_int("energyCheckRate", 0)}
+            , m_energyDriftTolerance { param.get_double("energyDriftTolerance", 1e-6)}
+            , m_saveParticleEnergy { param.get_bool("saveParticleEnergy", false)}
             , m_folderPath (std::move( folderPath ))
 
     {
-        m_energy = m_systemMolecules.energySystemMolecule( m_systemNeighbors );
+        if (m_domainDecomposition)
+        {
+            initializeDomain();
+        }
+        m_energy = systemEnergy();
+
+        if (m_calculatePressure)
+        {
+            m_virial = systemVirial();
+            // The other moves change the virial without computing it: it is then recomputed at each save.
+            m_virialIncremental = m_mtmTrials <= 1 && !m_batchTranslation && m_speculativeThreads == 0
+                                  && !m_domainDecomposition && !m_regrowth && !m_volumeMove;
+        }
+
+        if (m_swapEnergyCache && m_systemMolecules.isPolydisperse())
+        {
+            std::cerr << "swapEnergyCache needs discrete particle types (polydisperse=no)\n";
+            std::abort();
+        }
+
+        if (m_swap && m_swapMode == SwapMode::global)
+        {
+            m_systemMolecules.initializeTypeBuckets();
+        }
+
+        if (m_mutation && m_systemMolecules.isPolydisperse())
+        {
+            std::cerr << "mutation needs discrete particle types (polydisperse=no)\n";
+            std::abort();
+        }
+
+        if (m_mutation)
+        {
+            const int nParticleTypes {m_systemMolecules.getNParticleTypes()};
+            m_typeCountArray.assign(nParticleTypes, 0);
+
+            for (int i = 0; i < m_nParticles; i++)
+            {
+                ++m_typeCountArray[m_systemMolecules.getParticleTypeI(i) - 1];
+            }
+            m_compositionHistogramArray.assign(nParticleTypes * (m_nParticles + 1), 0);
+        }
+
+        if (m_widomRate > 0)
+        {
+            m_widomSumArray.assign(m_systemMolecules.getNParticleTypes(), 0.);
+        }
+
+        if ((m_swap || m_mutation) && m_swapEnergyCache)
+        {
+            m_systemMolecules.initializeTypeEnergy( m_systemNeighbors );
+        }
+
+        if (m_speculativeThreads > 0)
+        {
+#ifndef _OPENMP
+            if (m_speculativeThreads > 1)
+            {
+                std::cerr << "speculativeThreads=" << m_speculativeThreads << " needs an OpenMP build (USE_OPENMP=ON): "
+                          << "the speculative translations run on one thread\n";
+            }
+#endif
+            m_cellVersionArray = std::vector<std::atomic<unsigned int>> (m_systemNeighbors.getNCells());
+            m_speculativePositionArray = std::vector<std::atomic<Real>> (3 * m_nParticles);
+
+            for (int t = 0; t < m_speculativeThreads; t++)
+            {
+                m_workerGeneratorArray.emplace_back(Random::mt());
+            }
+        }
+
+        initializeMoves();
+
+        if (m_hybrid && (m_hybridSteps < 1 || m_hybridTimeStep <= 0.))
+        {
+            std::cerr << "hybridSteps must be at least 1 and hybridTimeStep positive\n";
+            std::abort();
+        }
+
+        if (m_tuneSteps > 0 && m_tuneWindow < 1)
+        {
+            std::cerr << "tuneWindow must be at least 1\n";
+            std::abort();
+        }
+
+        // Each rank would time its moves differently and pick another move mix.
+        if (m_tuneSteps > 0 && m_domainDecomposition)
+        {
+            std::cerr << "tuneSteps needs a single rank (domainDecomposition=no)\n";
+            std::abort();
+        }
+
+        // A volume move must fit in the skin of a freshly built neighbor list.
+        if (m_volumeMove && !m_systemNeighbors.isValidScale(std::exp(-m_maxLnVolume / 3.)))
+        {
+            std::cerr << "maxLnVolume=" << m_maxLnVolume << " compresses the box beyond the neighbor skin (rSkin)\n";
+            std::abort();
+        }
+    }
+
+    static SwapMode initializeSwapMode(param::Parameter param)
+    {
+        const std::string swapMode {param.get_string("swapMode", "molecule")};
+
+        if (swapMode == "molecule")
+        {
+            return SwapMode::molecule;
+        }
+        if (swapMode == "global")
+        {
+            return SwapMode::global;
+        }
+        if (swapMode == "neighbor")
+        {
+            return SwapMode::neighbor;
+        }
+        std::cerr << "Unknown swapMode: " << swapMode << " (molecule, global or neighbor)\n";
+        std::abort();
+    }
+
+    static TuneMetric initializeTuneMetric(param::Parameter param)
+    {
+        const std::string tuneMetric {param.get_string("tuneMetric", "msd")};
+
+        if (tuneMetric == "msd")
+        {
+            return TuneMetric::msd;
+        }
+        if (tuneMetric == "energy")
+        {
+            return TuneMetric::energy;
+        }
+        std::cerr << "Unknown tuneMetric: " << tuneMetric << " (msd or energy)\n";
+        std::abort();
+    }
+
+    static std::vector<double> initializeDeltaMu(param::Parameter param, const int& nParticleTypes)
+/*
+ * Reads the chemical potential differences deltaMuIJ = mu_J - mu_I (I < J, 0 by default) of the type mutations.
+ * The array is antisymmetric: a mutation from J to I gets -deltaMuIJ.
+ */
+    {
+        std::vector<double> deltaMuArray (nParticleTypes * nParticleTypes, 0.);
+
+        for (int typeI = 1; typeI <= nParticleTypes; typeI++)
+        {
+            for (int typeJ = typeI + 1; typeJ <= nParticleTypes; typeJ++)
+            {
+                const double deltaMu {param.get_double("deltaMu" + std::to_string(typeI) + std::to_string(typeJ),
+                                                       0.)};
+                deltaMuArray[(typeI - 1) * nParticleTypes + typeJ - 1] = deltaMu;
+                deltaMuArray[(typeJ - 1) * nParticleTypes + typeI - 1] = -deltaMu;
+            }
+        }
+        return deltaMuArray;
     }
 
 	void mcTotal();
 	int mcMove();
+    void initializeMoves();
+    void initializeMoveTable();
+    int mcMoveTimed();
+    void mcPendingTranslations();
+    void accumulateMoveRates();
+    void tuneMoves(const std::string& path);
+    void tuneStepSizes(const std::vector<MoveRecord>& windowArray);
+    double runTuneWindow(const int& nSteps);
+    void resetMoveCounters();
+    void saveTuning(const std::string& path) const;
+    int runMove(const move::Translation&, MoveRecord& record);
+    int runMove(const move::MultipleTryTranslation&, MoveRecord& record);
+    int runMove(const move::BatchTranslation&, MoveRecord& record);
+    int runMove(const move::PendingTranslation&, MoveRecord& record);
+    int runMove(const move::Swap&, MoveRecord& record);
+    int runMove(const move::NonLocalSwap&, MoveRecord& record);
+    int runMove(const move::DiameterSwap&, MoveRecord& record);
+    int runMove(const move::MoleculeTranslation&, MoveRecord& record);
+    int runMove(const move::MoleculeRotation&, MoveRecord& record);
+    int runMove(const move::Pivot&, MoveRecord& record);
+    int runMove(const move::Crankshaft&, MoveRecord& record);
+    int runMove(const move::Regrowth&, MoveRecord& record);
+    int runMove(const move::Volume&, MoveRecord& record);
+    int runMove(const move::Mutation&, MoveRecord& record);
+    int runMove(const move::Hybrid&, MoveRecord& record);
+
+    template<typename MoveType>
+    void countAccepted(const double& nAccepted = 1.)
+/*
+ * Adds nAccepted accepted moves to the record of MoveType, per particle as the attempt rate.
+ */
+    {
+        m_moveArray[m_moveRecordIndexArray[getMoveIndex<MoveType>()]].acceptanceRate += nAccepted / m_nParticles;
+    }
+
     void mcTranslation();
-    void generalUpdate(double diff_energy);
+    void mcTranslationI(const int& indexTranslation);
+    void mcTranslationMultipleTry();
+    int mcBatchTranslation();
+    void mcSpeculativeTranslations(const int& nAttempts);
+    void mcDomainTranslations(const int& nAttempts);
+    void initializeDomain();
+    void buildDomain(const std::vector<double>& ownedRecordArray);
+    void migrateDomain();
+    void exchangeDomainHalo(std::vector<double>& movedArray);
+    void packDomainParticle(const int& indexParticle, std::vector<double>& recordArray) const;
+    static std::vector<int> getDomainRecordOffsets(const std::vector<double>& recordArray);
+    static void unpackDomainParticles(const std::vector<double>& recordArray, const std::vector<int>& offsetArray,
+                                      std::vector<int> bondsArray, std::vector<int> bondsIndex, Molecules& molecules);
+    [[nodiscard]] int getDomainOwnerI(const int& indexParticle) const;
+    [[nodiscard]] double systemEnergy() const;
+    [[nodiscard]] double systemVirial() const;
+    [[nodiscard]] Molecules gatherMolecules() const;
+    void saveInXYZ(const std::string& path) const;
+    void translationTrialEnergies(const int& indexParticle, const std::vector<Real>& trialArray,
+                                  std::vector<double>& trialEnergyArray) const;
+    void generalUpdate(double diff_energy, double diffVirial = 0.);
+    [[nodiscard]] double pressure() const;
+    void checkEnergyDrift(const int& timeStep);
     void mcSwap();
+    void mcDiameterSwap();
+    void mcNonLocalSwap();
+    bool swapTypesIJ(const int& indexSwap1, const int& indexSwap2, const double& lnSelectionRatio);
     [[nodiscard]] bool metropolis(double diff_energy) const;
 
     template<typename InputIt>
-    std::vector<double> vectorTranslation(const int& indexTranslation, InputIt randomVectorIt)
+    std::vector<Real> vectorTranslation(const int& indexTranslation, InputIt randomVectorIt)
     {
         auto posItBeginTranslation = m_systemMolecules.getPosItBeginI(indexTranslation);
         const int& nDims {m_systemMolecules.getNDims()};
-        std::vector<double> positionTranslation (nDims);
+        std::vector<Real> positionTranslation (nDims);
         std::transform(posItBeginTranslation, posItBeginTranslation + nDims,
                        randomVectorIt, positionTranslation.begin(), std::plus<>());
         m_systemMolecules.periodicBC(positionTranslation.begin());
@@ -105,7 +474,289 @@ public:
     }
 
 
-    void mcMoleculeTranslation();
+    int mcMoleculeTranslation();
+    int mcMoleculeRotation();
+    int mcPivot();
+    int mcCrankshaft();
+    int mcRegrowth();
+    void mcVolume();
+    void mcMutation();
+    void mcHybrid();
+    std::array<double, 2> hybridTrajectory(std::vector<double>& momentumArray);
+    void hybridPositionStep(const std::vector<double>& momentumArray);
+    void saveEnergy(const std::string& path) const;
+    void saveCompositionHistogram(const std::string& path) const;
+    void widomSampling();
+    void widomEnergies(const std::vector<Real>& positionArray, std::vector<double>& energyArray) const;
+    void saveWidom(const std::string& path) const;
+    void saveInherentStructure(const int& timeStep, const std::string& path, const std::string& pathXYZ) const;
+    void regrowthTrialEnergies(const std::vector<int>& regrownArray, const std::vector<int>& sortedRegrownArray,
+                               const int& b, const std::vector<Real>& placedArray,
+                               const std::vector<Real>& trialArray, std::vector<double>& trialEnergyArray);
+    void checkNeighbors();
+    void resetNeighborDependents();
+
+    [[nodiscard]] double getEnergy() const
+    {
+        return m_energy;
+    }
+
+    [[nodiscard]] double getVirial() const
+    {
+        return m_virial;
+    }
+
+    [[nodiscard]] const Molecules& getMolecules() const
+    {
+        return m_systemMolecules;
+    }
+
+    [[nodiscard]] const Neighbors& getNeighbors() const
+    {
+        return m_systemNeighbors;
+    }
+
+    template<int LenMolecule = 0, bool WithVirial = false, typename InputPosIt>
+    EnergyResult<WithVirial> energyMoleculeExtraDiff(const int& indexMolecule, InputPosIt newPosItBegin) const
+/*
+ * Intermolecular energy difference of a rigid molecule move, the members being moved to newPosItBegin.
+ * LenMolecule > 0 fixes the molecule length at compile time. WithVirial also returns the virial difference.
+ */
+    {
+        constexpr int nDims {3};
+        const int& indexBegin {m_systemMolecules.getMoleculeBeginI(indexMolecule)};
+        const int lenMolecule {(LenMolecule > 0) ? LenMolecule : m_systemMolecules.getMoleculeLengthI(indexMolecule)};
+        EnergyResult<WithVirial> oldEnergyMolecule {};
+        EnergyResult<WithVirial> newEnergyMolecule {};
+
+        if (m_systemNeighbors.hasMoleculeNeighbors())
+        {
+            const auto& neighItBegin { m_systemNeighbors.getMoleculeNeighItBeginI(indexMolecule) };
+            const int lenNeigh {m_systemNeighbors.getMoleculeLenNeighI(indexMolecule)};
+
+            oldEnergyMolecule = m_systemMolecules.energyMoleculeExtra<WithVirial>(indexBegin, lenMolecule,
+                                                                                  neighItBegin, lenNeigh);
+            newEnergyMolecule = m_systemMolecules.energyMoleculeExtra<WithVirial>(indexBegin, lenMolecule,
+                                                                                  newPosItBegin, neighItBegin,
+                                                                                  lenNeigh);
+        }
+        else
+        {
+            const int& typeMolecule {m_systemMolecules.getMoleculeTypeI(indexBegin)};
+
+            for (int j = 0; j < lenMolecule; j++)
+            {
+                const int indexTranslation {indexBegin + j};
+                const auto& neighItBegin { m_systemNeighbors.getNeighItBeginI(indexTranslation) };
+                const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexTranslation)};
+
+                oldEnergyMolecule += m_systemMolecules.energyPairParticleExtraMolecule<WithVirial>(
+                        indexTranslation, neighItBegin, lenNeigh, typeMolecule);
+                newEnergyMolecule += m_systemMolecules.energyPairParticleExtraMolecule<WithVirial>(
+                        indexTranslation, newPosItBegin + nDims * j, neighItBegin, lenNeigh, typeMolecule);
+            }
+        }
+        return newEnergyMolecule - oldEnergyMolecule;
+    }
+
+    template<bool WithVirial, typename IndexIt, typename InputPosIt>
+    EnergyResult<WithVirial> energyRigidBodyDiff(IndexIt indexItBegin, const int& nMoved, InputPosIt newPosItBegin,
+                                                 const double& maxArm) const
+/*
+ * Energy difference of the pairs inside the rigid body of a rotation, see Molecules::energyPairsWithin. It is zero,
+ * and skipped, when the members are less than half the box apart: they are at most 2 maxArm apart, maxArm being
+ * their largest distance to the rotation center.
+ */
+    {
+        constexpr int nDims {3};
+
+        if (4. * maxArm < m_systemMolecules.getLengthCube())
+        {
+            return {};
+        }
+        std::vector<Real> oldPositionArray (nDims * nMoved);
+
+        for (int j = 0; j < nMoved; j++)
+        {
+            const auto posItBegin {m_systemMolecules.getPosItBeginI(indexItBegin[j])};
+            std::copy(posItBegin, posItBegin + nDims, oldPositionArray.begin() + nDims * j);
+        }
+        return m_systemMolecules.energyPairsWithin<WithVirial>(indexItBegin, nMoved, newPosItBegin)
+               - m_systemMolecules.energyPairsWithin<WithVirial>(indexItBegin, nMoved, oldPositionArray.begin());
+    }
+
+    template<typename DiffFunction>
+    double energyVirialDiff(DiffFunction diffFunction, double& diffVirial) const
+/*
+ * Evaluates a move with diffFunction(std::bool_constant<WithVirial>), WithVirial being m_calculatePressure, so that
+ * the virial difference comes from the same neighbor pass as the energy difference. Returns the energy difference.
+ */
+    {
+        if (m_calculatePressure)
+        {
+            const EnergyVirial diff {diffFunction(std::true_type {})};
+            diffVirial = diff.virial;
+            return diff.energy;
+        }
+        diffVirial = 0.;
+        return diffFunction(std::false_type {});
+    }
+
+    template<typename Generator>
+    bool translateParticle(const int& indexParticle, Generator& generator, std::array<double, 3>& displacement,
+                           double& diffEnergy)
+/*
+ * Translation of indexParticle drawing its random numbers from generator. An accepted move only updates the position:
+ * the energy, the neighbor list displacement and the acceptance rate are left to the caller.
+ */
+    {
+        constexpr int nDims {3};
+
+        for (auto& component : displacement)
+        {
+            component = std::uniform_real_distribution<double> {-m_rBox, m_rBox}(generator);
+        }
+        std::array<Real, nDims> newPosition {};
+        const auto posItBegin {m_systemMolecules.getPosItBeginI(indexParticle)};
+        std::transform(posItBegin, posItBegin + nDims, displacement.begin(), newPosition.begin(), std::plus<>());
+        m_systemMolecules.periodicBC(newPosition.begin());
+
+        const auto neighItBegin { m_systemNeighbors.getNeighItBeginI(indexParticle) };
+        const int& lenNeigh {m_systemNeighbors.getLenIndexBegin(indexParticle)};
+        diffEnergy = m_systemMolecules.energyParticleMolecule(indexParticle, newPosition.begin(), neighItBegin, lenNeigh)
+                     - m_systemMolecules.energyParticleMolecule(indexParticle, neighItBegin, lenNeigh);
+        const double randomAccept {std::uniform_real_distribution<double> {0., 1.}(generator)};
+
+        if (diffEnergy <= 0. || randomAccept < std::exp(-diffEnergy / m_temp))
+        {
+            m_systemMolecules.updatePositionI(indexParticle, newPosition.begin());
+            return true;
+        }
+        return false;
+    }
+
+    template<typename IndexIt, typename InputPosIt, typename DispIt>
+    void updateMovedParticles(IndexIt indexItBegin, const int& nMoved, InputPosIt newPosItBegin,
+                              DispIt displacementItBegin)
+/*
+ * Applies an accepted move of nMoved particles. Particles are moved one by one so that the cache updates see the
+ * already moved particles. The unwrapped displacements set the image counters (see Molecules::displacePositionI), the
+ * neighbor list follows the minimum image ones. Moves that can displace particles by more than the skin allows
+ * (regrowth) rebuild the neighbor list right away instead of at the end of the time step.
+ */
+    {
+        constexpr int nDims {3};
+        bool neighborsOutdated {false};
+
+        for (int j = 0; j < nMoved; j++)
+        {
+            const int indexParticle {indexItBegin[j]};
+            const auto newPosItBeginJ {newPosItBegin + nDims * j};
+            std::array<double, nDims> displacement {};
+            m_systemMolecules.separationPair(m_systemMolecules.getPosItBeginI(indexParticle), newPosItBeginJ,
+                                             displacement.begin());
+            m_systemMolecules.updateTypeEnergyTranslation(indexParticle, newPosItBeginJ,
+                                                          m_systemNeighbors.getNeighItBeginI(indexParticle),
+                                                          m_systemNeighbors.getLenIndexBegin(indexParticle));
+            m_systemMolecules.displacePositionI(indexParticle, newPosItBeginJ, displacementItBegin + nDims * j);
+            m_systemNeighbors.updateInterDisplacement(indexParticle, displacement.begin());
+            neighborsOutdated = neighborsOutdated || m_systemNeighbors.isDisplacedI(indexParticle);
+        }
+
+        if (neighborsOutdated)
+        {
+            checkNeighbors();
+        }
+    }
+
+    template<typename IndexIt, typename DispIt>
+    bool prepareNeighborRows(IndexIt indexItBegin, const int& nMoved, DispIt displacementItBegin)
+/*
+ * Makes the neighbor rows valid for the trial positions of a move of nMoved particles before its energy is computed
+ * from them. The list is rebuilt when a displacement added to the one since the last update passes the skin
+ * threshold. Returns false, and the move is rejected, when a displacement passes it by itself: this only depends on
+ * the old and new positions, so the detailed balance holds.
+ */
+    {
+        constexpr int nDims {3};
+        bool neighborsOutdated {false};
+
+        for (int j = 0; j < nMoved; j++)
+        {
+            const auto displacementItBeginJ {displacementItBegin + nDims * j};
+
+            if (!m_systemNeighbors.isInSkin(displacementItBeginJ))
+            {
+                return false;
+            }
+            neighborsOutdated = neighborsOutdated || m_systemNeighbors.isDisplacedI(indexItBegin[j],
+                                                                                    displacementItBeginJ);
+        }
+
+        if (neighborsOutdated)
+        {
+            m_systemNeighbors.updateNeighborList(m_systemMolecules);
+            resetNeighborDependents();
+        }
+        return true;
+    }
+
+    template<int LenMolecule>
+    void mcMoleculeTranslationLen(const int& indexMolecule)
+/*
+ * Translation of a whole molecule. LenMolecule > 0 fixes the molecule length at compile time: the tentative positions
+ * then live on the stack and the loops over the molecule are unrolled. LenMolecule = 0 reads the length from the
+ * molecule table.
+ */
+    {
+        constexpr int nDims {3};
+        const int lenMolecule {(LenMolecule > 0) ? LenMolecule : m_systemMolecules.getMoleculeLengthI(indexMolecule)};
+        const int& indexBegin {m_systemMolecules.getMoleculeBeginI(indexMolecule)};
+        const std::vector<double> randomVector ( Random::vectorDoubleGenerator(nDims, -m_rBoxMolTrans,
+                                                                               m_rBoxMolTrans) );
+        std::conditional_t<(LenMolecule > 0), std::array<Real, nDims * LenMolecule>, std::vector<Real>>
+                positionArrayTranslation {};
+
+        if constexpr (LenMolecule == 0)
+        {
+            positionArrayTranslation.resize(nDims * lenMolecule);
+        }
+
+        for (int j = 0; j < lenMolecule; j++)
+        {
+            const auto posItBegin {m_systemMolecules.getPosItBeginI(indexBegin + j)};
+            const auto newPosItBegin {positionArrayTranslation.begin() + nDims * j};
+
+            std::transform(posItBegin, posItBegin + nDims, randomVector.begin(), newPosItBegin, std::plus<>());
+            m_systemMolecules.periodicBC(newPosItBegin);
+        }
+
+        double diffVirial {};
+        const double diffEnergy {energyVirialDiff([&](auto withVirial)
+        {
+            return energyMoleculeExtraDiff<LenMolecule, decltype(withVirial)::value>(
+                    indexMolecule, positionArrayTranslation.begin());
+        }, diffVirial)};
+
+        // Metropolis criterion
+        if (metropolis(diffEnergy))
+        {
+            generalUpdate(diffEnergy, diffVirial);
+            countAccepted<move::MoleculeTranslation>(); // increment of the acceptance rate.
+
+            for (int j = 0; j < lenMolecule; j++)
+            {
+                // Particles are moved one by one so that the cache updates see the already moved particles.
+                const int indexTranslation {indexBegin + j};
+                const auto newPosItBegin {positionArrayTranslation.begin() + nDims * j};
+                m_systemMolecules.updateTypeEnergyTranslation(indexTranslation, newPosItBegin,
+                                                              m_systemNeighbors.getNeighItBeginI(indexTranslation),
+                                                              m_systemNeighbors.getLenIndexBegin(indexTranslation));
+                m_systemMolecules.updatePositionI(indexTranslation, newPosItBegin);
+                m_systemNeighbors.updateInterDisplacement(indexTranslation, randomVector.begin());
+            }
+        }
+    }
 };
 
 
@@ -90,7 +90,7 @@ void Neighbors::WOWcreateNeighborList(const Molecules& systemMolecules)
     }
 }
 ***/
-void Neighbors::createNeighborList(const Molecules& systemMolecules)
+void Neighbors::createNeighborList(const Molecules& systemMolecules, const bool& checkErrors)
 {
     // Be careful with the swaps and poly dispersity. Solution for now is to take rSkin big enough.
     const std::vector<int> oldNeighborList = m_neighborList;
@@ -110,7 +110,7 @@ void Neighbors::createNeighborList(const Molecules& systemMolecules)
     //    m_neighborList[i].clear();
     //}
     const std::vector<std::vector<std::vector<std::vector<int>>>> cellList { createCellList ( systemMolecules) };
-    const bool checkNeigh { m_updateRate > 0};
+    const bool checkNeigh { checkErrors && m_updateRate > 0};
 
     for (int xCell = 0; xCell < m_numCell; xCell++)
     {
@@ -126,6 +126,188 @@ void Neighbors::createNeighborList(const Molecules& systemMolecules)
     m_changeNum = 0;
     // eraseFalseNeighbors(systemMolecules);
     // sortNeighborList(systemMolecules);
+
+    if (m_moleculeNeighbors)
+    {
+        createMoleculeNeighborList(systemMolecules);
+    }
+    createCellGrid(systemMolecules);
+}
+
+/*******************************************************************************
+ * This function sorts the particles by cell (counting sort). The grid is used
+ * by the moves that evaluate positions far from the particle's current one,
+ * where its neighbor row does not apply.
+ ******************************************************************************/
+void Neighbors::createCellGrid(const Molecules& systemMolecules)
+{
+    const int nCells {m_numCell * m_numCell * m_numCell};
+    m_particleCellArray.resize(systemMolecules.m_nParticles);
+    m_cellIndex.assign(nCells + 1, 0);
+    m_cellParticleArray.resize(systemMolecules.m_nParticles);
+
+    for (int i = 0; i < systemMolecules.m_nParticles; i++)
+    {
+        m_particleCellArray[i] = getCellI(systemMolecules.getPosItBeginI(i));
+        ++m_cellIndex[m_particleCellArray[i] + 1];
+    }
+    std::partial_sum(m_cellIndex.begin(), m_cellIndex.end(), m_cellIndex.begin());
+
+    std::vector<int> fillArray (m_cellIndex.begin(), m_cellIndex.end() - 1);
+
+    for (int i = 0; i < systemMolecules.m_nParticles; i++)
+    {
+        m_cellParticleArray[fillArray[m_particleCellArray[i]]++] = i;
+    }
+}
+
+/*******************************************************************************
+ * This function appends to cellArray the cells around indexCell, indexCell
+ * included, with periodic boundary conditions. Small grids (less than three
+ * cells per side) do not append a cell twice.
+ ******************************************************************************/
+void Neighbors::appendCellNeighborhood(const int& indexCell, std::vector<int>& cellArray) const
+{
+    const int xCell {indexCell / (m_numCell * m_numCell)};
+    const int yCell {(indexCell / m_numCell) % m_numCell};
+    const int zCell {indexCell % m_numCell};
+    const auto firstAppended {static_cast<long>(cellArray.size())};
+
+    for (int dx = -1; dx <= 1; dx++)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dz = -1; dz <= 1; dz++)
+            {
+                const int x {(xCell + dx + m_numCell) % m_numCell};
+                const int y {(yCell + dy + m_numCell) % m_numCell};
+                const int z {(zCell + dz + m_numCell) % m_numCell};
+                cellArray.push_back((x * m_numCell + y) * m_numCell + z);
+            }
+        }
+    }
+
+    if (m_numCell < 3)
+    {
+        std::sort(cellArray.begin() + firstAppended, cellArray.end());
+        cellArray.erase(std::unique(cellArray.begin() + firstAppended, cellArray.end()), cellArray.end());
+    }
+}
+
+/*******************************************************************************
+ * This function builds the molecule neighbor list from the particle neighbor
+ * list: the row of a molecule is the sorted union of the rows of its members,
+ * without the members themselves. A molecule translation then visits each
+ * external particle once.
+ ******************************************************************************/
+void Neighbors::createMoleculeNeighborList(const Molecules& systemMolecules)
+{
+    const int nMolecules {systemMolecules.getNMolecules()};
+    std::vector<int> moleculeRow {};
+    m_moleculeNeighborList.clear();
+    m_moleculeNeighborIndex.assign(1, 0);
+
+    for (int indexMolecule = 0; indexMolecule < nMolecules; indexMolecule++)
+    {
+        const int indexBegin {systemMolecules.getMoleculeBeginI(indexMolecule)};
+        const int indexEnd {indexBegin + systemMolecules.getMoleculeLengthI(indexMolecule)};
+        moleculeRow.clear();
+
+        for (int indexParticle = indexBegin; indexParticle < indexEnd; indexParticle++)
+        {
+            const auto neighItBegin {getNeighItBeginI(indexParticle)};
+            std::copy_if(neighItBegin, neighItBegin + getLenIndexBegin(indexParticle), std::back_inserter(moleculeRow),
+                         [&indexBegin, &indexEnd](const int& indexJ)
+                         { return indexJ < indexBegin || indexJ >= indexEnd; });
+        }
+        std::sort(moleculeRow.begin(), moleculeRow.end());
+        moleculeRow.erase(std::unique(moleculeRow.begin(), moleculeRow.end()), moleculeRow.end());
+        m_moleculeNeighborList.insert(m_moleculeNeighborList.end(), moleculeRow.begin(), moleculeRow.end());
+        m_moleculeNeighborIndex.push_back(static_cast<int>(m_moleculeNeighborList.size()));
+    }
+}
+
+/*******************************************************************************
+ * This function appends the cells whose coordinates have the given parities.
+ * Two such cells are separated by at least one cell, i.e. by more than the
+ * skin radius when the grid was built, so their particles are never in each
+ * other's neighbor row. With an odd number of cells per side the last layer is
+ * left out: it touches the first one through the periodic boundaries (see
+ * appendLastLayerCells).
+ ******************************************************************************/
+void Neighbors::appendSublatticeCells(const int& parityX, const int& parityY, const int& parityZ,
+                                      std::vector<int>& cellArray) const
+{
+    const int numCellEven {m_numCell - m_numCell % 2};
+
+    for (int x = parityX; x < numCellEven; x += 2)
+    {
+        for (int y = parityY; y < numCellEven; y += 2)
+        {
+            for (int z = parityZ; z < numCellEven; z += 2)
+            {
+                cellArray.push_back((x * m_numCell + y) * m_numCell + z);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * This function appends the cells left out of the sublattices: those with a
+ * coordinate in the last layer of an odd grid. Nothing is appended when the
+ * number of cells per side is even.
+ ******************************************************************************/
+void Neighbors::appendLastLayerCells(std::vector<int>& cellArray) const
+{
+    if (m_numCell % 2 == 0)
+    {
+        return;
+    }
+    const int last {m_numCell - 1};
+
+    for (int x = 0; x < m_numCell; x++)
+    {
+        for (int y = 0; y < m_numCell; y++)
+        {
+            // Whole rows in the last x or y layer, otherwise only the cell in the last z layer.
+            const int zBegin {(x == last || y == last) ? 0 : last};
+
+            for (int z = zBegin; z < m_numCell; z++)
+            {
+                cellArray.push_back((x * m_numCell + y) * m_numCell + z);
+            }
+        }
+    }
+}
+
+bool Neighbors::hasSublattices() const
+{
+    return m_numCell >= 4;
+}
+
+/*******************************************************************************
+ * This function returns the sublattice (0 to 7, from the parities of the cell
+ * coordinates) of indexCell, the cells of a sublattice being pairwise not
+ * adjacent. The cells of the last layer of an odd grid belong to no sublattice
+ * (-1), as in appendSublatticeCells.
+ ******************************************************************************/
+int Neighbors::getSublatticeI(const int& indexCell) const
+{
+    const int xCell {indexCell / (m_numCell * m_numCell)};
+    const int yCell {(indexCell / m_numCell) % m_numCell};
+    const int zCell {indexCell % m_numCell};
+    const int numCellEven {m_numCell - m_numCell % 2};
+
+    if (xCell >= numCellEven || yCell >= numCellEven || zCell >= numCellEven)
+    {
+        return -1;
+    }
+    return (xCell % 2) * 4 + (yCell % 2) * 2 + zCell % 2;
+}
+
+bool Neighbors::hasMoleculeNeighbors() const
+{
+    return m_moleculeNeighbors;
 }
 
 void Neighbors::sortNeighborList(const Molecules& systemMolecules)
@@ -145,11 +327,11 @@ std::vector<std::vector<std::vector<std::vector<int>>>> Neighbors::createCellLis
     for (int i = 0; i < systemMolecules.m_nParticles; i++)
     {
         auto posItBeginI { systemMolecules.getPosItBeginI(i)};
-        const int xCell{static_cast<int>(floor(*posItBeginI / m_cellLength))};
+        const int xCell{std::min(static_cast<int>(floor(*posItBeginI / m_cellLength)), m_numCell - 1)};
         posItBeginI++;
-        const int yCell{static_cast<int>(floor(*posItBeginI / m_cellLength))};
+        const int yCell{std::min(static_cast<int>(floor(*posItBeginI / m_cellLength)), m_numCell - 1)};
         posItBeginI++;
-        const int zCell{static_cast<int>(floor(*posItBeginI / m_cellLength))};
+        const int zCell{std::min(static_cast<int>(floor(*posItBeginI / m_cellLength)), m_numCell - 1)};
         cellList[xCell][yCell][zCell].push_back(i);
 
     }
@@ -298,7 +480,7 @@ void Neighbors::checkNeighborError(const Molecules& systemMolecules, const std::
  * m_interDisplacementMatrix is reinitialized to zero. The criterion shouldn't
  * allow for any errors?
  ******************************************************************************/
-void Neighbors::checkInterDisplacement(const Molecules& systemMolecules)
+bool Neighbors::checkInterDisplacement(const Molecules& systemMolecules)
 {
     const  std::vector<double> squareDispVector = getSquareNormRowMatrix(m_interDisplacementVector.begin(),
                                                                          systemMolecules.m_nParticles,
@@ -309,11 +491,80 @@ void Neighbors::checkInterDisplacement(const Molecules& systemMolecules)
     {
         if ( squareDispVector[i] > m_thresh)
         {
-            createNeighborList(systemMolecules);
-            std::fill(m_interDisplacementVector.begin(), m_interDisplacementVector.end(),0);
-            break;
+            updateNeighborList(systemMolecules);
+            return true;
         }
     }
+    return false;
+}
+
+/*******************************************************************************
+ * This function rebuilds the neighbor list and the cell grid for the current
+ * box and resets the displacements. The number of particles can change (see
+ * Molecules::assignParticles).
+ ******************************************************************************/
+void Neighbors::updateNeighborList(const Molecules& systemMolecules, const bool& checkErrors)
+{
+    m_numCell = static_cast<int>(systemMolecules.m_lengthCube / m_rSkin);
+    m_cellLength = systemMolecules.m_lengthCube / static_cast<double>(m_numCell);
+    m_scaleSinceUpdate = 1.;
+    m_thresh = std::pow((m_rSkin - m_maxRc) / 2., 2);
+
+    if (static_cast<int>(m_neighborIndex.size()) != systemMolecules.m_nParticles)
+    {
+        // Another set of particles: the arrays are reallocated at its size rather than keeping their capacity.
+        std::vector<int> {}.swap(m_neighborList);
+        std::vector<int> {}.swap(m_cellParticleArray);
+        std::vector<int> {}.swap(m_particleCellArray);
+        std::vector<double> {}.swap(m_interDisplacementVector);
+    }
+    createNeighborList(systemMolecules, checkErrors);
+    m_interDisplacementVector.assign(systemMolecules.m_nParticles * m_nDims, 0.);
+}
+
+/*******************************************************************************
+ * This function checks that the neighbor list stays valid if the box is scaled
+ * by scaleFactor. Scaling moves all the pairs apart or together
+ * proportionally: a pair out of the list was at least rSkin apart at the last
+ * update, so after a total scaling S it is at least S rSkin apart, minus the
+ * displacements of the two particles (scaled with the box).
+ ******************************************************************************/
+bool Neighbors::isValidScale(const double& scaleFactor) const
+{
+    const double skinScale {std::min(m_scaleSinceUpdate * scaleFactor, 1.) * m_rSkin};
+
+    if (skinScale <= m_maxRc)
+    {
+        return false;
+    }
+    const double squareMargin {std::pow((skinScale - m_maxRc) / 2., 2) / (scaleFactor * scaleFactor)};
+    const int nParticles {static_cast<int>(m_interDisplacementVector.size()) / m_nDims};
+
+    for (int i = 0; i < nParticles; i++)
+    {
+        auto dispItBegin( m_interDisplacementVector.begin() + i * m_nDims);
+
+        if (getSquareNormVector(dispItBegin, dispItBegin + m_nDims) > squareMargin)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * This function applies an accepted scaling of the box, systemMolecules being
+ * already scaled. The list and the cell grid are kept: the cells shrink or grow
+ * with the box and the displacement threshold shrinks with the skin left by a
+ * compression.
+ ******************************************************************************/
+void Neighbors::rescaleBox(const Molecules& systemMolecules, const double& scaleFactor)
+{
+    m_scaleSinceUpdate *= scaleFactor;
+    m_cellLength = systemMolecules.m_lengthCube / static_cast<double>(m_numCell);
+    std::for_each(m_interDisplacementVector.begin(), m_interDisplacementVector.end(),
+                  [&scaleFactor](double& component) { component *= scaleFactor; });
+    m_thresh = std::pow((std::min(m_scaleSinceUpdate, 1.) * m_rSkin - m_maxRc) / 2., 2);
 }
 
 
@@ -30,13 +30,23 @@ private:
     const double m_squareRSkin {};                        			// Skin radius squared.
     const int m_nDims {3};
     int m_updateRate {-1};
-    const int m_numCell {};
-    const double m_cellLength {};
+    int m_numCell {};                                  // Grid size, recomputed from the box at each update.
+    double m_cellLength {};
 	int m_errors { 0 };                                             // Errors of the neighbor list.
 	std::vector<double> m_interDisplacementVector {};  // Inter neighbor list update displacement matrix.
     const std::vector<double> m_maxSquareRcArray{};
-    const double m_thresh{};
+    double m_thresh{};                                 // Squared displacement that triggers an update.
+    const double m_maxRc {};
+    double m_scaleSinceUpdate {1.};                    // Box scaling of the volume moves since the last update.
     int m_numNeighMax{};
+    const bool m_moleculeNeighbors {};                 // Builds the molecule neighbor list at each update.
+    std::vector<int> m_moleculeNeighborList {};        // Union of the member rows of each molecule, without its members.
+    std::vector<int> m_moleculeNeighborIndex {};       // Start of each molecule in m_moleculeNeighborList.
+    // Flat cell grid rebuilt with the neighbor list. Particles move by less than the skin threshold between two
+    // rebuilds, so the particles within the cut-off of any point are in the 27 cells around it.
+    std::vector<int> m_cellParticleArray {};           // Particles sorted by cell.
+    std::vector<int> m_cellIndex {};                   // Start of each cell in m_cellParticleArray.
+    std::vector<int> m_particleCellArray {};           // Cell of each particle when the grid was built.
     using NeighIterator = std::vector<int>::const_iterator;
 
 
@@ -47,8 +57,10 @@ public:
             , m_squareRSkin {std::pow (m_rSkin, 2 ) }
             , m_maxSquareRcArray (initializeMaxRc( systemMolecules))
             , m_thresh (initializeThresh(param, m_maxSquareRcArray))
+            , m_maxRc {std::sqrt(*std::max_element(m_maxSquareRcArray.begin(), m_maxSquareRcArray.end()))}
             , m_numCell { static_cast<int>(systemMolecules.m_lengthCube / m_rSkin) }
             , m_cellLength { systemMolecules.m_lengthCube / static_cast<double>(m_numCell)}
+            , m_moleculeNeighbors { param.get_bool("moleculeNeighbors", false) }
 
     {
         const double density {systemMolecules.m_nParticles / std::pow(systemMolecules.m_lengthCube, 3) };
@@ -64,12 +76,14 @@ public:
     {
         int nParticleTypes { systemMolecules.m_systemPairPotentials.getParticleTypes() };
         std::vector<double> maxSquareRcArray(nParticleTypes, 0) ;
+        // Polydisperse cut-offs are given in units of sigma_ij.
+        const double maxSquareSigma { systemMolecules.getMaxSquareSigma() };
 
         for (int i=1; i<=nParticleTypes; i++)
         {
             for (int j=i; j<=nParticleTypes; j++)
             {
-                double squareRcIJ { systemMolecules.m_systemPairPotentials.getSquareRcIJ(i, j)};
+                double squareRcIJ { systemMolecules.m_systemPairPotentials.getSquareRcIJ(i, j) * maxSquareSigma};
 
                 if (squareRcIJ > maxSquareRcArray[i-1])
                 {
@@ -97,7 +111,14 @@ public:
         return thresh;
     };
 
-	void checkInterDisplacement(const Molecules& systemMolecules);
+	bool checkInterDisplacement(const Molecules& systemMolecules); // Returns true if the list was rebuilt.
+
+    // checkErrors=false when the particles were renumbered since the last update: the rows cannot be compared.
+    void updateNeighborList(const Molecules& systemMolecules, const bool& checkErrors = true);
+
+    [[nodiscard]] bool isValidScale(const double& scaleFactor) const;
+
+    void rescaleBox(const Molecules& systemMolecules, const double& scaleFactor);
 
 
     [[nodiscard]] int cellTest(int indexCell) const;
@@ -179,7 +200,7 @@ public:
 
     void sortNeighborList(const Molecules& systemMolecules);
 
-    void createNeighborList(const Molecules& systemMolecules);
+    void createNeighborList(const Molecules& systemMolecules, const bool& checkErrors = true);
 
     void createCellNeighbors(const Molecules &systemMolecules,
                              const std::vector<int> &oldNeighborList,
@@ -204,6 +225,34 @@ public:
 
     [[nodiscard]] int getLenIndexBegin(const int &indexTranslation) const;
 
+    [[nodiscard]] bool isDisplacedI(const int &indexParticle) const
+    {
+        auto dispItBegin( m_interDisplacementVector.begin() + indexParticle * m_nDims);
+        return getSquareNormVector(dispItBegin, dispItBegin + m_nDims) > m_thresh;
+    }
+
+    template<typename InputIt>
+    [[nodiscard]] bool isInSkin(InputIt displacementIt) const
+    {
+        // True when a displacement from a fresh list keeps the neighbor rows valid.
+        return getSquareNormVector(displacementIt, displacementIt + m_nDims) <= m_thresh;
+    }
+
+    template<typename InputIt>
+    [[nodiscard]] bool isDisplacedI(const int &indexParticle, InputIt displacementIt) const
+    {
+        // Same as isDisplacedI with a trial displacement added to the one since the last update.
+        auto dispItBegin( m_interDisplacementVector.begin() + indexParticle * m_nDims);
+        double squareDisplacement {0.};
+
+        for (int d = 0; d < m_nDims; d++)
+        {
+            const double displacement {dispItBegin[d] + displacementIt[d]};
+            squareDisplacement += displacement * displacement;
+        }
+        return squareDisplacement > m_thresh;
+    }
+
     [[nodiscard]] NeighIterator getNeighItBeginI(const int &indexParticle) const
     {
         const int& neighIndex {getNeighborIndexBegin(indexParticle)};
@@ -217,6 +266,82 @@ public:
     }
 
     void eraseFalseNeighbors(const Molecules &molecules);
+
+    void createMoleculeNeighborList(const Molecules& systemMolecules);
+
+    void createCellGrid(const Molecules& systemMolecules);
+
+    template<typename InputPosIt>
+    [[nodiscard]] int getCellI(InputPosIt posItBegin) const
+    {
+        int indexCell {0};
+
+        for (int d = 0; d < m_nDims; d++)
+        {
+            const int cellD {std::clamp(static_cast<int>(std::floor(posItBegin[d] / m_cellLength)), 0, m_numCell - 1)};
+            indexCell = indexCell * m_numCell + cellD;
+        }
+        return indexCell;
+    }
+
+    void appendCellNeighborhood(const int& indexCell, std::vector<int>& cellArray) const;
+
+    void appendSublatticeCells(const int& parityX, const int& parityY, const int& parityZ,
+                               std::vector<int>& cellArray) const;
+
+    void appendLastLayerCells(std::vector<int>& cellArray) const;
+
+    [[nodiscard]] bool hasSublattices() const;
+
+    [[nodiscard]] int getSublatticeI(const int& indexCell) const;
+
+    [[nodiscard]] int getNumCell() const
+    {
+        return m_numCell;
+    }
+
+    [[nodiscard]] double getRSkin() const
+    {
+        return m_rSkin;
+    }
+
+    [[nodiscard]] double getMaxStepSize() const
+    {
+        // Largest component of a translation step whose norm stays within the skin threshold.
+        return std::sqrt(m_thresh / 3.);
+    }
+
+    [[nodiscard]] NeighIterator getCellItBeginI(const int &indexCell) const
+    {
+        return m_cellParticleArray.begin() + m_cellIndex[indexCell];
+    }
+
+    [[nodiscard]] NeighIterator getCellItEndI(const int &indexCell) const
+    {
+        return m_cellParticleArray.begin() + m_cellIndex[indexCell + 1];
+    }
+
+    [[nodiscard]] int getNCells() const
+    {
+        return m_numCell * m_numCell * m_numCell;
+    }
+
+    [[nodiscard]] int getParticleCellI(const int &indexParticle) const
+    {
+        return m_particleCellArray[indexParticle];
+    }
+
+    [[nodiscard]] bool hasMoleculeNeighbors() const;
+
+    [[nodiscard]] NeighIterator getMoleculeNeighItBeginI(const int &indexMolecule) const
+    {
+        return m_moleculeNeighborList.begin() + m_moleculeNeighborIndex[indexMolecule];
+    }
+
+    [[nodiscard]] int getMoleculeLenNeighI(const int &indexMolecule) const
+    {
+        return m_moleculeNeighborIndex[indexMolecule + 1] - m_moleculeNeighborIndex[indexMolecule];
+    }
 };
 
 
@@ -4,30 +4,6 @@
 #include <cmath>
 #include "BondPotentials.h"
 
-int BondPotentials::getIndexIJ(const int& i, const int& j) const
-{
-    int indexI{ i };
-    int indexJ{ j };
-
-    if (i > j)
-    {
-        indexI = j;
-        indexJ = i;
-    }
-
-    const int indexIJ {3 * ( 2 * indexJ +  indexI + 2 * m_particleTypes * ( indexI - 1) -  indexI * indexI  - 2)};
-    return indexIJ;
-}
-
-double BondPotentials::getFeneK(const int& i, const int& j) const
-{
-
-    const int indexIJ { getIndexIJ(i , j) };
-    double feneK {m_bondPotentials[indexIJ + 1] };
-    return feneK;
-
-}
-
 /***
 std::vector<double> BondPotentials::getPotentialsIJ(const int& i, const int& j) const
 {
@@ -36,61 +12,23 @@ std::vector<double> BondPotentials::getPotentialsIJ(const int& i, const int& j)
 }
 ***/
 /*******************************************************************************
-* This function calculates the Lennard-Jones potential energy between two
-* particles seperated by a distance whose square is equal to squareDistance.
-* We consider a cut off whose square is equal to squareRc times the mean diameter
-* of the two particles considered. The potential is equal to 0 for distances
-* greater that the cut off.
+* This function calculates the bond energy between two bonded particles
+* seperated by a distance whose square is equal to squareDistance. The bond
+* style is resolved at each call: energy loops should rather visit the style
+* once and call the templated bondEnergyIJ inside the loop.
 *
 * @param squareDistance Square of the distance separating the two considered
 *                       particles
-*        sigmaA Particle A's diameter
-*        sigmaB Particle B's diameter
-*        squareRc Square of the cut off radius
-*        shift Shifts the Lennard-Jones potential by a constant value
+*        particleTypeI Particle I's type
+*        particleTypeJ Particle J's type
 *
 * @return energy
 ******************************************************************************/
-double BondPotentials::feneBondEnergyIJ(const double& squareDistance, const int& particleTypeI,
-                                        const int& particleTypeJ) const
+double BondPotentials::bondEnergyIJ(const double& squareDistance, const int& particleTypeI,
+                                    const int& particleTypeJ) const
 {
-    const int indexIJ {getIndexIJ(particleTypeI, particleTypeJ)};
-    auto it {m_bondPotentials.begin() + indexIJ};
-    double energy {0.};
-
-    const double& squareR0IJ {*it};
-    ++it;
-    const double& feneKI {*it};
-    ++it;
-    if (feneKI != 0.)
-    {
-        if (squareDistance >= squareR0IJ)
-        {
-            return std::numeric_limits<double>::infinity();
-        }
-        else
-        {
-            energy += -0.5 * feneKI * squareR0IJ * std::log(1. - squareDistance / squareR0IJ);
-        }
-
-    }
-
-    double rcSquareIJ {*it};
-    ++it;
-
-    if (squareDistance < rcSquareIJ)
+    return visitStyle([&](const auto& style)
     {
-
-        const double& fourEpsilonIJ {*it};
-        ++it;
-        const double& squareSigmaIJ {*it};
-        ++it;
-        const double& shiftIJ {*it};
-        ++it;
-        const double rapSquare { squareSigmaIJ / squareDistance };
-        const double rapSix {rapSquare * rapSquare * rapSquare};
-        //std::cout << epsilonIJ << "  " << squareSigmaIJ << "  " << shiftIJ << "\n";
-        energy += fourEpsilonIJ * rapSix * ( rapSix - 1.) + fourEpsilonIJ * shiftIJ;
-    }
-    return energy;
+        return bondEnergyIJ(style, squareDistance, particleTypeI, particleTypeJ);
+    });
 }
@@ -7,13 +7,17 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <variant>
 #include "../INPUT/Parameter.h"
+#include "PotentialRegistry.h"
 
 class BondPotentials
 {
 
 private:
     const int m_particleTypes {};
+    const BondStyle m_bondStyle {};
+    const int m_nCoeffs {};
     const std::vector<double> m_bondPotentials {};
 
 public:
@@ -23,18 +27,31 @@ public:
 
     explicit BondPotentials (param::Parameter param)
     : m_particleTypes (param.get_int("particleTypes"))
-    , m_bondPotentials(initializeBondPotentials(m_particleTypes))
+    , m_bondStyle (initializeStyle())
+    , m_nCoeffs (getStyleNCoeffs(m_bondStyle))
+    , m_bondPotentials(initializeBondPotentials(m_particleTypes, m_bondStyle))
     {}
 
+    static BondStyle initializeStyle()
+    {
+        param::Parameter potentials("./potentials.txt");
+        return makeStyle<BondStyle>(potentials.get_string("bondStyle", "fene"));
+    }
 
-    static std::vector<double> initializeBondPotentials(int particleTypes)
+    static std::vector<double> initializeBondPotentials(int particleTypes, const BondStyle& bondStyle)
     {
-        const int lenBonds { (particleTypes * (particleTypes + 1)) / 2 * 6};
+        const int nCoeffs {getStyleNCoeffs(bondStyle)};
+        const int lenBonds { (particleTypes * (particleTypes + 1)) / 2 * nCoeffs};
         std::vector<double> bondPotentials(lenBonds);
 
         param::Parameter potentials("./potentials.txt");
         std::string keyBond{"bondCoeff"};
-        std::string delimiter{"|"};
+        std::string defaultCoeff{};
+
+        for (int k = 0; k < nCoeffs; k++)
+        {
+            defaultCoeff.append("0.|");
+        }
 
         for (int i = 1; i <= particleTypes; i++)
         {
@@ -46,53 +63,63 @@ public:
                 const std::string strJ{std::to_string(j)};
                 std::string keyIJ{keyBond};
                 keyIJ.append(strI).append(strJ);
-                std::string bondCoeff{ potentials.get_string(keyIJ, "0.|0.|0.|0.|0.|0.|")};
-                const int indexIJ {(j - i + particleTypes * (i - 1) - ((i - 2) * (i-1)) / 2) * 6};
-                size_t pos;
-                std::string token;
-                std::vector<std::string> coeffList{};
+                const std::vector<double> coeffList {splitCoeffs(potentials.get_string(keyIJ, defaultCoeff))};
+                const int indexIJ {(j - i + particleTypes * (i - 1) - ((i - 2) * (i-1)) / 2) * nCoeffs};
 
-                while ((pos = bondCoeff.find(delimiter)) != std::string::npos)
+                if (static_cast<int>(coeffList.size()) < nCoeffs)
                 {
-                    token = bondCoeff.substr(0, pos);
-                    coeffList.push_back(token);
-                    bondCoeff.erase(0, pos + delimiter.length());
+                    std::cerr << "Not enough coefficients for " << keyIJ << "\n";
+                    std::abort();
                 }
 
-                const double& r0{std::stod(coeffList[1])};
-                bondPotentials[indexIJ + 0] = r0 * r0;// k constant for bond i
-
-
-                bondPotentials[indexIJ + 1] = std::stod(coeffList[0]); // squareR0 constant for bond i
-
-                bondPotentials[indexIJ + 3] = 4 * std::stod(coeffList[2]); // Epsilon constant for bond i
-
-                const double& sigma{std::stod(coeffList[3])};
-                bondPotentials[indexIJ + 4] = sigma * sigma; // square Sigma constant for bond i
-
-                const double& rc{std::stod(coeffList[4])};
-
-                bondPotentials[indexIJ + 2] = rc * rc; // Rc constant for bond i
-
-                bondPotentials[indexIJ + 5] = std::stod(coeffList[5]); // Shift constant for bond i
-
-                //std::cout << i << " "<< j << " "<< indexIJ << " "<< bondPotentials[indexIJ+0] << " "
-                //<< bondPotentials[indexIJ+1] << " "<< bondPotentials[indexIJ+2] << " "<< bondPotentials[indexIJ+3] << "\n" ;
-
+                std::visit([&](const auto& style)
+                {
+                    std::decay_t<decltype(style)>::initializeCoeffs(coeffList, bondPotentials.begin() + indexIJ);
+                }, bondStyle);
             }
         }
 
         return bondPotentials;
     }
 
+    template<typename Function>
+    decltype(auto) visitStyle(Function&& function) const
+    {
+        return std::visit(std::forward<Function>(function), m_bondStyle);
+    }
+
+    template<typename Style>
+    [[nodiscard]] double bondEnergyIJ(const Style&, const double& squareDistance,
+                                      const int& particleTypeI, const int& particleTypeJ) const
+    {
+        return Style::energy(squareDistance, m_bondPotentials.begin() + getIndexIJ(particleTypeI, particleTypeJ));
+    }
+
+    template<typename Style>
+    [[nodiscard]] double bondForceDivR(const Style&, const double& squareDistance,
+                                       const int& particleTypeI, const int& particleTypeJ) const
+    {
+        static_assert(Style::hasForce, "This bond style does not provide a force.");
+        return Style::forceDivR(squareDistance, m_bondPotentials.begin() + getIndexIJ(particleTypeI, particleTypeJ));
+    }
 
-    [[nodiscard]] double feneBondEnergyIJ(const double &squareDistance, const int &particleTypeI,
-                                          const int &particleTypeJ) const;
+    [[nodiscard]] double bondEnergyIJ(const double &squareDistance, const int &particleTypeI,
+                                      const int &particleTypeJ) const;
 
     //[[nodiscard]] std::vector<double> getPotentialsIJ(const int &i, const int &j) const;
 
-    [[nodiscard]] int getIndexIJ(const int &i, const int &j) const;
+    [[nodiscard]] int getIndexIJ(const int &i, const int &j) const
+    {
+        int indexI{ i };
+        int indexJ{ j };
 
-    double getFeneK(const int &i, const int &j) const;
+        if (i > j)
+        {
+            indexI = j;
+            indexJ = i;
+        }
+
+        return m_nCoeffs * ( 2 * indexJ +  indexI + 2 * m_particleTypes * ( indexI - 1) -  indexI * indexI  - 2) / 2;
+    }
 };
 #endif /* BONDPOTENTIALS_H_ */
@@ -0,0 +1,134 @@
+#ifndef BONDSTYLES_H_
+#define BONDSTYLES_H_
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*******************************************************************************
+ * Bond potential plug-ins. They follow the same layout as the pair plug-ins of
+ * PairStyles.h (name, nCoeffs, initializeCoeffs, energy and the optional
+ * forceDivR) but have no cut-off: bonded particles always interact and are
+ * never part of the neighbor list.
+ ******************************************************************************/
+namespace bondStyle
+{
+    // bondCoeffIJ=k|R0|epsilon|sigma|rc|shift|
+    // Kremer-Grest bond: FENE attraction plus a Lennard-Jones repulsion below rc.
+    struct Fene
+    {
+        static constexpr std::string_view name {"fene"};
+        static constexpr int nCoeffs {6};
+        static constexpr bool hasForce {true};
+
+        template<typename OutputIt>
+        static void initializeCoeffs(const std::vector<double>& coeffList, OutputIt coeffIt)
+        {
+            const double& r0 {coeffList[1]};
+            coeffIt[0] = r0 * r0; // squareR0 constant for bond i
+            coeffIt[1] = coeffList[0]; // k constant for bond i
+            const double& rc {coeffList[4]};
+            coeffIt[2] = rc * rc; // Rc constant for bond i
+            coeffIt[3] = 4 * coeffList[2]; // Epsilon constant for bond i
+            const double& sigma {coeffList[3]};
+            coeffIt[4] = sigma * sigma; // square Sigma constant for bond i
+            coeffIt[5] = coeffList[5]; // Shift constant for bond i
+        }
+
+        template<typename InputIt>
+        static double energy(const double& squareDistance, InputIt coeffIt)
+        {
+            double energy {0.};
+            const double& squareR0IJ {coeffIt[0]};
+            const double& feneKI {coeffIt[1]};
+
+            if (feneKI != 0.)
+            {
+                if (squareDistance >= squareR0IJ)
+                {
+                    return std::numeric_limits<double>::infinity();
+                }
+                else
+                {
+                    energy += -0.5 * feneKI * squareR0IJ * std::log(1. - squareDistance / squareR0IJ);
+                }
+            }
+
+            const double& rcSquareIJ {coeffIt[2]};
+
+            if (squareDistance < rcSquareIJ)
+            {
+                const double& fourEpsilonIJ {coeffIt[3]};
+                const double& squareSigmaIJ {coeffIt[4]};
+                const double& shiftIJ {coeffIt[5]};
+                const double rapSquare { squareSigmaIJ / squareDistance };
+                const double rapSix {rapSquare * rapSquare * rapSquare};
+                energy += fourEpsilonIJ * rapSix * ( rapSix - 1.) + fourEpsilonIJ * shiftIJ;
+            }
+            return energy;
+        }
+
+        template<typename InputIt>
+        static double forceDivR(const double& squareDistance, InputIt coeffIt)
+        {
+            double force {0.};
+            const double& squareR0IJ {coeffIt[0]};
+            const double& feneKI {coeffIt[1]};
+
+            if (feneKI != 0.)
+            {
+                force -= feneKI / (1. - squareDistance / squareR0IJ);
+            }
+
+            const double& rcSquareIJ {coeffIt[2]};
+
+            if (squareDistance < rcSquareIJ)
+            {
+                const double& fourEpsilonIJ {coeffIt[3]};
+                const double& squareSigmaIJ {coeffIt[4]};
+                const double rapSquare { squareSigmaIJ / squareDistance };
+                const double rapSix {rapSquare * rapSquare * rapSquare};
+                force += 6. * fourEpsilonIJ * rapSix * (2. * rapSix - 1.) / squareDistance;
+            }
+            return force;
+        }
+    };
+
+    // bondCoeffIJ=k|r0|
+    // u(r) = k / 2 (r - r0)^2
+    struct Harmonic
+    {
+        static constexpr std::string_view name {"harmonic"};
+        static constexpr int nCoeffs {2};
+        static constexpr bool hasForce {true};
+
+        template<typename OutputIt>
+        static void initializeCoeffs(const std::vector<double>& coeffList, OutputIt coeffIt)
+        {
+            coeffIt[0] = coeffList[0];
+            coeffIt[1] = coeffList[1];
+        }
+
+        template<typename InputIt>
+        static double energy(const double& squareDistance, InputIt coeffIt)
+        {
+            const double& kIJ {coeffIt[0]};
+            const double& r0IJ {coeffIt[1]};
+            const double stretch {std::sqrt(squareDistance) - r0IJ};
+            return 0.5 * kIJ * stretch * stretch;
+        }
+
+        template<typename InputIt>
+        static double forceDivR(const double& squareDistance, InputIt coeffIt)
+        {
+            const double& kIJ {coeffIt[0]};
+            const double& r0IJ {coeffIt[1]};
+            const double distance {std::sqrt(squareDistance)};
+            return - kIJ * (distance - r0IJ) / distance;
+        }
+    };
+}
+
+#endif /* BONDSTYLES_H_ */
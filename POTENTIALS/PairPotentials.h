@@ -6,14 +6,21 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <variant>
+#include <cmath>
 #include "INPUT/Parameter.h"
+#include "PotentialRegistry.h"
+#include "types.h"
 
 class PairPotentials
 {
 
 private:
     const int m_nParticleTypes {};
-    const std::vector<double> m_pairPotentials {};
+    const PairStyle m_pairStyle {};
+    const int m_nCoeffs {};
+    const std::vector<Real> m_pairPotentials {};
+    const Real m_nonAdditivity {};   // Non-additivity of the polydisperse mixing rule.
 
 public:
     // POTENTIALS constructor
@@ -21,20 +28,33 @@ public:
 
     explicit PairPotentials (param::Parameter param)
     : m_nParticleTypes (param.get_int( "particleTypes"))
-    , m_pairPotentials (initializePotentials(m_nParticleTypes))
+    , m_pairStyle (initializeStyle())
+    , m_nCoeffs (getStyleNCoeffs(m_pairStyle))
+    , m_pairPotentials (initializePotentials(m_nParticleTypes, m_pairStyle))
+    , m_nonAdditivity (initializeNonAdditivity())
     {
     }
 
+    static Real initializeNonAdditivity()
+    {
+        param::Parameter potentials("./potentials.txt" );
+        return static_cast<Real>(potentials.get_double("nonAdditivity", 0.));
+    }
 
-    static std::vector<double> initializePotentials(int nParticleTypes)
+    static PairStyle initializeStyle()
     {
+        param::Parameter potentials("./potentials.txt" );
+        return makeStyle<PairStyle>(potentials.get_string("pairStyle", "lj"));
+    }
 
+    static std::vector<Real> initializePotentials(int nParticleTypes, const PairStyle& pairStyle)
+    {
+        const int nCoeffs {getStyleNCoeffs(pairStyle)};
         int lenPairs {nParticleTypes * (nParticleTypes + 1) / 2};
-        std::vector<double> pairPotentials (lenPairs * 4) ; //, std::vector<double>(4));
+        std::vector<Real> pairPotentials (lenPairs * nCoeffs) ;
 
         param::Parameter potentials("./potentials.txt" );
         std::string keyPair {"pairCoeff"};
-        std::string delimiter { "|"};
         for (int i=1; i<=nParticleTypes; i++)
         {
             std::string strI { std::to_string(i)};
@@ -44,46 +64,112 @@ public:
                 std::string strJ { std::to_string(j)};
                 std::string keyIJ {keyPair};
                 keyIJ.append(strI).append(strJ);
-                std::string potentialCoeff {potentials.get_string(keyIJ)};
-                const int indexIJ {4 * (j - i + nParticleTypes * (i - 1) - ((i - 2) * (i-1)) / 2)};
-                size_t pos;
-                std::string token;
-                std::vector<std::string> coeffList {};
-
-                while ((pos = potentialCoeff.find(delimiter)) != std::string::npos) {
-                    token = potentialCoeff.substr(0, pos);
-                    coeffList.push_back(token);
-                    potentialCoeff.erase(0, pos + delimiter.length());
-                }
-
+                const std::vector<double> coeffList {splitCoeffs(potentials.get_string(keyIJ))};
+                const int indexIJ {nCoeffs * (j - i + nParticleTypes * (i - 1) - ((i - 2) * (i-1)) / 2)};
 
-                pairPotentials[indexIJ + 1] = 4 * std::stod(coeffList[0]); // Epsilon IJ pair constant
-                const double& sigmaIJ {std::stod(coeffList[1])};
-                pairPotentials[indexIJ + 2] = sigmaIJ * sigmaIJ; // SigmaSquare IJ pair constant
-                const double& rcIJ { std::stod(coeffList[2]) };
-                pairPotentials[indexIJ] = rcIJ * rcIJ; // RcSquare IJ pair constant
-                pairPotentials[indexIJ + 3] = std::stod(coeffList[3]); // Shift IJ
-                /***
-                std::cout << pairPotentials[indexIJ * 4 + 0] << " ";
-                std::cout << pairPotentials[indexIJ * 4 + 1] << " ";
-                std::cout << pairPotentials[indexIJ * 4 + 2] << " ";
-                std::cout << pairPotentials[indexIJ * 4 + 3] << " ";
-                std::cout << "\n";
-                ***/
+                if (static_cast<int>(coeffList.size()) < nCoeffs)
+                {
+                    std::cerr << "Not enough coefficients for " << keyIJ << "\n";
+                    std::abort();
+                }
 
+                std::visit([&](const auto& style)
+                {
+                    std::decay_t<decltype(style)>::initializeCoeffs(coeffList, pairPotentials.begin() + indexIJ);
+                }, pairStyle);
             }
         }
 
         return pairPotentials;
     }
 
+    template<typename Function>
+    decltype(auto) visitStyle(Function&& function) const
+    {
+        return std::visit(std::forward<Function>(function), m_pairStyle);
+    }
+
+    template<typename Style>
+    [[nodiscard]] Real pairEnergy(const Style&, const Real& squareDistance,
+                                  const int& typeI, const int& typeJ) const
+    {
+        const auto it {m_pairPotentials.begin() + getIndexIJ(typeI, typeJ)};
+        const Real& rcSquareIJ { *it};
+
+        if (squareDistance > rcSquareIJ)
+        {
+            return Real{0};
+        }
+        return Style::energy(squareDistance, it);
+    }
+
+    template<typename Style>
+    [[nodiscard]] Real pairForceDivR(const Style&, const Real& squareDistance,
+                                     const int& typeI, const int& typeJ) const
+    {
+        static_assert(Style::hasForce, "This pair style does not provide a force.");
+        const auto it {m_pairPotentials.begin() + getIndexIJ(typeI, typeJ)};
+        const Real& rcSquareIJ { *it};
+
+        if (squareDistance > rcSquareIJ)
+        {
+            return Real{0};
+        }
+        return Style::forceDivR(squareDistance, it);
+    }
+
+    /***************************************************************************
+     * POLYDISPERSE PAIRS
+     * With continuous diameters, the coefficients of the pair of types are
+     * given in units of sigma_ij (sigma = 1 in pairCoeffIJ, rc in units of
+     * sigma_ij) and evaluated at r / sigma_ij, with the mixing rule
+     * sigma_ij = (sigma_i + sigma_j) / 2 (1 - nonAdditivity |sigma_i - sigma_j|).
+     * The rule is computed in the pair loop, there is no per-pair table.
+     **************************************************************************/
+
+    [[nodiscard]] Real getSquareSigmaIJ(const Real& diameterI, const Real& diameterJ) const
+    {
+        const Real sigmaIJ {Real{0.5} * (diameterI + diameterJ)
+                            * (Real{1} - m_nonAdditivity * std::abs(diameterI - diameterJ))};
+        return sigmaIJ * sigmaIJ;
+    }
+
+    template<typename Style>
+    [[nodiscard]] Real pairEnergy(const Style& style, const Real& squareDistance,
+                                  const int& typeI, const int& typeJ, const Real& squareSigmaIJ) const
+    {
+        return pairEnergy(style, squareDistance / squareSigmaIJ, typeI, typeJ);
+    }
+
+    template<typename Style>
+    [[nodiscard]] Real pairForceDivR(const Style& style, const Real& squareDistance,
+                                     const int& typeI, const int& typeJ, const Real& squareSigmaIJ) const
+    {
+        // -(1/r) du/dr = (1 / sigma_ij^2) (-(1/s) du_1/ds) for u(r) = u_1(s), s = r / sigma_ij.
+        return pairForceDivR(style, squareDistance / squareSigmaIJ, typeI, typeJ) / squareSigmaIJ;
+    }
 
-    [[nodiscard]] double ljPairEnergy(const double &squareDistance, const int &typeI, const int &typeJ) const;
+    [[nodiscard]] Real getNonAdditivity() const
+    {
+        return m_nonAdditivity;
+    }
 
+    [[nodiscard]] double pairEnergy(const double &squareDistance, const int &typeI, const int &typeJ) const;
 
     [[nodiscard]] int getParticleTypes() const;
 
-    [[nodiscard]] int getIndexIJ(const int &i, const int &j) const;
+    [[nodiscard]] int getIndexIJ(const int &i, const int &j) const
+    {
+        int indexI{ i };
+        int indexJ{ j };
+
+        if (i > j)
+        {
+            indexI = j;
+            indexJ = i;
+        }
+        return m_nCoeffs * ( 2 * indexJ +  indexI + 2 * m_nParticleTypes * ( indexI - 1) -  indexI * indexI  - 2) / 2;
+    }
 
     [[nodiscard]] double getSquareRcIJ(const int &i, const int &j) const;
 };
@@ -0,0 +1,154 @@
+#ifndef PAIRSTYLES_H_
+#define PAIRSTYLES_H_
+
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*******************************************************************************
+ * Pair potential plug-ins. A plug-in is a stateless struct providing:
+ * - name: key used by "pairStyle" in potentials.txt,
+ * - nCoeffs: number of coefficients stored per pair of particle types,
+ * - initializeCoeffs: converts the "a|b|c|" string of a pairCoeffIJ entry into
+ *   nCoeffs doubles. The first coefficient is always the square of the cut-off
+ *   radius, the neighbor list reads it to build its skin,
+ * - energy: pair energy for distances below the cut-off, evaluated in the
+ *   floating point type of the coefficient table (see Real in types.h),
+ * - hasForce and forceDivR (optional): pair force divided by the distance,
+ *   i.e. -(1/r) du/dr, so that F_ij = forceDivR * r_ij.
+ *
+ * A new plug-in is registered by adding it to the PairStyle variant in
+ * PotentialRegistry.h.
+ ******************************************************************************/
+namespace pairStyle
+{
+    // pairCoeffIJ=epsilon|sigma|rc|shift|
+    // u(r) = 4 epsilon ((sigma/r)^12 - (sigma/r)^6 + shift)
+    struct LennardJones
+    {
+        static constexpr std::string_view name {"lj"};
+        static constexpr int nCoeffs {4};
+        static constexpr bool hasForce {true};
+
+        template<typename OutputIt>
+        static void initializeCoeffs(const std::vector<double>& coeffList, OutputIt coeffIt)
+        {
+            const double& rcIJ {coeffList[2]};
+            coeffIt[0] = rcIJ * rcIJ; // RcSquare IJ pair constant
+            coeffIt[1] = 4 * coeffList[0]; // Epsilon IJ pair constant
+            const double& sigmaIJ {coeffList[1]};
+            coeffIt[2] = sigmaIJ * sigmaIJ; // SigmaSquare IJ pair constant
+            coeffIt[3] = coeffList[3]; // Shift IJ
+        }
+
+        template<typename T, typename InputIt>
+        static T energy(const T& squareDistance, InputIt coeffIt)
+        {
+            const T& fourEpsilonIJ {coeffIt[1]};
+            const T& squareSigmaIJ {coeffIt[2]};
+            const T& shiftIJ {coeffIt[3]};
+            const T rapSquare { squareSigmaIJ / squareDistance };
+            const T rapSix { rapSquare * rapSquare * rapSquare};
+
+            return fourEpsilonIJ * rapSix * ( rapSix - T{1}) + fourEpsilonIJ * shiftIJ;
+        }
+
+        template<typename T, typename InputIt>
+        static T forceDivR(const T& squareDistance, InputIt coeffIt)
+        {
+            const T& fourEpsilonIJ {coeffIt[1]};
+            const T& squareSigmaIJ {coeffIt[2]};
+            const T rapSquare { squareSigmaIJ / squareDistance };
+            const T rapSix { rapSquare * rapSquare * rapSquare};
+
+            return T{6} * fourEpsilonIJ * rapSix * (T{2} * rapSix - T{1}) / squareDistance;
+        }
+    };
+
+    // pairCoeffIJ=epsilon|kappa|rc|shift|
+    // u(r) = epsilon (exp(-kappa r) / r + shift)
+    struct Yukawa
+    {
+        static constexpr std::string_view name {"yukawa"};
+        static constexpr int nCoeffs {4};
+        static constexpr bool hasForce {true};
+
+        template<typename OutputIt>
+        static void initializeCoeffs(const std::vector<double>& coeffList, OutputIt coeffIt)
+        {
+            const double& rcIJ {coeffList[2]};
+            coeffIt[0] = rcIJ * rcIJ;
+            coeffIt[1] = coeffList[0];
+            coeffIt[2] = coeffList[1];
+            coeffIt[3] = coeffList[3];
+        }
+
+        template<typename T, typename InputIt>
+        static T energy(const T& squareDistance, InputIt coeffIt)
+        {
+            const T& epsilonIJ {coeffIt[1]};
+            const T& kappaIJ {coeffIt[2]};
+            const T& shiftIJ {coeffIt[3]};
+            const T distance {std::sqrt(squareDistance)};
+
+            return epsilonIJ * (std::exp(-kappaIJ * distance) / distance + shiftIJ);
+        }
+
+        template<typename T, typename InputIt>
+        static T forceDivR(const T& squareDistance, InputIt coeffIt)
+        {
+            const T& epsilonIJ {coeffIt[1]};
+            const T& kappaIJ {coeffIt[2]};
+            const T distance {std::sqrt(squareDistance)};
+
+            return epsilonIJ * std::exp(-kappaIJ * distance) * (kappaIJ * distance + T{1})
+                   / (squareDistance * distance);
+        }
+    };
+
+    // pairCoeffIJ=epsilon|sigma|n|rc|shift|
+    // u(r) = epsilon ((sigma/r)^n + shift)
+    struct SoftSphere
+    {
+        static constexpr std::string_view name {"soft"};
+        static constexpr int nCoeffs {5};
+        static constexpr bool hasForce {true};
+
+        template<typename OutputIt>
+        static void initializeCoeffs(const std::vector<double>& coeffList, OutputIt coeffIt)
+        {
+            const double& rcIJ {coeffList[3]};
+            coeffIt[0] = rcIJ * rcIJ;
+            coeffIt[1] = coeffList[0];
+            const double& sigmaIJ {coeffList[1]};
+            coeffIt[2] = sigmaIJ * sigmaIJ;
+            coeffIt[3] = coeffList[2] / 2.; // The exponent acts on the square distance.
+            coeffIt[4] = coeffList[4];
+        }
+
+        template<typename T, typename InputIt>
+        static T energy(const T& squareDistance, InputIt coeffIt)
+        {
+            const T& epsilonIJ {coeffIt[1]};
+            const T& squareSigmaIJ {coeffIt[2]};
+            const T& halfExponentIJ {coeffIt[3]};
+            const T& shiftIJ {coeffIt[4]};
+
+            return epsilonIJ * (std::pow(squareSigmaIJ / squareDistance, halfExponentIJ) + shiftIJ);
+        }
+
+        template<typename T, typename InputIt>
+        static T forceDivR(const T& squareDistance, InputIt coeffIt)
+        {
+            const T& epsilonIJ {coeffIt[1]};
+            const T& squareSigmaIJ {coeffIt[2]};
+            const T& halfExponentIJ {coeffIt[3]};
+
+            return T{2} * halfExponentIJ * epsilonIJ * std::pow(squareSigmaIJ / squareDistance, halfExponentIJ)
+                   / squareDistance;
+        }
+    };
+}
+
+#endif /* PAIRSTYLES_H_ */
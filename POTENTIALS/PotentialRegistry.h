@@ -0,0 +1,68 @@
+#ifndef POTENTIALREGISTRY_H_
+#define POTENTIALREGISTRY_H_
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <variant>
+#include <vector>
+#include "PairStyles.h"
+#include "BondStyles.h"
+
+/*******************************************************************************
+ * Registry of the potential plug-ins. The style named in potentials.txt
+ * ("pairStyle" and "bondStyle" keys) is resolved once when the potentials are
+ * built. The energy loops then visit the variant once per neighbor row, so the
+ * plug-in is a compile-time type inside the pair loop.
+ ******************************************************************************/
+using PairStyle = std::variant<pairStyle::LennardJones, pairStyle::Yukawa, pairStyle::SoftSphere>;
+
+using BondStyle = std::variant<bondStyle::Fene, bondStyle::Harmonic>;
+
+
+template<typename StyleVariant, std::size_t Index = 0>
+StyleVariant makeStyle(const std::string& styleName)
+{
+    if constexpr (Index < std::variant_size_v<StyleVariant>)
+    {
+        using Style = std::variant_alternative_t<Index, StyleVariant>;
+
+        if (styleName == Style::name)
+        {
+            return StyleVariant {std::in_place_index<Index>};
+        }
+        return makeStyle<StyleVariant, Index + 1>(styleName);
+    }
+    else
+    {
+        std::cerr << "Unknown potential style: " << styleName << "\n";
+        std::abort();
+    }
+}
+
+inline int getStyleNCoeffs(const PairStyle& style)
+{
+    return std::visit([](const auto& s) { return std::decay_t<decltype(s)>::nCoeffs; }, style);
+}
+
+inline int getStyleNCoeffs(const BondStyle& style)
+{
+    return std::visit([](const auto& s) { return std::decay_t<decltype(s)>::nCoeffs; }, style);
+}
+
+// Splits a "a|b|c|" coefficient string into doubles.
+inline std::vector<double> splitCoeffs(std::string potentialCoeff)
+{
+    const std::string delimiter { "|"};
+    size_t pos;
+    std::vector<double> coeffList {};
+
+    while ((pos = potentialCoeff.find(delimiter)) != std::string::npos)
+    {
+        coeffList.push_back(std::stod(potentialCoeff.substr(0, pos)));
+        potentialCoeff.erase(0, pos + delimiter.length());
+    }
+    return coeffList;
+}
+
+#endif /* POTENTIALREGISTRY_H_ */
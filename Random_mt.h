@@ -10,6 +10,7 @@
 
 #include <chrono>
 #include <random>
+#include <cmath>
 
 // This header-only Random namespace implements a self-seeding Mersenne Twister
 // It can be included into as many code files as needed (The inline keyword avoids ODR violations)
@@ -59,6 +60,37 @@ namespace Random
         return randomVector;
     }
 
+    // Returns a vector of independent normal numbers N(0, standardDeviation^2)
+    inline std::vector<double> normalVectorGenerator(int vectorSize, double standardDeviation)
+    {
+        std::vector<double> randomVector;
+        randomVector.reserve(vectorSize);
+        for (int i=0; i<vectorSize; ++i)
+        {
+            randomVector.push_back(std::normal_distribution<double> {0., standardDeviation}(mt));
+        }
+        return randomVector;
+    }
+
+    // Returns a vector uniformly distributed on the unit sphere
+    inline std::vector<double> unitVectorGenerator(int vectorSize)
+    {
+        std::vector<double> randomVector;
+        randomVector.reserve(vectorSize);
+        double squareNorm {0.};
+        for (int i=0; i<vectorSize; ++i)
+        {
+            randomVector.push_back(std::normal_distribution<double> {0., 1.}(mt));
+            squareNorm += randomVector.back() * randomVector.back();
+        }
+        const double norm {std::sqrt(squareNorm)};
+        for (auto& component : randomVector)
+        {
+            component /= norm;
+        }
+        return randomVector;
+    }
+
     // The following function templates can be used to generate random numbers
     // when min and/or max are not type int
     // See https://www.learncpp.com/cpp-tutorial/function-template-instantiation/
@@ -9,15 +9,30 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <utility>
 #include "unittests.h"
 #include "readSaveFile.h"
 #include "util.h"
 #include "MonteCarlo.h"
 #include "INPUT/Parameter.h"
 #include "NEIGHBORS/Neighbors.h"
+#include "DOMAIN/Domain.h"
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
 
 int main()
 {
+#ifdef USE_MPI
+    MPI_Init(nullptr, nullptr);
+#endif
+    const Domain systemDomain {};
+
+    if (!systemDomain.isRoot())
+    {
+        std::cout.setstate(std::ios_base::badbit); // Only the root rank reports.
+    }
 
     std::string folderPath ( "." );
     //squareDistancePairTest();
@@ -59,8 +74,18 @@ int main()
 
     Neighbors systemNeighbors {param, systemMolecules};
 
+    // unitTests=yes runs the checks of unittests.cpp on the initial configuration instead of the simulation.
+    if (param.get_bool("unitTests", false))
+    {
+        const int nFailures {runUnitTests(param, systemMolecules, systemNeighbors, systemDomain)};
+#ifdef USE_MPI
+        MPI_Finalize();
+#endif
+        return (nFailures == 0) ? 0 : 1;
+    }
 
-    MonteCarlo system {param,  systemMolecules, systemNeighbors, folderPath};
+    // The configuration is moved into the simulation: with a domain decomposition each rank only keeps its slab.
+    MonteCarlo system {param, std::move(systemMolecules), std::move(systemNeighbors), systemDomain, folderPath};
 
 
     system.mcTotal();
@@ -76,5 +101,9 @@ int main()
 	std::cout << "Wall clock time passed: " << wallTime << " seconds; "
 			  << wallTime / 60. << " minutes; " << wallTime / 3600. << " hours\n";
 
+#ifdef USE_MPI
+    MPI_Finalize();
+#endif
+
 	return 0;
 }
@@ -9,13 +9,6 @@
 #define PRESSURE_H
 
 
-double pressureParticle(const double& temp, int indexParticle, const std::vector<double>& positionParticle,
-                        const std::vector<std::vector<double>>& positionArray, const std::vector<int>& neighborIList,
-                        const std::vector<double>& diameterArray, const double& squareRc, const double& lengthCube,
-                        const double& halfLengthCube);
-
-double pressureSystem(const double& temp, const std::vector<std::vector<double>>& positionArray,
-                      const std::vector<double>& diameterArray, const double& squareRc, const double& lengthCube,
-                      const double& halfLengthCube);
+double pressureVirial(const double& temp, const int& nParticles, const double& volume, const double& virial);
 
 #endif /* PRESSURE_H */
@@ -126,6 +126,22 @@ void saveDoubleIntTXT(const double& number1, const int& number2, const std::stri
 
 }
 
+void saveVectorTXT(const std::vector<double>& vec, const std::string& path)
+/*
+ * This function appends a vector as one line of a txt file
+ */
+{
+    std::ofstream fOut;
+    fOut.open(path, std::ios_base::app);
+
+    for (const auto& number : vec)
+    {
+        fOut << number << " ";
+    }
+    fOut << "\n";
+    fOut.close();
+}
+
 void saveDisplacement(const std::vector<std::vector<double>>& dispMatrix, const std::string& path)
 {
     std::ofstream fOut(path);
@@ -7,6 +7,75 @@
 
 #ifndef TYPES_H_
 #define TYPES_H_
+
+#include <type_traits>
+
+// Floating point type of the particle positions and of the pair potential
+// tables. Energies and energy differences are always accumulated in double.
+#ifdef SWAPMC_SINGLE_PRECISION
+using Real = float;
+#else
+using Real = double;
+#endif
+
+// Hot per-particle record read by the energy loops: the position and the
+// particle type of a neighbor share one 16 byte (float) or 32 byte (double)
+// aligned slot, so each neighbor visit touches a single cache line.
+struct alignas(4 * sizeof(Real)) ParticleRecord
+{
+    Real position[3] {};
+    int type {};
+};
+
+// Energy and virial (sum over pairs of r_ij . F_ij) accumulated in the same
+// neighbor pass by the energy loops when the pressure is tracked.
+struct EnergyVirial
+{
+    double energy {};
+    double virial {};
+
+    EnergyVirial& operator+=(const EnergyVirial& other)
+    {
+        energy += other.energy;
+        virial += other.virial;
+        return *this;
+    }
+
+    EnergyVirial& operator-=(const EnergyVirial& other)
+    {
+        energy -= other.energy;
+        virial -= other.virial;
+        return *this;
+    }
+};
+
+inline EnergyVirial operator+(EnergyVirial first, const EnergyVirial& second)
+{
+    return first += second;
+}
+
+inline EnergyVirial operator-(EnergyVirial first, const EnergyVirial& second)
+{
+    return first -= second;
+}
+
+// Return type of the energy loops: the energy alone, or the energy and the virial.
+template<bool WithVirial>
+using EnergyResult = std::conditional_t<WithVirial, EnergyVirial, double>;
+
+template<bool WithVirial>
+EnergyResult<WithVirial> makeEnergyResult(const double& energy, [[maybe_unused]] const double& virial)
+{
+    if constexpr (WithVirial)
+    {
+        return EnergyVirial {energy, virial};
+    }
+    else
+    {
+        return energy;
+    }
+}
+
 /***
 template <typename T>
 using Vector1d = std::vector<T>;
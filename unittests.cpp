@@ -6,9 +6,24 @@
  */
 
 #include <iostream>
+#include <string>
+#include <utility>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <numeric>
 #include "Random_mt.h"
 #include "util.h"
+#include "unittests.h"
+#include "MOVES/MoveRegistry.h"
+#include "MonteCarlo.h"
+#include "MINIMIZER/Minimizer.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 /***
 int squareDistancePairTest()
@@ -97,5 +112,1282 @@ void randomGeneratorTest()
 	randomIntGeneratorTest();
 }
 
+/*******************************************************************************
+ * This function draws from alias tables (see MoveRegistry.h) and compares the
+ * frequencies with the normalized weights: a zero weight must never be drawn
+ * and the other frequencies must be within 5 standard deviations.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int aliasTableTest()
+{
+    constexpr int nDraws {1000000};
+    const std::vector<std::vector<double>> weightTable {{1.}, {0.5, 0., 2., 1., 0., 0.25}, {0., 3.}, {1., 1., 1.}};
+    int nFailures {0};
+
+    for (const auto& weightArray : weightTable)
+    {
+        const AliasTable aliasTable {weightArray};
+        const int nColumns {static_cast<int>(weightArray.size())};
+        std::vector<int> countArray (nColumns, 0);
+        double sumWeight {0.};
+
+        for (const double& weight : weightArray)
+        {
+            sumWeight += weight;
+        }
+
+        for (int k = 0; k < nDraws; k++)
+        {
+            ++countArray[aliasTable.sample(Random::doubleGenerator(0., nColumns))];
+        }
+
+        for (int k = 0; k < nColumns; k++)
+        {
+            const double probability {weightArray[k] / sumWeight};
+            const double sigma {std::sqrt(probability * (1. - probability) / nDraws)};
+            const double frequency {static_cast<double>(countArray[k]) / nDraws};
+            const bool failed {(probability == 0.) ? countArray[k] != 0
+                                                   : std::fabs(frequency - probability) > 5. * sigma + 1e-12};
+            if (failed)
+            {
+                std::cout << "aliasTableTest: column " << k << " of " << nColumns << " drawn with frequency "
+                          << frequency << " instead of " << probability << "\n";
+                ++nFailures;
+            }
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function returns a copy of param with the given keys set, so that a
+ * test can enable the move it checks on the configuration of the run.
+ ******************************************************************************/
+param::Parameter setKeys(param::Parameter param, const std::vector<std::pair<std::string, std::string>>& keyArray)
+{
+    for (const auto& [key, value] : keyArray)
+    {
+        param.set(key, value);
+    }
+    return param;
+}
+
+/*******************************************************************************
+ * This function compares the running energy of system with a full recompute
+ * after nMoves calls of moveFunction, the neighbor list being checked after
+ * each one as at the end of a time step. The tolerance is the default
+ * energyDriftTolerance per particle.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+template<typename MoveFunction>
+int moveEnergyTest(const std::string& name, MonteCarlo& system, const int& nMoves, MoveFunction moveFunction)
+{
+    constexpr double tolerance {1e-6};
 
+    for (int k = 0; k < nMoves; k++)
+    {
+        moveFunction();
+        system.checkNeighbors();
+    }
+    const Molecules& systemMolecules {system.getMolecules()};
+    const double energy {systemMolecules.energySystemMolecule(system.getNeighbors())};
+
+    if (std::fabs(system.getEnergy() - energy) > tolerance * systemMolecules.getNParticles())
+    {
+        std::cout.precision(15);
+        std::cout << name << ": running energy " << system.getEnergy() << ", recomputed " << energy << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ * This function runs time steps of the move mix of inputVar.txt through the
+ * registry (MonteCarlo::mcMove) and checks the running energy.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int moveMixTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                const Domain& systemDomain)
+{
+    constexpr int nSteps {20};
+    MonteCarlo system {param, systemMolecules, systemNeighbors, systemDomain, "."};
+
+    return moveEnergyTest("moveMixTest", system, nSteps, [&]()
+    {
+        int j {0};
+
+        while (j < systemMolecules.getNParticles())
+        {
+            j += system.mcMove();
+        }
+        system.mcPendingTranslations();
+    });
+}
+
+/*******************************************************************************
+ * This function compares the swap energy differences of the type-resolved
+ * energy cache (Molecules::energySwapTypeEnergy) with the difference of the
+ * system energy before and after swapping the types, for random pairs of
+ * particles of different types, then checks the running energy of swap moves
+ * evaluated from the cache.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int swapTypeEnergyTest(const param::Parameter& param, const Molecules& systemMolecules,
+                       const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    constexpr int nSwaps {100};
+    constexpr double tolerance {1e-6};
+    const int nParticles {systemMolecules.getNParticles()};
+    int nFailures {0};
+
+    if (systemMolecules.getNParticleTypes() < 2 || systemMolecules.isPolydisperse())
+    {
+        return 0;
+    }
+    Molecules swapMolecules {systemMolecules};
+    swapMolecules.initializeTypeEnergy(systemNeighbors);
+    const double energy {swapMolecules.energySystemMolecule(systemNeighbors)};
+
+    for (int k = 0; k < nSwaps; k++)
+    {
+        const int i {Random::intGenerator(0, nParticles - 1)};
+        const int j {Random::intGenerator(0, nParticles - 1)};
+
+        if (swapMolecules.getParticleTypeI(i) == swapMolecules.getParticleTypeI(j))
+        {
+            continue;
+        }
+        const double cacheDiffEnergy {swapMolecules.energySwapTypeEnergy(i, j)};
+        swapMolecules.swapParticleTypesIJ(i, j);
+        const double diffEnergy {swapMolecules.energySystemMolecule(systemNeighbors) - energy};
+        swapMolecules.swapParticleTypesIJ(i, j);
+
+        if (std::fabs(cacheDiffEnergy - diffEnergy) > tolerance * (1. + std::fabs(diffEnergy)))
+        {
+            std::cout << "swapTypeEnergyTest: swap of " << i << " and " << j << " gives " << cacheDiffEnergy
+                      << " from the cache and " << diffEnergy << " directly\n";
+            ++nFailures;
+        }
+    }
+
+    MonteCarlo system {setKeys(param, {{"swap", "yes"}, {"swapEnergyCache", "yes"}, {"swapMode", "molecule"}}),
+                       systemMolecules, systemNeighbors, systemDomain, "."};
+    nFailures += moveEnergyTest("swapTypeEnergyTest", system, 10 * nParticles, [&]() { system.mcSwap(); });
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks that the full-system reductions (see
+ * Molecules::reduceParticles) give bitwise identical energies and virials
+ * for 1 to omp_get_max_threads() threads (at least 4).
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int reduceParticlesTest([[maybe_unused]] const Molecules& systemMolecules,
+                        [[maybe_unused]] const Neighbors& systemNeighbors)
+{
+    int nFailures {0};
+#ifdef _OPENMP
+    const int maxThreads {omp_get_max_threads()};
+    omp_set_num_threads(1);
+    const double energy {systemMolecules.energySystemMolecule(systemNeighbors)};
+    const double virial {systemMolecules.virialSystemMolecule(systemNeighbors)};
+
+    for (int nThreads = 2; nThreads <= std::max(maxThreads, 4); nThreads++)
+    {
+        omp_set_num_threads(nThreads);
+        const double energyThreads {systemMolecules.energySystemMolecule(systemNeighbors)};
+        const double virialThreads {systemMolecules.virialSystemMolecule(systemNeighbors)};
+
+        if (energyThreads != energy || virialThreads != virial)
+        {
+            std::cout.precision(17);
+            std::cout << "reduceParticlesTest: energy " << energyThreads << " and virial " << virialThreads
+                      << " with " << nThreads << " threads, " << energy << " and " << virial << " with 1 thread\n";
+            ++nFailures;
+        }
+    }
+    omp_set_num_threads(maxThreads);
+#endif
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the running energy after molecule rotations, pivots
+ * and crankshaft moves, each move type on its own.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int chainMoveTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                  const Domain& systemDomain)
+{
+    const int nMoves {systemMolecules.getNParticles()};
+    const param::Parameter chainParam {setKeys(param, {{"molRotation", "yes"}, {"pivot", "yes"},
+                                                       {"crankshaft", "yes"}})};
+    int nFailures {0};
+
+    MonteCarlo rotationSystem {chainParam, systemMolecules, systemNeighbors, systemDomain, "."};
+    nFailures += moveEnergyTest("chainMoveTest (rotation)", rotationSystem, nMoves,
+                                [&]() { rotationSystem.mcMoleculeRotation(); });
+    MonteCarlo pivotSystem {chainParam, systemMolecules, systemNeighbors, systemDomain, "."};
+    nFailures += moveEnergyTest("chainMoveTest (pivot)", pivotSystem, nMoves, [&]() { pivotSystem.mcPivot(); });
+    MonteCarlo crankshaftSystem {chainParam, systemMolecules, systemNeighbors, systemDomain, "."};
+    nFailures += moveEnergyTest("chainMoveTest (crankshaft)", crankshaftSystem, nMoves,
+                                [&]() { crankshaftSystem.mcCrankshaft(); });
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function returns, for each bond i-j (i < j) in order, the number of
+ * box lengths between the unwrapped and the minimum image bond vectors. It
+ * only changes if the image counters of a moved particle are wrong.
+ ******************************************************************************/
+std::vector<long> bondImageArray(const Molecules& systemMolecules)
+{
+    constexpr int nDims {3};
+    const std::vector<double> unwrappedArray {systemMolecules.getUnwrappedPositionArray()};
+    const double lengthCube {systemMolecules.getLengthCube()};
+    std::vector<long> imageArray {};
+
+    for (int i = 0; i < systemMolecules.getNParticles(); i++)
+    {
+        for (auto bondIt = systemMolecules.getBondsItBeginI(i); bondIt < systemMolecules.getBondsItEndI(i); ++bondIt)
+        {
+            if (*bondIt < i)
+            {
+                continue;
+            }
+
+            for (int d = 0; d < nDims; d++)
+            {
+                const double unwrappedDiff {unwrappedArray[nDims * *bondIt + d] - unwrappedArray[nDims * i + d]};
+                const double diff {systemMolecules.getPosItBeginI(*bondIt)[d] - systemMolecules.getPosItBeginI(i)[d]};
+                imageArray.push_back(std::lround((unwrappedDiff - diff + lengthCube * std::round(diff / lengthCube))
+                                                 / lengthCube));
+            }
+        }
+    }
+    return imageArray;
+}
+
+/*******************************************************************************
+ * This function checks the running energy after configurational-bias
+ * regrowths of up to 3 beads, then the image counters: the unwrapped bond
+ * vectors must still be the minimum image ones up to their initial box
+ * offsets (see bondImageArray).
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int regrowthTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                 const Domain& systemDomain)
+{
+    MonteCarlo system {setKeys(param, {{"regrowth", "yes"}, {"cbmcMaxBeads", "3"}}), systemMolecules,
+                       systemNeighbors, systemDomain, "."};
+    int nFailures {moveEnergyTest("regrowthTest", system, systemMolecules.getNParticles(),
+                                  [&]() { system.mcRegrowth(); })};
+
+    if (bondImageArray(system.getMolecules()) != bondImageArray(systemMolecules))
+    {
+        std::cout << "regrowthTest: image counters inconsistent with the bonds\n";
+        ++nFailures;
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the running energy after multiple-try translations
+ * with 8 trials.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int multipleTryTest(const param::Parameter& param, const Molecules& systemMolecules,
+                    const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    MonteCarlo system {setKeys(param, {{"mtmTrials", "8"}}), systemMolecules, systemNeighbors, systemDomain, "."};
+    return moveEnergyTest("multipleTryTest", system, systemMolecules.getNParticles(),
+                          [&]() { system.mcTranslationMultipleTry(); });
+}
+
+/*******************************************************************************
+ * This function checks the running energy after batch translations, and that
+ * every particle moves when the grid has an odd number of cells per side.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int batchTranslationTest(const param::Parameter& param, const Molecules& systemMolecules,
+                         const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    constexpr int nDims {3};
+    constexpr int nBatches {8000};
+    MonteCarlo system {setKeys(param, {{"batchTranslation", "yes"}}), systemMolecules, systemNeighbors,
+                       systemDomain, "."};
+
+    if (!system.getNeighbors().hasSublattices())
+    {
+        return 0;
+    }
+    int nFailures {moveEnergyTest("batchTranslationTest", system, nBatches,
+                                  [&]() { system.mcBatchTranslation(); })};
+
+    if (system.getNeighbors().getNumCell() % 2 == 1)
+    {
+        const std::vector<double> initialArray {systemMolecules.getUnwrappedPositionArray()};
+        const std::vector<double> movedArray {system.getMolecules().getUnwrappedPositionArray()};
+        int nUnmoved {0};
+
+        for (int i = 0; i < systemMolecules.getNParticles(); i++)
+        {
+            nUnmoved += std::equal(movedArray.begin() + nDims * i, movedArray.begin() + nDims * (i + 1),
+                                   initialArray.begin() + nDims * i);
+        }
+
+        if (nUnmoved > 0)
+        {
+            std::cout << "batchTranslationTest: " << nUnmoved << " particles never moved\n";
+            ++nFailures;
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the running energy after speculative translations on
+ * 4 worker threads.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int speculativeTranslationTest(const param::Parameter& param, const Molecules& systemMolecules,
+                               const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    constexpr int nSteps {20};
+    MonteCarlo system {setKeys(param, {{"speculativeThreads", "4"}}), systemMolecules, systemNeighbors,
+                       systemDomain, "."};
+    return moveEnergyTest("speculativeTranslationTest", system, nSteps,
+                          [&]() { system.mcSpeculativeTranslations(systemMolecules.getNParticles()); });
+}
+
+/*******************************************************************************
+ * This function checks the domain decomposition against the serial energy: at
+ * the start, and after translations with particle migrations, the energy of
+ * the slabs must equal the energy of the whole configuration gathered on the
+ * root rank. It is meant to run on 4 ranks (mpirun -np 4 with USE_MPI and
+ * unitTests=yes), and checks the single slab case otherwise.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int domainDecompositionTest(const param::Parameter& param, const Molecules& systemMolecules,
+                            const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    constexpr int maxSteps {500};
+    constexpr int nMigrations {2};
+
+    if (!systemNeighbors.hasSublattices() || systemNeighbors.getNumCell() < systemDomain.getNRanks())
+    {
+        return 0;
+    }
+    // Only the translations and the outputs are distributed.
+    const param::Parameter domainParam {setKeys(param, {{"domainDecomposition", "yes"}, {"swap", "no"},
+                                                        {"molTranslation", "no"}, {"molRotation", "no"},
+                                                        {"pivot", "no"}, {"crankshaft", "no"}, {"regrowth", "no"},
+                                                        {"volumeMove", "no"}, {"hybrid", "no"}, {"mutation", "no"},
+                                                        {"mtmTrials", "1"}, {"batchTranslation", "no"},
+                                                        {"speculativeThreads", "0"}, {"quench", "no"},
+                                                        {"widomRate", "0"}, {"saveDisplacement", "no"},
+                                                        {"saveParticleEnergy", "no"}})};
+    const int nParticles {systemMolecules.getNParticles()};
+    const double tolerance {1e-9 * nParticles};
+    MonteCarlo system {domainParam, systemMolecules, systemNeighbors, systemDomain, "."};
+    int nFailures {0};
+
+    const double serialEnergy {systemMolecules.energySystemMolecule(systemNeighbors)};
+    if (!(std::abs(system.getEnergy() - serialEnergy) <= tolerance))
+    {
+        std::cout << "domainDecompositionTest: initial energy " << system.getEnergy() << " instead of "
+                  << serialEnergy << "\n";
+        ++nFailures;
+    }
+
+    // The neighbor list rebuilds migrate the particles between the slabs.
+    const int initialUpdates {system.getNeighbors().getUpdateRate()};
+    int step {0};
+
+    while (step < maxSteps && system.getNeighbors().getUpdateRate() < initialUpdates + nMigrations)
+    {
+        int j {0};
+        while (j < nParticles)
+        {
+            j += system.mcMove();
+        }
+        system.mcPendingTranslations();
+        system.checkNeighbors();
+        ++step;
+    }
+
+    if (system.getNeighbors().getUpdateRate() < initialUpdates + nMigrations)
+    {
+        std::cout << "domainDecompositionTest: no migration in " << maxSteps << " steps\n";
+        ++nFailures;
+    }
+    const double domainEnergy {system.getEnergy()};
+    const Molecules wholeMolecules {system.gatherMolecules()};
+
+    if (systemDomain.isRoot())
+    {
+        const Neighbors wholeNeighbors {domainParam, wholeMolecules};
+        const double wholeEnergy {wholeMolecules.energySystemMolecule(wholeNeighbors)};
+
+        if (wholeMolecules.getNParticles() != nParticles || !(std::abs(domainEnergy - wholeEnergy) <= tolerance))
+        {
+            std::cout << "domainDecompositionTest: energy " << domainEnergy << " instead of " << wholeEnergy
+                      << " for " << wholeMolecules.getNParticles() << " particles\n";
+            ++nFailures;
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the volume moves. With the particles frozen in reduced
+ * coordinates, the volume moves alone sample ln(V) with the weight
+ * exp(-(U + P V) / T + (N + 1) ln(V)), computed on a grid by rescaling the
+ * configuration: the sampled mean and variance of ln(V) must match it. The
+ * pressure is chosen so that the weight peaks at the initial volume. The
+ * running energy is then checked for volume moves mixed with the other moves.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int volumeMoveTest(const param::Parameter& param, const Molecules& systemMolecules,
+                   const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    constexpr int nVolumeMoves {4000};
+    constexpr int nGrid {121};
+    constexpr double gridWidth {6.};       // Half width of the grid in standard deviations of ln(V).
+    constexpr double lnVolumeStep {1e-3};
+    constexpr int nSteps {5};
+    const double temp {param::Parameter {param}.get_double("temp", 2.)};
+    const int nParticles {systemMolecules.getNParticles()};
+    const double initialVolume {std::pow(systemMolecules.getLengthCube(), 3)};
+
+    // Energy of the configuration rescaled to the volume initialVolume * exp(lnVolumeChange).
+    const auto scaledEnergy {[&](const double& lnVolumeChange)
+    {
+        Molecules scaledMolecules {systemMolecules};
+        scaledMolecules.rescaleBox(std::exp(lnVolumeChange / 3.));
+        const Neighbors scaledNeighbors {param, scaledMolecules};
+        return scaledMolecules.energySystemMolecule(scaledNeighbors);
+    }};
+    const double energy {scaledEnergy(0.)};
+    const double energyPlus {scaledEnergy(lnVolumeStep)};
+    const double energyMinus {scaledEnergy(-lnVolumeStep)};
+    const double derivative {(energyPlus - energyMinus) / (2. * lnVolumeStep)};
+    const double secondDerivative {(energyPlus - 2. * energy + energyMinus) / (lnVolumeStep * lnVolumeStep)};
+    const double pressure {((nParticles + 1) * temp - derivative) / initialVolume};
+    const double curvature {(secondDerivative + pressure * initialVolume) / temp};
+
+    if (!(pressure > 0.) || !(curvature > 0.))
+    {
+        std::cout << "volumeMoveTest: skipped, the configuration is not mechanically stable\n";
+        return 0;
+    }
+    const double sigma {1. / std::sqrt(curvature)};
+
+    // Reference mean and variance of ln(V / initialVolume).
+    std::vector<double> lnVolumeArray (nGrid);
+    std::vector<double> lnWeightArray (nGrid);
+
+    for (int k = 0; k < nGrid; k++)
+    {
+        lnVolumeArray[k] = gridWidth * sigma * (2. * k / (nGrid - 1) - 1.);
+        lnWeightArray[k] = -(scaledEnergy(lnVolumeArray[k]) + pressure * initialVolume * std::exp(lnVolumeArray[k]))
+                           / temp + (nParticles + 1) * lnVolumeArray[k];
+    }
+    const double maxLnWeight {*std::max_element(lnWeightArray.begin(), lnWeightArray.end())};
+    double sumWeight {0.};
+    double sumLnVolume {0.};
+    double sumSquareLnVolume {0.};
+
+    for (int k = 0; k < nGrid; k++)
+    {
+        const double weight {std::exp(lnWeightArray[k] - maxLnWeight)};
+        sumWeight += weight;
+        sumLnVolume += weight * lnVolumeArray[k];
+        sumSquareLnVolume += weight * lnVolumeArray[k] * lnVolumeArray[k];
+    }
+    const double referenceMean {sumLnVolume / sumWeight};
+    const double referenceVariance {sumSquareLnVolume / sumWeight - referenceMean * referenceMean};
+
+    // The acceptance rate is reasonable when the largest change of ln(V) is a few standard deviations.
+    const param::Parameter volumeParam {setKeys(param, {{"volumeMove", "yes"}, {"pressure", std::to_string(pressure)},
+                                                        {"maxLnVolume", std::to_string(3. * sigma)}})};
+    MonteCarlo volumeSystem {volumeParam, systemMolecules, systemNeighbors, systemDomain, "."};
+    double sumSample {0.};
+    double sumSquareSample {0.};
+
+    for (int k = 0; k < nVolumeMoves; k++)
+    {
+        volumeSystem.mcVolume();
+        const double lnVolume {3. * std::log(volumeSystem.getMolecules().getLengthCube()
+                                             / systemMolecules.getLengthCube())};
+        sumSample += lnVolume;
+        sumSquareSample += lnVolume * lnVolume;
+    }
+    const double sampleMean {sumSample / nVolumeMoves};
+    const double sampleVariance {sumSquareSample / nVolumeMoves - sampleMean * sampleMean};
+    int nFailures {0};
+
+    if (std::fabs(sampleMean - referenceMean) > 0.2 * sigma
+        || std::fabs(sampleVariance / referenceVariance - 1.) > 0.3)
+    {
+        std::cout << "volumeMoveTest: ln(V) mean " << sampleMean << " and variance " << sampleVariance
+                  << " instead of " << referenceMean << " and " << referenceVariance << "\n";
+        ++nFailures;
+    }
+
+    MonteCarlo system {setKeys(volumeParam, {{"pVolume", "0.01"}}), systemMolecules, systemNeighbors,
+                       systemDomain, "."};
+    nFailures += moveEnergyTest("volumeMoveTest", system, nSteps, [&]()
+    {
+        int j {0};
+
+        while (j < nParticles)
+        {
+            j += system.mcMove();
+        }
+        system.mcPendingTranslations();
+    });
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the running virial (calcPressure=yes) against a full
+ * recompute after translations, swaps, molecule translations and rotations,
+ * pivots and crankshaft moves, each move type on its own.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int virialTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+               const Domain& systemDomain)
+{
+    constexpr double tolerance {1e-6};
+    const int nMoves {systemMolecules.getNParticles()};
+    const param::Parameter virialParam {setKeys(param, {{"calcPressure", "yes"}, {"virialCheckRate", "0"},
+                                                        {"swap", "yes"}, {"molTranslation", "yes"},
+                                                        {"molRotation", "yes"}, {"pivot", "yes"},
+                                                        {"crankshaft", "yes"}})};
+    int nFailures {0};
+
+    const auto virialMoveTest {[&](const std::string& name, const auto& moveFunction)
+    {
+        MonteCarlo system {virialParam, systemMolecules, systemNeighbors, systemDomain, "."};
+
+        for (int k = 0; k < nMoves; k++)
+        {
+            moveFunction(system);
+            system.checkNeighbors();
+        }
+        const double virial {system.getMolecules().virialSystemMolecule(system.getNeighbors())};
+
+        if (std::fabs(system.getVirial() - virial) > tolerance * nMoves)
+        {
+            std::cout.precision(15);
+            std::cout << "virialTest (" << name << "): running virial " << system.getVirial() << ", recomputed "
+                      << virial << "\n";
+            ++nFailures;
+        }
+    }};
+    virialMoveTest("translation", [](MonteCarlo& system) { system.mcTranslation(); });
+    virialMoveTest("swap", [](MonteCarlo& system) { system.mcSwap(); });
+    virialMoveTest("molecule translation", [](MonteCarlo& system) { system.mcMoleculeTranslation(); });
+    virialMoveTest("rotation", [](MonteCarlo& system) { system.mcMoleculeRotation(); });
+    virialMoveTest("pivot", [](MonteCarlo& system) { system.mcPivot(); });
+    virialMoveTest("crankshaft", [](MonteCarlo& system) { system.mcCrankshaft(); });
+    return nFailures;
+}
 
+/*******************************************************************************
+ * This function checks the diameter swaps of a polydisperse configuration
+ * (polydisperse=yes): the running energy and virial must match a full
+ * recompute, and the swaps must only permute the diameters. It is skipped for
+ * discrete types.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int diameterSwapTest(const param::Parameter& param, const Molecules& systemMolecules,
+                     const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    if (!systemMolecules.isPolydisperse())
+    {
+        return 0;
+    }
+    const int nParticles {systemMolecules.getNParticles()};
+    MonteCarlo system {setKeys(param, {{"swap", "yes"}, {"calcPressure", "yes"}, {"virialCheckRate", "0"}}),
+                       systemMolecules, systemNeighbors, systemDomain, "."};
+    int nFailures {moveEnergyTest("diameterSwapTest", system, 10 * nParticles,
+                                  [&]() { system.mcDiameterSwap(); })};
+
+    const double virial {system.getMolecules().virialSystemMolecule(system.getNeighbors())};
+    if (std::fabs(system.getVirial() - virial) > 1e-6 * nParticles)
+    {
+        std::cout << "diameterSwapTest: running virial " << system.getVirial() << ", recomputed " << virial << "\n";
+        ++nFailures;
+    }
+
+    std::vector<Real> initialArray (nParticles);
+    std::vector<Real> swappedArray (nParticles);
+    for (int i = 0; i < nParticles; i++)
+    {
+        initialArray[i] = systemMolecules.getDiameterI(i);
+        swappedArray[i] = system.getMolecules().getDiameterI(i);
+    }
+    const bool isPermuted {initialArray != swappedArray};
+    std::sort(initialArray.begin(), initialArray.end());
+    std::sort(swappedArray.begin(), swappedArray.end());
+
+    if (!isPermuted || initialArray != swappedArray)
+    {
+        std::cout << "diameterSwapTest: the swaps do not permute the diameters\n";
+        ++nFailures;
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the type buckets of the non-local swaps after random
+ * swapParticleTypesIJ and setParticleTypeI calls on a copy of the configuration:
+ * every particle must be listed once, in the bucket of its type.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int typeBucketTest(const Molecules& initialMolecules)
+{
+    Molecules systemMolecules {initialMolecules};
+    constexpr int nChanges {10000};
+    const int nParticles {systemMolecules.getNParticles()};
+    const int nParticleTypes {systemMolecules.getNParticleTypes()};
+    int nFailures {0};
+
+    systemMolecules.initializeTypeBuckets();
+
+    for (int k = 0; k < nChanges; k++)
+    {
+        const int i {Random::intGenerator(0, nParticles - 1)};
+
+        if (Random::intGenerator(0, 1) == 0)
+        {
+            systemMolecules.swapParticleTypesIJ(i, Random::intGenerator(0, nParticles - 1));
+        }
+        else
+        {
+            systemMolecules.setParticleTypeI(i, Random::intGenerator(1, nParticleTypes));
+        }
+    }
+
+    std::vector<int> listedArray (nParticles, 0);
+
+    for (int type = 1; type <= nParticleTypes; type++)
+    {
+        for (int k = 0; k < systemMolecules.getTypeBucketSize(type); k++)
+        {
+            const int indexParticle {systemMolecules.getTypeBucketParticle(type, k)};
+            ++listedArray[indexParticle];
+
+            if (systemMolecules.getParticleTypeI(indexParticle) != type)
+            {
+                std::cout << "typeBucketTest: particle " << indexParticle << " of type "
+                          << systemMolecules.getParticleTypeI(indexParticle) << " in the bucket of type " << type
+                          << "\n";
+                ++nFailures;
+            }
+        }
+    }
+
+    for (int i = 0; i < nParticles; i++)
+    {
+        if (listedArray[i] != 1)
+        {
+            std::cout << "typeBucketTest: particle " << i << " listed " << listedArray[i] << " times\n";
+            ++nFailures;
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the running energy after non-local swaps, with the
+ * partners drawn from the type buckets (swapMode=global) and among the
+ * neighbors (swapMode=neighbor). The swaps must not change the type counts.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int nonLocalSwapTest(const param::Parameter& param, const Molecules& systemMolecules,
+                     const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    const int nParticles {systemMolecules.getNParticles()};
+    const int nParticleTypes {systemMolecules.getNParticleTypes()};
+    int nFailures {0};
+
+    if (nParticleTypes < 2 || systemMolecules.isPolydisperse())
+    {
+        return 0;
+    }
+
+    const auto countType {[&](const Molecules& molecules, const int& type)
+    {
+        int nType {0};
+
+        for (int i = 0; i < nParticles; i++)
+        {
+            nType += molecules.getParticleTypeI(i) == type ? 1 : 0;
+        }
+        return nType;
+    }};
+
+    for (const std::string swapMode : {"global", "neighbor"})
+    {
+        const std::string name {"nonLocalSwapTest (" + swapMode + ")"};
+        MonteCarlo system {setKeys(param, {{"swap", "yes"}, {"swapMode", swapMode}}), systemMolecules,
+                           systemNeighbors, systemDomain, "."};
+        nFailures += moveEnergyTest(name, system, 10 * nParticles, [&]() { system.mcNonLocalSwap(); });
+
+        for (int type = 1; type <= nParticleTypes; type++)
+        {
+            if (countType(system.getMolecules(), type) != countType(systemMolecules, type))
+            {
+                std::cout << name << ": the swaps changed the number of particles of type " << type << "\n";
+                ++nFailures;
+            }
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the running energy and virial after type mutations,
+ * with the energy differences from the neighbor loop and from the type
+ * energy cache (swapEnergyCache).
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int mutationTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                 const Domain& systemDomain)
+{
+    const int nParticles {systemMolecules.getNParticles()};
+    int nFailures {0};
+
+    if (systemMolecules.getNParticleTypes() < 2 || systemMolecules.isPolydisperse())
+    {
+        return 0;
+    }
+
+    for (const std::string swapEnergyCache : {"no", "yes"})
+    {
+        const std::string name {"mutationTest (swapEnergyCache=" + swapEnergyCache + ")"};
+        MonteCarlo system {setKeys(param, {{"mutation", "yes"}, {"swapEnergyCache", swapEnergyCache},
+                                           {"calcPressure", "yes"}, {"virialCheckRate", "0"}}),
+                           systemMolecules, systemNeighbors, systemDomain, "."};
+        nFailures += moveEnergyTest(name, system, nParticles, [&]() { system.mcMutation(); });
+        const double virial {system.getMolecules().virialSystemMolecule(system.getNeighbors())};
+
+        if (std::fabs(system.getVirial() - virial) > 1e-6 * nParticles)
+        {
+            std::cout << name << ": running virial " << system.getVirial() << ", recomputed " << virial << "\n";
+            ++nFailures;
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the Hybrid Monte Carlo trajectories. A trajectory run
+ * again from its final momenta reversed must come back to the initial
+ * positions, with the momenta reversed. The change of U + K must decrease at
+ * least twice when the time step is halved, as for a second order integrator
+ * (four times asymptotically). The running energy is then checked after
+ * hybrid moves.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int hybridTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+               const Domain& systemDomain)
+{
+    constexpr double tolerance {1e-4};
+    constexpr int nSteps {10};
+    constexpr double timeStep {0.005};
+    constexpr int nMoves {20};
+    const int nParticles {systemMolecules.getNParticles()};
+    const double temp {param::Parameter {param}.get_double("temp", 2.)};
+    const std::vector<double> initialArray {systemMolecules.getUnwrappedPositionArray()};
+    const std::vector<double> initialMomentumArray {
+            Random::normalVectorGenerator(static_cast<int>(initialArray.size()), std::sqrt(temp))};
+    int nFailures {0};
+
+    const auto kineticEnergy {[](const std::vector<double>& momentumArray)
+    {
+        return std::inner_product(momentumArray.begin(), momentumArray.end(), momentumArray.begin(), 0.) / 2.;
+    }};
+    // Change of U + K along a trajectory of system, the momenta being reversed at the end.
+    const auto trajectory {[&](MonteCarlo& system, std::vector<double>& momentumArray)
+    {
+        const double initialKineticEnergy {kineticEnergy(momentumArray)};
+        const auto [initialEnergy, finalEnergy] {system.hybridTrajectory(momentumArray)};
+        std::transform(momentumArray.begin(), momentumArray.end(), momentumArray.begin(), std::negate<>());
+        return finalEnergy + kineticEnergy(momentumArray) - initialEnergy - initialKineticEnergy;
+    }};
+
+    MonteCarlo system {setKeys(param, {{"hybrid", "yes"}, {"hybridSteps", std::to_string(nSteps)},
+                                       {"hybridTimeStep", std::to_string(timeStep)}}),
+                       systemMolecules, systemNeighbors, systemDomain, "."};
+    std::vector<double> momentumArray {initialMomentumArray};
+    const double diffHamiltonian {trajectory(system, momentumArray)};
+    const double returnDiffHamiltonian {trajectory(system, momentumArray)};
+    const std::vector<double> returnArray {system.getMolecules().getUnwrappedPositionArray()};
+    double maxDiffPosition {0.};
+    double maxDiffMomentum {0.};
+
+    for (size_t k = 0; k < initialArray.size(); k++)
+    {
+        maxDiffPosition = std::max(maxDiffPosition, std::fabs(returnArray[k] - initialArray[k]));
+        maxDiffMomentum = std::max(maxDiffMomentum, std::fabs(momentumArray[k] - initialMomentumArray[k]));
+    }
+
+    if (maxDiffPosition > tolerance || maxDiffMomentum > tolerance
+        || std::fabs(diffHamiltonian + returnDiffHamiltonian) > tolerance * nParticles)
+    {
+        std::cout << "hybridTest: the reversed trajectory ends " << maxDiffPosition << " from the initial positions, "
+                  << maxDiffMomentum << " from the initial momenta and " << diffHamiltonian + returnDiffHamiltonian
+                  << " from the initial U + K\n";
+        ++nFailures;
+    }
+
+    MonteCarlo halfStepSystem {setKeys(param, {{"hybrid", "yes"}, {"hybridSteps", std::to_string(2 * nSteps)},
+                                               {"hybridTimeStep", std::to_string(timeStep / 2.)}}),
+                               systemMolecules, systemNeighbors, systemDomain, "."};
+    momentumArray = initialMomentumArray;
+    const double halfStepDiffHamiltonian {trajectory(halfStepSystem, momentumArray)};
+
+    if (std::fabs(diffHamiltonian) > tolerance * nParticles
+        && std::fabs(halfStepDiffHamiltonian) > 0.5 * std::fabs(diffHamiltonian))
+    {
+        std::cout << "hybridTest: U + K changes by " << diffHamiltonian << " along a trajectory and by "
+                  << halfStepDiffHamiltonian << " with half the time step\n";
+        ++nFailures;
+    }
+
+    MonteCarlo hybridSystem {setKeys(param, {{"hybrid", "yes"}}), systemMolecules, systemNeighbors, systemDomain,
+                             "."};
+    nFailures += moveEnergyTest("hybridTest", hybridSystem, nMoves, [&]() { hybridSystem.mcHybrid(); });
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the FIRE minimizer. Its first step starts at rest, so
+ * it must move every particle by quenchTimeStep^2 F. The full minimization
+ * must then lower the energy, return the energy of the minimized
+ * configuration and converge below quenchForceTolerance. With a potential
+ * truncated without force shift the forces jump at the cut-off and the
+ * largest force component only has to drop by minForceRatio.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int minimizerTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors)
+{
+    constexpr double timeStep {0.005};
+    constexpr double forceTolerance {1e-4};
+    constexpr double minForceRatio {1e-3};
+    constexpr double tolerance {1e-9};
+    const param::Parameter quenchParam {setKeys(param, {{"quenchTimeStep", std::to_string(timeStep)},
+                                                        {"quenchForceTolerance", std::to_string(forceTolerance)},
+                                                        {"quenchMaxSteps", "20000"}})};
+    const std::vector<double> initialArray {systemMolecules.getUnwrappedPositionArray()};
+    std::vector<double> forceArray {};
+    int nFailures {0};
+
+    Molecules stepMolecules {systemMolecules};
+    Neighbors stepNeighbors {systemNeighbors};
+    const auto maxForce {[](const std::vector<double>& array)
+    {
+        return std::fabs(*std::max_element(array.begin(), array.end(),
+                                           [](const double& first, const double& second)
+                                           {
+                                               return std::fabs(first) < std::fabs(second);
+                                           }));
+    }};
+    const double initialEnergy {stepMolecules.forceSystemMolecule(stepNeighbors, forceArray)};
+    const double initialMaxForce {maxForce(forceArray)};
+    const Minimizer stepMinimizer {setKeys(quenchParam, {{"quenchMaxSteps", "1"}})};
+    stepMinimizer.minimize(stepMolecules, stepNeighbors);
+    const std::vector<double> stepArray {stepMolecules.getUnwrappedPositionArray()};
+    double maxDiffStep {0.};
+
+    for (size_t k = 0; k < initialArray.size(); k++)
+    {
+        maxDiffStep = std::max(maxDiffStep,
+                               std::fabs(stepArray[k] - initialArray[k] - timeStep * timeStep * forceArray[k]));
+    }
+
+    // The positions may be single precision (Real).
+    if (maxDiffStep > 1e-6 * systemMolecules.getLengthCube())
+    {
+        std::cout << "minimizerTest: the first step differs by " << maxDiffStep << " from quenchTimeStep^2 F\n";
+        ++nFailures;
+    }
+
+    Molecules minimizedMolecules {systemMolecules};
+    Neighbors minimizedNeighbors {systemNeighbors};
+    const double minimizedEnergy {Minimizer {quenchParam}.minimize(minimizedMolecules, minimizedNeighbors)};
+    const double energy {minimizedMolecules.forceSystemMolecule(minimizedNeighbors, forceArray)};
+
+    if (maxForce(forceArray) >= std::max(forceTolerance, minForceRatio * initialMaxForce)
+        || !(minimizedEnergy < initialEnergy)
+        || std::fabs(minimizedEnergy - energy) > tolerance * (1. + std::fabs(energy)))
+    {
+        std::cout << "minimizerTest: largest force component " << maxForce(forceArray) << " and energy "
+                  << minimizedEnergy << " (recomputed " << energy << ") from " << initialEnergy << "\n";
+        ++nFailures;
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function compares the Widom ghost energies (see
+ * MonteCarlo::widomEnergies), after a few time steps of the run moves, with
+ * the energy change of the system when a particle of the same type is
+ * actually added at the ghost position, as a lone unit diameter molecule.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int widomTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+              const Domain& systemDomain)
+{
+    constexpr int nDims {3};
+    constexpr int nGhosts {20};
+    constexpr int nSteps {5};
+    constexpr double tolerance {1e-6};
+    const int nParticles {systemMolecules.getNParticles()};
+    const int nParticleTypes {systemMolecules.getNParticleTypes()};
+    MonteCarlo system {setKeys(param, {{"widomRate", "1"}}), systemMolecules, systemNeighbors, systemDomain, "."};
+    int nFailures {0};
+
+    for (int step = 0; step < nSteps; step++)
+    {
+        int j {0};
+
+        while (j < nParticles)
+        {
+            j += system.mcMove();
+        }
+        system.mcPendingTranslations();
+        system.checkNeighbors();
+    }
+    const Molecules& molecules {system.getMolecules()};
+    std::vector<Real> positionArray (nDims * nGhosts);
+
+    for (auto& position : positionArray)
+    {
+        position = static_cast<Real>(Random::doubleGenerator(0., molecules.getLengthCube()));
+    }
+    std::vector<double> energyArray {};
+    system.widomEnergies(positionArray, energyArray);
+    const double energy {molecules.energySystemMolecule(system.getNeighbors())};
+
+    // The same configuration with one more particle, of type at the ghost position k.
+    const auto insertionEnergy {[&](const int& k, const int& type)
+    {
+        std::vector<ParticleRecord> particleArray {molecules.getParticleRecordArray()};
+        std::vector<int> flagsArray {molecules.getFlagsArray()};
+        std::vector<int> moleculeTypeArray (nParticles + 1);
+        std::vector<Real> diameterArray (molecules.isPolydisperse() ? nParticles + 1 : 0, Real{1});
+        std::vector<int> bondsArray {};
+        std::vector<int> bondsIndex {0};
+
+        for (int i = 0; i < nParticles; i++)
+        {
+            moleculeTypeArray[i] = molecules.getMoleculeTypeI(i);
+
+            if (molecules.isPolydisperse())
+            {
+                diameterArray[i] = molecules.getDiameterI(i);
+            }
+            bondsArray.insert(bondsArray.end(), molecules.getBondsItBeginI(i), molecules.getBondsItEndI(i));
+            bondsIndex.push_back(static_cast<int>(bondsArray.size()));
+        }
+        ParticleRecord ghost {};
+        std::copy(positionArray.begin() + nDims * k, positionArray.begin() + nDims * (k + 1), ghost.position);
+        ghost.type = type;
+        particleArray.push_back(ghost);
+        flagsArray.insert(flagsArray.end(), nDims, 0);
+        moleculeTypeArray.back() = *std::max_element(moleculeTypeArray.begin(), moleculeTypeArray.end() - 1) + 1;
+        bondsIndex.push_back(static_cast<int>(bondsArray.size()));
+
+        Molecules insertedMolecules {molecules};
+        insertedMolecules.assignParticles(std::move(particleArray), std::move(flagsArray),
+                                          std::move(moleculeTypeArray), std::move(diameterArray),
+                                          std::move(bondsArray), std::move(bondsIndex));
+        const Neighbors insertedNeighbors {param, insertedMolecules};
+        return insertedMolecules.energySystemMolecule(insertedNeighbors) - energy;
+    }};
+
+    for (int k = 0; k < nGhosts; k++)
+    {
+        for (int type = 1; type <= nParticleTypes; type++)
+        {
+            const double ghostEnergy {energyArray[(type - 1) * nGhosts + k]};
+            const double diffEnergy {insertionEnergy(k, type)};
+
+            if (std::fabs(ghostEnergy - diffEnergy) > tolerance * (1. + std::fabs(diffEnergy)))
+            {
+                std::cout << "widomTest: ghost " << k << " of type " << type << " has the energy " << ghostEnergy
+                          << " instead of " << diffEnergy << "\n";
+                ++nFailures;
+            }
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function returns the energy of a copy of systemMolecules where the
+ * particles of indexArray are moved to positionArray (x, y, z of each one,
+ * inside the box), computed with a fresh neighbor list.
+ ******************************************************************************/
+double movedEnergy(const param::Parameter& param, const Molecules& systemMolecules, const std::vector<int>& indexArray,
+                   const std::vector<Real>& positionArray)
+{
+    constexpr int nDims {3};
+    Molecules movedMolecules {systemMolecules};
+
+    for (size_t p = 0; p < indexArray.size(); p++)
+    {
+        movedMolecules.updatePositionI(indexArray[p], positionArray.begin() + nDims * p);
+    }
+    const Neighbors movedNeighbors {param, movedMolecules};
+    return movedMolecules.energySystemMolecule(movedNeighbors);
+}
+
+/*******************************************************************************
+ * This function checks the trial energies of the configurational-bias
+ * regrowth, from which the Rosenbluth weights are built, for the last bead of
+ * 1 or 2 regrown beads of a few chains: their differences must match the
+ * system energy differences when the bead, and the bead already placed before
+ * it, are actually moved.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int regrowthWeightTest(const param::Parameter& param, const Molecules& systemMolecules,
+                       const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    constexpr int nDims {3};
+    constexpr int nChains {5};
+    constexpr int nTrials {8};
+    constexpr double bondRadius {1.};                // Within the range of the FENE bonds.
+    constexpr double tolerance {1e-6};
+    MonteCarlo system {setKeys(param, {{"regrowth", "yes"}, {"cbmcTrials", std::to_string(nTrials)},
+                                       {"cbmcMaxBeads", "2"}}), systemMolecules, systemNeighbors, systemDomain, "."};
+    int nFailures {0};
+    int nTestedChains {0};
+
+    // Position uniform in the ball of radius bondRadius around posIt.
+    const auto ballPosition {[&](const auto& posIt)
+    {
+        const std::vector<double> direction {Random::unitVectorGenerator(nDims)};
+        const double radius {bondRadius * std::cbrt(Random::doubleGenerator(0., 1.))};
+        std::array<Real, nDims> position {};
+
+        for (int d = 0; d < nDims; d++)
+        {
+            position[d] = static_cast<Real>(posIt[d] + radius * direction[d]);
+        }
+        systemMolecules.periodicBC(position.begin());
+        return position;
+    }};
+
+    for (int indexMolecule = 0; indexMolecule < systemMolecules.getNMolecules() && nTestedChains < nChains;
+         indexMolecule++)
+    {
+        const int lenMolecule {systemMolecules.getMoleculeLengthI(indexMolecule)};
+
+        if (!systemMolecules.isLinearMoleculeI(indexMolecule) || lenMolecule < 3)
+        {
+            continue;
+        }
+        ++nTestedChains;
+        const auto chainItBegin {systemMolecules.getChainItBeginI(indexMolecule)};
+
+        for (int nRegrow = 1; nRegrow <= 2; nRegrow++)
+        {
+            const std::vector<int> regrownArray (chainItBegin + lenMolecule - nRegrow, chainItBegin + lenMolecule);
+            std::vector<int> sortedRegrownArray {regrownArray};
+            std::sort(sortedRegrownArray.begin(), sortedRegrownArray.end());
+            const int b {nRegrow - 1};
+            const int& indexParticle {regrownArray[b]};
+
+            // The first regrown bead is placed near its old position, the trials of the last one around it.
+            std::vector<Real> placedArray (nDims * nRegrow);
+            const std::array<Real, nDims> placedPosition {
+                    ballPosition(systemMolecules.getPosItBeginI(regrownArray[0]))};
+            std::copy(placedPosition.begin(), placedPosition.end(), placedArray.begin());
+            const Real* previousPosIt {(b == 0) ? systemMolecules.getPosItBeginI(chainItBegin[lenMolecule - 2])
+                                                : placedArray.data()};
+            std::vector<Real> trialArray (nDims * nTrials);
+            std::vector<double> trialEnergyArray (nTrials);
+            std::vector<std::array<Real, nDims>> positionArray (nTrials);
+            const auto posItBegin {systemMolecules.getPosItBeginI(indexParticle)};
+            std::copy(posItBegin, posItBegin + nDims, positionArray[0].begin());
+
+            for (int k = 0; k < nTrials; k++)
+            {
+                if (k > 0)
+                {
+                    positionArray[k] = ballPosition(previousPosIt);
+                }
+
+                for (int d = 0; d < nDims; d++)
+                {
+                    trialArray[d * nTrials + k] = positionArray[k][d];
+                }
+            }
+            system.regrowthTrialEnergies(regrownArray, sortedRegrownArray, b, placedArray, trialArray,
+                                         trialEnergyArray);
+
+            // Energy of the system with the placed beads and the bead b at trial k.
+            const auto trialSystemEnergy {[&](const int& k)
+            {
+                std::vector<Real> movedArray (placedArray.begin(), placedArray.begin() + nDims * b);
+                movedArray.insert(movedArray.end(), positionArray[k].begin(), positionArray[k].end());
+                return movedEnergy(param, systemMolecules, regrownArray, movedArray);
+            }};
+            const double energy {trialSystemEnergy(0)};
+
+            for (int k = 1; k < nTrials; k++)
+            {
+                const double diffEnergy {trialSystemEnergy(k) - energy};
+                const double trialDiffEnergy {trialEnergyArray[k] - trialEnergyArray[0]};
+
+                if (std::fabs(trialDiffEnergy - diffEnergy) > tolerance * (1. + std::fabs(diffEnergy)))
+                {
+                    std::cout << "regrowthWeightTest: trial " << k << " of particle " << indexParticle
+                              << " changes the energy by " << trialDiffEnergy << " instead of " << diffEnergy << "\n";
+                    ++nFailures;
+                }
+            }
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function checks the trial energies of the multiple-try translations,
+ * from which the selection and acceptance weights are built: for a few
+ * particles, their differences must match the system energy differences when
+ * the particle is actually moved to the trials.
+ *
+ * @return Number of failed checks.
+ ******************************************************************************/
+int multipleTryWeightTest(const param::Parameter& param, const Molecules& systemMolecules,
+                          const Neighbors& systemNeighbors, const Domain& systemDomain)
+{
+    constexpr int nDims {3};
+    constexpr int nParticlesTested {5};
+    constexpr int nTrials {8};
+    constexpr double maxDisplacement {0.05};       // Within the skin of the neighbor list.
+    constexpr double tolerance {1e-6};
+    const MonteCarlo system {setKeys(param, {{"mtmTrials", std::to_string(nTrials)}}), systemMolecules,
+                             systemNeighbors, systemDomain, "."};
+    int nFailures {0};
+
+    for (int p = 0; p < nParticlesTested; p++)
+    {
+        const int indexParticle {Random::intGenerator(0, systemMolecules.getNParticles() - 1)};
+        const auto posItBegin {systemMolecules.getPosItBeginI(indexParticle)};
+        std::vector<std::array<Real, nDims>> positionArray (nTrials);
+        std::vector<Real> trialArray (nDims * nTrials);
+        std::vector<double> trialEnergyArray (nTrials);
+
+        // The first trial is the old position.
+        for (int k = 0; k < nTrials; k++)
+        {
+            for (int d = 0; d < nDims; d++)
+            {
+                const double displacement {(k == 0) ? 0. : Random::doubleGenerator(-maxDisplacement, maxDisplacement)};
+                positionArray[k][d] = static_cast<Real>(posItBegin[d] + displacement);
+            }
+            systemMolecules.periodicBC(positionArray[k].begin());
+
+            for (int d = 0; d < nDims; d++)
+            {
+                trialArray[d * nTrials + k] = positionArray[k][d];
+            }
+        }
+        system.translationTrialEnergies(indexParticle, trialArray, trialEnergyArray);
+
+        const auto trialSystemEnergy {[&](const int& k)
+        {
+            return movedEnergy(param, systemMolecules, {indexParticle},
+                               std::vector<Real> (positionArray[k].begin(), positionArray[k].end()));
+        }};
+        const double energy {trialSystemEnergy(0)};
+
+        for (int k = 1; k < nTrials; k++)
+        {
+            const double diffEnergy {trialSystemEnergy(k) - energy};
+            const double trialDiffEnergy {trialEnergyArray[k] - trialEnergyArray[0]};
+
+            if (std::fabs(trialDiffEnergy - diffEnergy) > tolerance * (1. + std::fabs(diffEnergy)))
+            {
+                std::cout << "multipleTryWeightTest: trial " << k << " of particle " << indexParticle
+                          << " changes the energy by " << trialDiffEnergy << " instead of " << diffEnergy << "\n";
+                ++nFailures;
+            }
+        }
+    }
+    return nFailures;
+}
+
+/*******************************************************************************
+ * This function runs the unit tests on the configuration of the run
+ * (unitTests=yes in inputVar.txt) and prints the number of failed checks of
+ * each one.
+ *
+ * @return Total number of failed checks.
+ ******************************************************************************/
+int runUnitTests(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                 const Domain& systemDomain)
+{
+    const std::vector<std::pair<std::string, int>> resultArray {
+            {"aliasTableTest", aliasTableTest()},
+            {"moveMixTest", moveMixTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"swapTypeEnergyTest", swapTypeEnergyTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"reduceParticlesTest", reduceParticlesTest(systemMolecules, systemNeighbors)},
+            {"chainMoveTest", chainMoveTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"regrowthTest", regrowthTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"multipleTryTest", multipleTryTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"batchTranslationTest", batchTranslationTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"speculativeTranslationTest",
+             speculativeTranslationTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"domainDecompositionTest",
+             domainDecompositionTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"volumeMoveTest", volumeMoveTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"virialTest", virialTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"diameterSwapTest", diameterSwapTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"typeBucketTest", typeBucketTest(systemMolecules)},
+            {"nonLocalSwapTest", nonLocalSwapTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"mutationTest", mutationTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"hybridTest", hybridTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"minimizerTest", minimizerTest(param, systemMolecules, systemNeighbors)},
+            {"widomTest", widomTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"regrowthWeightTest", regrowthWeightTest(param, systemMolecules, systemNeighbors, systemDomain)},
+            {"multipleTryWeightTest",
+             multipleTryWeightTest(param, systemMolecules, systemNeighbors, systemDomain)}};
+    int nFailures {0};
+
+    for (const auto& [name, nTestFailures] : resultArray)
+    {
+        std::cout << name << ": " << (nTestFailures == 0 ? "passed" : "failed") << "\n";
+        nFailures += nTestFailures;
+    }
+    return nFailures;
+}
@@ -8,9 +8,52 @@
 #ifndef UNITTESTS_H_
 #define UNITTESTS_H_
 
-
+#include "MOLECULES/Molecules.h"
+#include "NEIGHBORS/Neighbors.h"
+#include "DOMAIN/Domain.h"
+#include "INPUT/Parameter.h"
 
 int squareDistancePairTest();
 void randomGeneratorTest();
+int aliasTableTest();
+int moveMixTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                const Domain& systemDomain);
+int swapTypeEnergyTest(const param::Parameter& param, const Molecules& systemMolecules,
+                       const Neighbors& systemNeighbors, const Domain& systemDomain);
+int reduceParticlesTest(const Molecules& systemMolecules, const Neighbors& systemNeighbors);
+int chainMoveTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                  const Domain& systemDomain);
+int regrowthTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                 const Domain& systemDomain);
+int multipleTryTest(const param::Parameter& param, const Molecules& systemMolecules,
+                    const Neighbors& systemNeighbors, const Domain& systemDomain);
+int batchTranslationTest(const param::Parameter& param, const Molecules& systemMolecules,
+                         const Neighbors& systemNeighbors, const Domain& systemDomain);
+int speculativeTranslationTest(const param::Parameter& param, const Molecules& systemMolecules,
+                               const Neighbors& systemNeighbors, const Domain& systemDomain);
+int domainDecompositionTest(const param::Parameter& param, const Molecules& systemMolecules,
+                            const Neighbors& systemNeighbors, const Domain& systemDomain);
+int volumeMoveTest(const param::Parameter& param, const Molecules& systemMolecules,
+                   const Neighbors& systemNeighbors, const Domain& systemDomain);
+int virialTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+               const Domain& systemDomain);
+int diameterSwapTest(const param::Parameter& param, const Molecules& systemMolecules,
+                     const Neighbors& systemNeighbors, const Domain& systemDomain);
+int typeBucketTest(const Molecules& initialMolecules);
+int nonLocalSwapTest(const param::Parameter& param, const Molecules& systemMolecules,
+                     const Neighbors& systemNeighbors, const Domain& systemDomain);
+int mutationTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                 const Domain& systemDomain);
+int hybridTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+               const Domain& systemDomain);
+int minimizerTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors);
+int widomTest(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+              const Domain& systemDomain);
+int regrowthWeightTest(const param::Parameter& param, const Molecules& systemMolecules,
+                       const Neighbors& systemNeighbors, const Domain& systemDomain);
+int multipleTryWeightTest(const param::Parameter& param, const Molecules& systemMolecules,
+                          const Neighbors& systemNeighbors, const Domain& systemDomain);
+int runUnitTests(const param::Parameter& param, const Molecules& systemMolecules, const Neighbors& systemNeighbors,
+                 const Domain& systemDomain); // Returns the number of failures.
 
 #endif /* UNITTESTS_H_ */
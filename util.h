@@ -11,6 +11,7 @@
 #include <vector>
 #include <numeric>
 #include <algorithm>
+#include <cmath>
 
 /***
 double squareDistancePair(const std::vector<double>& positionA,  const std::vector<double>& positionB,
@@ -71,6 +72,45 @@ void periodicVector(InputIt vecItBegin, const int& lenVec, const double& lengthC
     std::for_each(vecItBegin, vecItBegin + lenVec, [&lengthCube](auto &n) { n = (n > lengthCube/2) ? n - lengthCube: n;});
 }
 
+/*
+ * Pairwise (cascade) summation: the round-off error grows as O(log n) instead
+ * of O(n) for the naive loop.
+ */
+template<typename InputIt>
+double pairwiseSum(InputIt itBegin, InputIt itEnd)
+{
+    constexpr long blockSize {8};
+    const auto len {std::distance(itBegin, itEnd)};
+
+    if (len <= blockSize)
+    {
+        return std::accumulate(itBegin, itEnd, 0.);
+    }
+    const InputIt itMiddle {itBegin + len / 2};
+    return pairwiseSum(itBegin, itMiddle) + pairwiseSum(itMiddle, itEnd);
+}
+
+/*
+ * Rotates the 3D vector vecItBegin by angle around the unit vector axisItBegin (Rodrigues' formula) and writes the
+ * result in outItBegin.
+ */
+template<typename InputIt, typename AxisIt, typename OutputIt>
+void rotateVector(InputIt vecItBegin, AxisIt axisItBegin, const double& angle, OutputIt outItBegin)
+{
+    const double v[3] {static_cast<double>(vecItBegin[0]), static_cast<double>(vecItBegin[1]),
+                       static_cast<double>(vecItBegin[2])};
+    const double k[3] {axisItBegin[0], axisItBegin[1], axisItBegin[2]};
+    const double cosAngle {std::cos(angle)};
+    const double sinAngle {std::sin(angle)};
+    const double kDotV {k[0] * v[0] + k[1] * v[1] + k[2] * v[2]};
+    const double kCrossV[3] {k[1] * v[2] - k[2] * v[1], k[2] * v[0] - k[0] * v[2], k[0] * v[1] - k[1] * v[0]};
+
+    for (int d = 0; d < 3; d++)
+    {
+        outItBegin[d] = v[d] * cosAngle + kCrossV[d] * sinAngle + k[d] * kDotV * (1. - cosAngle);
+    }
+}
+
 std::vector<double> meanColumnsMatrix(std::vector<std::vector<double>> mat);
 
 std::vector<int> createSaveTime(const int& max, const int& linear_scalar, const float& log_scalar);